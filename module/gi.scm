@@ -42,7 +42,12 @@
                <GObject> <GInterface> <GParam> <GBoxed> <GIBaseInfo>
                <GVariant> <GValue> <GClosure>
                enum->number flags->number
-               transform procedure->closure)
+               transform procedure->closure
+               borrow-boxed! borrowing-boxed? boxed-borrowed? boxed-copy
+               retained-native-bytes set-size-estimator!
+               flush-unref-queue!
+               with-gobject-scope call-with-gobject-scope dispose!
+               get-properties set-properties! make-objects chain-up)
   #:replace ((%new . make))
   #:export (use-typelibs
             register-type
@@ -16,7 +16,14 @@
 (define-module (gi logging)
   #:export (install-port-logger!
             install-journal-logger!
-            install-custom-logger!))
+            install-custom-logger!
+            debug-topics
+            refresh-debug-topics!
+            %stall-hook
+            watchdog-start!
+            watchdog-stop!
+            watchdog-threshold))
 
 (eval-when (expand load eval)
-  (load-extension "libguile-gi" "gig_init_logging"))
+  (load-extension "libguile-gi" "gig_init_logging")
+  (load-extension "libguile-gi" "gig_init_watchdog"))
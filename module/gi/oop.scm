@@ -30,7 +30,10 @@
 (define-class <GFundamental> ()
   (value #:class <scm-slot>
          #:init-keyword #:value
-         #:init-value %null-pointer))
+         #:init-value %null-pointer)
+  ;; Bookkeeping that the C side keeps for the wrapped instance.
+  (handle #:class <scm-slot>
+          #:init-value #f))
 
 (define-class <GEnum> (<GFundamental>)
   (obarray #:allocation #:each-subclass
@@ -56,6 +59,50 @@
                        #:init-value ,unref))
               #:name type))
 
+;; GOOPS does not export these, but add-method! of a <generic> is made
+;; of them.
+(define add-method-in-classes! (@@ (oop goops) add-method-in-classes!))
+(define remove-method-in-classes! (@@ (oop goops) remove-method-in-classes!))
+(define invalidate-method-cache! (@@ (oop goops) invalidate-method-cache!))
+
+(define (specializers-hash specializers size)
+  (let loop ((specializers specializers) (hash 0))
+    (if (pair? specializers)
+        (loop (cdr specializers)
+              (modulo (+ (* hash 31) (hashq (car specializers) size)) size))
+        (modulo (+ (* hash 31) (hashq specializers size)) size))))
+
+(define (%add-methods! generic methods)
+  "Adds METHODS, in order, to GENERIC as add-method! would, but sets the
+methods of GENERIC and resets its dispatch state only once."
+  (if (not (is-a? generic <generic>))
+      (for-each (cut add-method! generic <>) methods)
+      ;; Each list of specializers maps to the pair holding its method,
+      ;; so that a method replaces the one with the same specializers.
+      (let ((cells (make-hash-table))
+            (old (slot-ref generic 'methods))
+            (new '()))
+        (let loop ((cell old))
+          (when (pair? cell)
+            (hashx-set! specializers-hash assoc cells (method-specializers (car cell)) cell)
+            (loop (cdr cell))))
+        (for-each
+         (lambda (method)
+           (let* ((specializers (method-specializers method))
+                  (cell (hashx-ref specializers-hash assoc cells specializers)))
+             (slot-set! method 'generic-function generic)
+             (cond
+              (cell
+               (remove-method-in-classes! (car cell))
+               (set-car! cell method))
+              (else
+               (set! new (cons method new))
+               (hashx-set! specializers-hash assoc cells specializers new)))
+             (add-method-in-classes! method)))
+         methods)
+        (slot-set! generic 'methods (append! new old))
+        (invalidate-method-cache! generic))))
+
 (define-class <signal> (<applicable-struct>)
   (name #:init-keyword #:name)
   (flags #:init-keyword #:flags
@@ -14,6 +14,7 @@
 ;; along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 (define-module (gi repository)
+  #:use-module (ice-9 format)
   #:use-module (ice-9 optargs)
   #:use-module (oop goops)
   #:use-module (srfi srfi-1)
@@ -27,6 +28,11 @@
             load-by-name typelib->module
 
             get-search-path prepend-search-path!
+            binding-cache-flush! binding-cache-preload!
+            binding-cache-set-directory!
+
+            load-stats-enable! load-stats-disable! load-stats-enabled?
+            load-stats-reset! load-stats-snapshot load-stats-report
 
             LOAD_METHODS LOAD_PROPERTIES LOAD_SIGNALS
             LOAD_EVERYTHING LOAD_INFO_ONLY))
@@ -43,8 +49,25 @@
 (define* (load-by-name lib name #:optional (flags LOAD_EVERYTHING))
   (load (info lib name) flags))
 
-(define* (typelib->module module lib #:optional version)
+;; A lazy module defines the functions, methods, properties and
+;; signals of LIB only when they are first looked up in its public
+;; interface.
+(define (lazy-binder module lib)
+  (lambda (interface name define?)
+    (and (not define?)
+         (let ((defs (save-module-excursion
+                      (lambda ()
+                        (set-current-module module)
+                        (%lazy-load! lib name)))))
+           (and (pair? defs)
+                (begin
+                  (module-export! module defs)
+                  (hashq-ref (module-obarray interface) name)))))))
+
+(define* (typelib->module module lib #:optional version #:key lazy? index arg-maps)
   (require lib version)
+  (when arg-maps
+    (binding-cache-preload! lib arg-maps))
   (set! module (cond
                 ((module? module) module)
                 ((list? module) (resolve-module module))
@@ -60,6 +83,36 @@
   (save-module-excursion
    (lambda ()
      (set-current-module module)
-     (module-export! module (append-map! load (infos lib)))))
+     (cond
+      ((or lazy? index)
+       (module-export! module (%lazy-index! lib index))
+       (set-module-binder! (module-public-interface module) (lazy-binder module lib)))
+      (else
+       (module-export! module (%load-batch (lambda () (append-map! load (infos lib)))))
+       (binding-cache-flush!)))))
 
   module)
+
+;; Writes a table of where loading LIB, or all typelibs, went to PORT,
+;; most expensive first.
+(define* (load-stats-report #:optional (port (current-output-port)) #:key lib)
+  (let ((entries (sort (filter (lambda (entry)
+                                 (or (not lib) (equal? lib (assq-ref entry 'typelib))))
+                               (load-stats-snapshot))
+                       (lambda (a b)
+                         (> (assq-ref a 'total-time) (assq-ref b 'total-time))))))
+    (format port "~8@a ~12@a ~12@a ~8@a ~8@a ~8@a ~8@a  ~a~%"
+            "infos" "total (us)" "bytes" "classes" "generics" "methods" "closures" "typelib")
+    (for-each
+     (lambda (entry)
+       (format port "~8d ~12,1f ~12d ~8d ~8d ~8d ~8d  ~a ~a~%"
+               (assq-ref entry 'infos)
+               (/ (assq-ref entry 'total-time) 1000.0)
+               (assq-ref entry 'bytes)
+               (assq-ref entry 'classes)
+               (assq-ref entry 'generics)
+               (assq-ref entry 'methods)
+               (assq-ref entry 'closures)
+               (assq-ref entry 'typelib)
+               (assq-ref entry 'info-type)))
+     entries)))
@@ -0,0 +1,60 @@
+;; Copyright (C) 2021 Michael L. Gran
+
+;; This program is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; This program is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with this program.  If not, see <https://www.gnu.org/licenses/>.
+(define-module (gi stats)
+  #:use-module (ice-9 format)
+  #:use-module (ice-9 optargs)
+  #:use-module (srfi srfi-1)
+  #:export (stats-enable!
+            stats-disable!
+            stats-enabled?
+            stats-reset!
+            stats-snapshot
+            stats-sorted
+            stats-report))
+
+(eval-when (expand load eval)
+  (load-extension "libguile-gi" "gig_init_stats"))
+
+(define (stats-ref entry key)
+  (assq-ref entry key))
+
+;; Returns the snapshot sorted by the field KEY, largest first.
+(define* (stats-sorted #:optional (key 'total-time))
+  (sort (stats-snapshot)
+        (lambda (a b)
+          (> (stats-ref a key) (stats-ref b key)))))
+
+;; Writes a table of the LIMIT most expensive bindings to PORT.
+(define* (stats-report #:optional (port (current-output-port))
+                       #:key (sort-by 'total-time) (limit 20))
+  (let ((entries (stats-sorted sort-by)))
+    (format port "~10@a ~12@a ~12@a ~12@a ~6@a ~10@a  ~a~%"
+            "calls" "total (us)" "mean (us)" "max (us)" "errors" "temp bytes" "binding")
+    (for-each
+     (lambda (entry)
+       (let ((calls (stats-ref entry 'calls))
+             (total (stats-ref entry 'total-time)))
+         (format port "~10d ~12,1f ~12,1f ~12,1f ~6d ~10d  ~a ~a~%"
+                 calls
+                 (/ total 1000.0)
+                 (/ total calls 1000.0)
+                 (/ (stats-ref entry 'max-time) 1000.0)
+                 (stats-ref entry 'errors)
+                 (stats-ref entry 'temp-bytes)
+                 (stats-ref entry 'kind)
+                 (stats-ref entry 'name))))
+     (if (and limit (> (length entries) limit))
+         (take entries limit)
+         entries))))
@@ -35,7 +35,8 @@
             flags-complement flags-projection flags-projection/list
             flags-projection/number
             is-registered-callback?
-            get-registered-callback-closure-pointer))
+            get-registered-callback-closure-pointer
+            with-gobject-scope))
 
 (eval-when (expand load eval)
   (load-extension "libguile-gi" "gig_init_types")
@@ -61,6 +62,11 @@
   (slot-set! pspec 'procedure (cut (@@ (gi oop) %get-property) <> pspec))
   (slot-set! pspec 'setter (cut (@@ (gi oop) %set-property!) <> pspec <>)))
 
+;;; Scoped release
+
+(define-syntax-rule (with-gobject-scope body body* ...)
+  (call-with-gobject-scope (lambda () body body* ...)))
+
 ;;; Closures
 
 (define-method (initialize (closure <GClosure>) initargs)
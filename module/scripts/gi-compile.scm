@@ -0,0 +1,187 @@
+;; Copyright (C) 2021 Michael L. Gran
+
+;; This program is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; This program is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Usage: gi-compile -n NAMESPACE -v VERSION [OPTIONS]
+;;
+;; This program writes a Scheme module for a library, that uses GObject
+;; introspection, to be compiled with "guild compile".  The module is a
+;; lazy index: it holds the names that the typelib defines and where
+;; they are found, as well as how the arguments of its functions map
+;; between Scheme and C, so that loading it does not search the
+;; typelib.  It does not hold the bindings themselves; types,
+;; constants, functions, methods, properties and signals are still
+;; made on first use.  The argument maps are only used while the
+;; typelib has the same contents.
+;;
+;; Example: gi-compile -n Gio -v 2.0 -o gio.scm
+;;
+;; Required options are:
+;;
+;;   -n, --namespace=NAMESPACE   The namespace to bind.
+;;   -v, --version=VERSION       The version of the bound namespace.
+;;
+;; Additional options are:
+;;
+;;   -m, --module=MODULE         Name the module MODULE, for instance
+;;                               "(gtk gio)".  The default name is
+;;                               (gi NAMESPACE-VERSION).
+;;   -o, --output=FILE           Write the module to FILE instead of
+;;                               the standard output.
+;;   -s, --skip-arg-maps         Do not store how arguments are mapped.
+;;                               The module is smaller, but the mapping
+;;                               is derived again each time a function
+;;                               is first used.
+
+;;; Code:
+
+(define-module (scripts gi-compile)
+  #:use-module (ice-9 getopt-long)
+  #:use-module (ice-9 documentation)
+  #:use-module (ice-9 pretty-print)
+  #:use-module (ice-9 regex)
+  #:use-module (rnrs bytevectors)
+  #:use-module (rnrs io ports)
+  #:use-module (srfi srfi-1)
+  #:use-module (gi repository)
+  #:export (gi-compile))
+
+(define %summary "Write compilable Guile modules for GObject-based libraries")
+
+(define command-synopsis
+  '((namespace     (single-char #\n) (value #t))
+    (version       (single-char #\v) (value #t))
+    (module        (single-char #\m) (value #t))
+    (output        (single-char #\o) (value #t))
+    (skip-arg-maps (single-char #\s))
+    (help          (single-char #\h))))
+
+(define (display-help)
+  (display
+   ((lambda (s)
+      (substring s 1 (1- (string-length s))))
+    (file-commentary (%search-load-path "scripts/gi-compile.scm")
+                     "^;;; Commentary:"
+                     ";;; Code:"
+                     (let ((dirt (make-regexp "^;+ ?")))
+                       (lambda (line)
+                         (let ((m (regexp-exec dirt line)))
+                           (if m (match:suffix m) ""))))))))
+
+(define (in-fresh-module thunk)
+  (save-module-excursion
+   (lambda ()
+     (set-current-module (make-fresh-user-module))
+     (thunk))))
+
+;; The precomputed index of LIB, sorted so that the module is the same
+;; each time it is written.
+(define (typelib-index lib)
+  (in-fresh-module (lambda () ((@@ (gi repository) %lazy-index!) lib)))
+  (list->vector
+   (sort (vector->list ((@@ (gi repository) %lazy-index->vector) lib))
+         (lambda (a b)
+           (string<? (object->string a) (object->string b))))))
+
+;; Loads all of LIB, so that a binding cache in DIR gets a record for
+;; each function, and returns the contents of its cache file, or #f.
+;; DIR is removed afterwards.
+(define (typelib-arg-maps lib version dir)
+  (binding-cache-set-directory! dir)
+  (in-fresh-module (lambda () (for-each load (infos lib))))
+  (binding-cache-flush!)
+  (binding-cache-set-directory! #f)
+  (let* ((file (string-append dir "/" lib "-" version ".cache"))
+         (contents (and (file-exists? file)
+                        (call-with-port (open-file-input-port file) get-bytevector-all))))
+    (when (file-exists? file)
+      (delete-file file))
+    (false-if-exception (rmdir dir))
+    contents))
+
+(define (write-bytevector bv port)
+  (display "#vu8(" port)
+  (let loop ((i 0))
+    (when (< i (bytevector-length bv))
+      (unless (zero? i)
+        (display (if (zero? (modulo i 16)) "\n        " " ") port))
+      (display (bytevector-u8-ref bv i) port)
+      (loop (1+ i))))
+  (display ")" port))
+
+(define (write-module port module-name lib version index arg-maps)
+  (format port ";; This module was written by gi-compile for ~a ~a.~%" lib version)
+  (format port ";; Write it again instead of editing it.~%~%")
+  (pretty-print `(define-module ,module-name
+                   #:use-module (gi repository))
+                port)
+  (newline port)
+  (display "(define %index\n  #(" port)
+  (let loop ((i 0))
+    (when (< i (vector-length index))
+      (unless (zero? i)
+        (display "\n    " port))
+      (write (vector-ref index i) port)
+      (loop (1+ i))))
+  (display "))\n\n" port)
+  (display "(define %arg-maps\n  " port)
+  (if arg-maps
+      (write-bytevector arg-maps port)
+      (display "#f" port))
+  (display ")\n\n" port)
+  (pretty-print `(typelib->module (current-module) ,lib ,version
+                                  #:index %index #:arg-maps %arg-maps)
+                port))
+
+(define (gi-compile . args)
+  (let ((p (getopt-long (cons "gi-compile" args) command-synopsis)))
+    (let ((help-wanted? (option-ref p 'help #f))
+          (namespace (option-ref p 'namespace #f))
+          (version (option-ref p 'version #f))
+          (skip-arg-maps? (option-ref p 'skip-arg-maps #f)))
+      (cond
+       ((or help-wanted? (not namespace) (not version))
+        (display-help))
+       (else
+        (let ((module-name
+               (let ((m (option-ref p 'module #f)))
+                 (if m
+                     (call-with-input-string m read)
+                     `(gi ,(string->symbol (string-append namespace "-" version))))))
+              (cache-dir (and (not skip-arg-maps?)
+                              (false-if-exception
+                               (let ((f (tmpnam)))
+                                 (mkdir f)
+                                 f)))))
+          (unless (and (list? module-name) (every symbol? module-name))
+            (format (current-error-port) "ERROR: ~a~%" "module must be a list of symbols")
+            (exit EXIT_FAILURE))
+
+          (require namespace version)
+          (let* ((index (typelib-index namespace))
+                 (arg-maps (and cache-dir (typelib-arg-maps namespace version cache-dir)))
+                 (output (option-ref p 'output #f)))
+            (when (and cache-dir (not arg-maps))
+              (format (current-error-port) "WARNING: ~a~%"
+                      "argument maps could not be stored"))
+            (if output
+                (call-with-output-file output
+                  (lambda (port)
+                    (write-module port module-name namespace version index arg-maps)))
+                (write-module (current-output-port) module-name namespace version
+                              index arg-maps)))))))))
+
+(define main gi-compile)
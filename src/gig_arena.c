@@ -0,0 +1,153 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "gig_arena.h"
+
+#define GIG_ARENA_CHUNK_SIZE 1024
+#define GIG_ARENA_ALIGN 16
+
+typedef struct _GigArenaChunk GigArenaChunk;
+struct _GigArenaChunk
+{
+    GigArenaChunk *next;
+    gsize size;
+    guint8 data[];
+};
+
+typedef struct _GigArenaRelease
+{
+    gpointer ptr;
+    GDestroyNotify release;
+} GigArenaRelease;
+
+struct _GigArena
+{
+    // The chunks are kept across resets, so that an arena that is
+    // reused call after call stops allocating once it has grown to
+    // fit.
+    GigArenaChunk *first;
+    GigArenaChunk *current;
+    gsize used;
+    // The bytes handed out or handed over since the last reset.
+    gsize allocated;
+    GArray *releases;
+};
+
+static GigArenaChunk *
+chunk_new(gsize size)
+{
+    GigArenaChunk *chunk = g_malloc(sizeof(GigArenaChunk) + size);
+    chunk->next = NULL;
+    chunk->size = size;
+    return chunk;
+}
+
+GigArena *
+gig_arena_new(void)
+{
+    GigArena *arena = g_new0(GigArena, 1);
+    arena->first = arena->current = chunk_new(GIG_ARENA_CHUNK_SIZE);
+    arena->releases = g_array_new(FALSE, FALSE, sizeof(GigArenaRelease));
+    return arena;
+}
+
+void
+gig_arena_free(GigArena *arena)
+{
+    gig_arena_reset(arena);
+    g_array_free(arena->releases, TRUE);
+
+    GigArenaChunk *chunk = arena->first;
+    while (chunk != NULL) {
+        GigArenaChunk *next = chunk->next;
+        g_free(chunk);
+        chunk = next;
+    }
+    g_free(arena);
+}
+
+// Returns SIZE bytes of zeroed memory that stay valid until the arena
+// is reset.
+gpointer
+gig_arena_alloc(GigArena *arena, gsize size)
+{
+    g_assert_nonnull(arena);
+
+    size = (size + GIG_ARENA_ALIGN - 1) & ~(gsize)(GIG_ARENA_ALIGN - 1);
+
+    while (arena->used + size > arena->current->size) {
+        GigArenaChunk *next = arena->current->next;
+        if (next == NULL || next->size < size) {
+            GigArenaChunk *chunk = chunk_new(MAX(size, GIG_ARENA_CHUNK_SIZE));
+            chunk->next = next;
+            arena->current->next = chunk;
+            next = chunk;
+        }
+        arena->current = next;
+        arena->used = 0;
+    }
+
+    gpointer ptr = arena->current->data + arena->used;
+    arena->used += size;
+    arena->allocated += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+gpointer
+gig_arena_memdup(GigArena *arena, gconstpointer mem, gsize size)
+{
+    gpointer ptr = gig_arena_alloc(arena, size);
+    memcpy(ptr, mem, size);
+    return ptr;
+}
+
+// Hands PTR, SIZE bytes that were not allocated from ARENA, to the
+// arena.  RELEASE is called on it when the arena is reset.
+gpointer
+gig_arena_release_later(GigArena *arena, gpointer ptr, gsize size, GDestroyNotify release)
+{
+    g_assert_nonnull(arena);
+
+    GigArenaRelease entry = { ptr, release };
+    g_array_append_val(arena->releases, entry);
+    arena->allocated += size;
+    return ptr;
+}
+
+// Releases all temporaries held by ARENA, most recent first.
+void
+gig_arena_reset(GigArena *arena)
+{
+    g_assert_nonnull(arena);
+
+    for (guint i = arena->releases->len; i > 0; i--) {
+        GigArenaRelease *entry = &g_array_index(arena->releases, GigArenaRelease, i - 1);
+        entry->release(entry->ptr);
+    }
+    g_array_set_size(arena->releases, 0);
+
+    arena->current = arena->first;
+    arena->used = 0;
+    arena->allocated = 0;
+}
+
+gsize
+gig_arena_allocated(GigArena *arena)
+{
+    g_assert_nonnull(arena);
+    return arena->allocated;
+}
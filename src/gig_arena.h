@@ -0,0 +1,41 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GIG_ARENA_H
+#define GIG_ARENA_H
+
+#include <glib.h>
+
+// *INDENT-OFF*
+G_BEGIN_DECLS
+// *INDENT-ON*
+
+// A scratch arena holds the temporaries of a single C call.  Small
+// blocks are bump-allocated from chunks owned by the arena, and
+// memory allocated elsewhere can be handed to the arena's release
+// list.  Resetting the arena releases everything at once.
+typedef struct _GigArena GigArena;
+
+GigArena *gig_arena_new(void);
+void gig_arena_free(GigArena *arena);
+gpointer gig_arena_alloc(GigArena *arena, gsize size);
+gpointer gig_arena_memdup(GigArena *arena, gconstpointer mem, gsize size);
+gpointer gig_arena_release_later(GigArena *arena, gpointer ptr, gsize size,
+                                 GDestroyNotify release);
+void gig_arena_reset(GigArena *arena);
+gsize gig_arena_allocated(GigArena *arena);
+
+G_END_DECLS
+#endif
@@ -16,10 +16,13 @@
 #include <stdio.h>
 #include <string.h>
 #include "gig_arg_map.h"
+#include "gig_argument.h"
+#include "gig_binding_cache.h"
 #include "gig_data_type.h"
+#include "gig_load_stats.h"
 #include "gig_util.h"
 
-#define gig_debug_amap(...) gig_debug_internal(G_LOG_LEVEL_DEBUG, "amap", __VA_ARGS__)
+#define gig_debug_amap(...) gig_debug_topic(GIG_DEBUG_AMAP, "amap", __VA_ARGS__)
 
 const gchar dir_strings[GIG_ARG_DIRECTION_COUNT][9] = {
     [GIG_ARG_DIRECTION_VOID] = "void",
@@ -46,6 +49,10 @@ static void arg_map_apply_function_info(GigArgMap *amap, GIFunctionInfo *func_in
 static void arg_map_determine_argument_presence(GigArgMap *amap, GIFunctionInfo *info);
 static void arg_map_compute_c_invoke_positions(GigArgMap *amap);
 static void arg_map_compute_s_call_positions(GigArgMap *amap);
+static void arg_map_build_index_tables(GigArgMap *amap);
+static void arg_map_resolve_converters(GigArgMap *amap);
+static GVariant *arg_map_to_record(GigArgMap *amap);
+static gboolean arg_map_apply_record(GigArgMap *amap, GVariant *record);
 static void arg_map_entry_init(GigArgMapEntry *map);
 
 static void
@@ -56,8 +63,8 @@ arg_map_entry_init(GigArgMapEntry *entry)
 }
 
 // Gather information on how to map Scheme arguments to C arguments.
-GigArgMap *
-gig_amap_new(const gchar *name, GICallableInfo *function_info)
+static GigArgMap *
+arg_map_new_from_info(GICallableInfo *function_info)
 {
     GigArgMap *amap;
     gsize n;
@@ -71,9 +78,40 @@ gig_amap_new(const gchar *name, GICallableInfo *function_info)
         gig_amap_free(amap);
         return NULL;
     }
-    arg_map_determine_argument_presence(amap, function_info);
-    arg_map_compute_c_invoke_positions(amap);
-    arg_map_compute_s_call_positions(amap);
+    return amap;
+}
+
+GigArgMap *
+gig_amap_new(const gchar *name, GICallableInfo *function_info)
+{
+    GigArgMap *amap = arg_map_new_from_info(function_info);
+    if (amap == NULL)
+        return NULL;
+
+    // The types of the arguments come from the typelib, but how they
+    // are laid out may come from the binding cache.
+    GVariant *record = gig_binding_cache_lookup(function_info);
+    if (record != NULL && !arg_map_apply_record(amap, record)) {
+        gig_debug_amap("%s - ignoring a bad binding cache record", amap->name);
+        gig_binding_cache_reject(function_info);
+        gig_amap_free(amap);
+        amap = arg_map_new_from_info(function_info);
+        g_variant_unref(record);
+        record = NULL;
+    }
+
+    if (record == NULL) {
+        arg_map_determine_argument_presence(amap, function_info);
+        arg_map_compute_c_invoke_positions(amap);
+        arg_map_compute_s_call_positions(amap);
+        if (gig_binding_cache_enabled())
+            gig_binding_cache_store(function_info, arg_map_to_record(amap));
+    }
+    else
+        g_variant_unref(record);
+
+    arg_map_build_index_tables(amap);
+    arg_map_resolve_converters(amap);
     gig_amap_dump(name, amap);
     return amap;
 }
@@ -85,6 +123,7 @@ arg_map_allocate(gsize n)
 
     amap = g_new0(GigArgMap, 1);
     amap->pdata = g_new0(GigArgMapEntry, n);
+    gig_load_stats_count(GIG_LOAD_BYTES, sizeof(GigArgMap) + n * sizeof(GigArgMapEntry));
     amap->len = n;
     for (gsize i = 0; i < n; i++) {
         arg_map_entry_init(&amap->pdata[i]);
@@ -179,6 +218,19 @@ arg_map_determine_argument_presence(GigArgMap *amap, GIFunctionInfo *info)
     g_base_info_unref(return_type);
 }
 
+// Returns how ENTRY, an argument, is passed, as its type says.
+static GigArgDirection
+arg_map_entry_direction(const GigArgMapEntry *entry)
+{
+    if (entry->meta.is_in && !entry->meta.is_out)
+        return GIG_ARG_DIRECTION_INPUT;
+    if (entry->meta.is_in && entry->meta.is_out)
+        return GIG_ARG_DIRECTION_INOUT;
+    if (entry->meta.is_out && entry->meta.is_caller_allocates)
+        return GIG_ARG_DIRECTION_PREALLOCATED_OUTPUT;
+    return GIG_ARG_DIRECTION_OUTPUT;
+}
+
 static void
 arg_map_compute_c_invoke_positions(GigArgMap *amap)
 {
@@ -195,25 +247,13 @@ arg_map_compute_c_invoke_positions(GigArgMap *amap)
         // g_function_info_invoke call.  Also, some output parameters
         // require a SCM container to be passed in to the SCM GSubr
         // call.
-        if (entry->meta.is_in && !entry->meta.is_out) {
-            entry->s_direction = GIG_ARG_DIRECTION_INPUT;
+        entry->s_direction = arg_map_entry_direction(entry);
+        if (entry->s_direction == GIG_ARG_DIRECTION_INPUT
+            || entry->s_direction == GIG_ARG_DIRECTION_INOUT) {
             entry->is_c_input = 1;
             entry->c_input_pos = c_input_pos++;
         }
-        else if (entry->meta.is_in && entry->meta.is_out) {
-            entry->s_direction = GIG_ARG_DIRECTION_INOUT;
-            entry->is_c_input = 1;
-            entry->c_input_pos = c_input_pos++;
-            entry->is_c_output = 1;
-            entry->c_output_pos = c_output_pos++;
-        }
-        else if (entry->meta.is_out && entry->meta.is_caller_allocates) {
-            entry->s_direction = GIG_ARG_DIRECTION_PREALLOCATED_OUTPUT;
-            entry->is_c_output = 1;
-            entry->c_output_pos = c_output_pos++;
-        }
-        else {
-            entry->s_direction = GIG_ARG_DIRECTION_OUTPUT;
+        if (entry->s_direction != GIG_ARG_DIRECTION_INPUT) {
             entry->is_c_output = 1;
             entry->c_output_pos = c_output_pos++;
         }
@@ -274,6 +314,257 @@ arg_map_compute_s_call_positions(GigArgMap *amap)
     g_assert_cmpint(amap->s_input_req + amap->s_input_opt, ==, s_input_pos);
 }
 
+static void
+arg_map_build_index_tables(GigArgMap *amap)
+{
+    gint s_input_len = amap->s_input_req + amap->s_input_opt;
+
+    // All four tables share one block.
+    gsize n_slots = s_input_len + amap->s_output_len + amap->c_input_len + amap->c_output_len;
+    GigArgMapEntry **tables = g_new0(GigArgMapEntry *, n_slots);
+    gig_load_stats_count(GIG_LOAD_BYTES, n_slots * sizeof(GigArgMapEntry *));
+    amap->s_input_entries = tables;
+    amap->s_output_entries = amap->s_input_entries + s_input_len;
+    amap->c_input_entries = amap->s_output_entries + amap->s_output_len;
+    amap->c_output_entries = amap->c_input_entries + amap->c_input_len;
+
+    for (gint i = 0; i < amap->len; i++) {
+        GigArgMapEntry *entry = &amap->pdata[i];
+        if (entry->is_s_input)
+            amap->s_input_entries[entry->s_input_pos] = entry;
+        if (entry->is_s_output)
+            amap->s_output_entries[entry->s_output_pos] = entry;
+        if (entry->is_c_input)
+            amap->c_input_entries[entry->c_input_pos] = entry;
+        if (entry->is_c_output)
+            amap->c_output_entries[entry->c_output_pos] = entry;
+    }
+}
+
+static void
+arg_map_resolve_converters(GigArgMap *amap)
+{
+    for (gint i = 0; i < amap->len; i++) {
+        GigArgMapEntry *entry = &amap->pdata[i];
+        entry->s2c = gig_argument_resolve_scm_to_c(&entry->meta);
+        entry->c2s = gig_argument_resolve_c_to_scm(&entry->meta);
+    }
+    amap->return_val.s2c = gig_argument_resolve_scm_to_c(&amap->return_val.meta);
+    amap->return_val.c2s = gig_argument_resolve_c_to_scm(&amap->return_val.meta);
+}
+
+// The layout of an argument map in the binding cache: its counts, its
+// entries and its return value.  An entry holds its direction, tuple,
+// presence, flags, positions and the index of its child, or -1.
+#define GIG_AMAP_RECORD_TYPE "((iiiii)a(yyyyiiiii)(yyyyiiiii))"
+#define GIG_AMAP_ENTRY_RECORD_TYPE "(yyyyiiiii)"
+
+static GVariant *
+arg_map_entry_to_record(GigArgMap *amap, GigArgMapEntry *entry)
+{
+    guint8 flags = (entry->is_c_input | entry->is_c_output << 1
+                    | entry->is_s_input << 2 | entry->is_s_output << 3);
+
+    return g_variant_new(GIG_AMAP_ENTRY_RECORD_TYPE, entry->s_direction, entry->tuple,
+                         entry->presence, flags, entry->c_input_pos, entry->c_output_pos,
+                         entry->s_input_pos, entry->s_output_pos,
+                         entry->child ? (gint)(entry->child - amap->pdata) : -1);
+}
+
+static GVariant *
+arg_map_to_record(GigArgMap *amap)
+{
+    GVariantBuilder entries;
+
+    g_variant_builder_init(&entries, G_VARIANT_TYPE("a" GIG_AMAP_ENTRY_RECORD_TYPE));
+    for (gint i = 0; i < amap->len; i++)
+        g_variant_builder_add_value(&entries, arg_map_entry_to_record(amap, &amap->pdata[i]));
+
+    return g_variant_new("((iiiii)@a" GIG_AMAP_ENTRY_RECORD_TYPE "@" GIG_AMAP_ENTRY_RECORD_TYPE ")",
+                         amap->s_input_req, amap->s_input_opt, amap->s_output_len,
+                         amap->c_input_len, amap->c_output_len, g_variant_builder_end(&entries),
+                         arg_map_entry_to_record(amap, &amap->return_val));
+}
+
+static gboolean
+arg_map_entry_apply_record(GigArgMap *amap, GigArgMapEntry *entry, GVariant *record)
+{
+    guint8 direction, tuple, presence, flags;
+    gint child;
+
+    g_variant_get(record, GIG_AMAP_ENTRY_RECORD_TYPE, &direction, &tuple, &presence, &flags,
+                  &entry->c_input_pos, &entry->c_output_pos, &entry->s_input_pos,
+                  &entry->s_output_pos, &child);
+    if (direction >= GIG_ARG_DIRECTION_COUNT || tuple >= GIG_ARG_TUPLE_COUNT
+        || presence >= GIG_ARG_PRESENCE_COUNT || flags > 0xf || child < -1
+        || child >= amap->len || amap->pdata + child == entry)
+        return FALSE;
+
+    entry->s_direction = direction;
+    entry->tuple = tuple;
+    entry->presence = presence;
+    entry->is_c_input = flags & 1;
+    entry->is_c_output = (flags >> 1) & 1;
+    entry->is_s_input = (flags >> 2) & 1;
+    entry->is_s_output = (flags >> 3) & 1;
+
+    // Only a sized array has a child, which holds its length and
+    // belongs to no other array.
+    gboolean sized = (entry->meta.gtype == G_TYPE_ARRAY && entry->meta.has_size);
+    if ((tuple == GIG_ARG_TUPLE_ARRAY) != sized || (child >= 0) != sized)
+        return FALSE;
+    if (child >= 0) {
+        entry->child = amap->pdata + child;
+        if (entry->child->parent != NULL)
+            return FALSE;
+        entry->child->parent = entry;
+    }
+    return TRUE;
+}
+
+// Checks that ENTRY, an argument, is laid out as its type and its
+// tuple allow.
+static gboolean
+arg_map_entry_check(GigArgMapEntry *entry)
+{
+    GigArgDirection direction = arg_map_entry_direction(entry);
+    gboolean size = (entry->tuple == GIG_ARG_TUPLE_ARRAY_SIZE);
+
+    if (entry->s_direction != direction || size != (entry->parent != NULL))
+        return FALSE;
+    if (entry->is_c_input != (direction == GIG_ARG_DIRECTION_INPUT
+                              || direction == GIG_ARG_DIRECTION_INOUT)
+        || entry->is_c_output != (direction != GIG_ARG_DIRECTION_INPUT))
+        return FALSE;
+    if (entry->is_s_input != (!size && direction != GIG_ARG_DIRECTION_OUTPUT)
+        || entry->is_s_output != (!size && direction != GIG_ARG_DIRECTION_INPUT))
+        return FALSE;
+    // Only nullable arguments are optional, and only Scheme inputs
+    // are given.
+    if (entry->is_s_input != (entry->presence != GIG_ARG_PRESENCE_IMPLICIT)
+        || (entry->presence == GIG_ARG_PRESENCE_OPTIONAL && !entry->meta.is_nullable))
+        return FALSE;
+    return TRUE;
+}
+
+// Claims slot POS of a table of LEN slots, whose claims are counted
+// in SEEN.
+static gboolean
+claim_slot(guint8 *seen, gint len, gboolean flag, gint pos)
+{
+    if (!flag)
+        return TRUE;
+    if (pos < 0 || pos >= len || seen[pos])
+        return FALSE;
+    seen[pos] = 1;
+    return TRUE;
+}
+
+// Checks that the entries of AMAP fill each slot of its index tables
+// exactly once, and that its optional Scheme inputs follow the
+// required ones.
+static gboolean
+arg_map_check_tables(GigArgMap *amap)
+{
+    gint s_input_len = amap->s_input_req + amap->s_input_opt;
+    gint lens[4] = { s_input_len, amap->s_output_len, amap->c_input_len, amap->c_output_len };
+    gint counts[4] = { 0, 0, 0, 0 };
+    gint required = 0;
+    gboolean ok = TRUE;
+
+    for (gint t = 0; t < 4; t++)
+        if (lens[t] > amap->len)
+            return FALSE;
+
+    guint8 *seen = g_new0(guint8, s_input_len + amap->s_output_len + amap->c_input_len
+                          + amap->c_output_len);
+    guint8 *s_input_seen = seen;
+    guint8 *s_output_seen = s_input_seen + s_input_len;
+    guint8 *c_input_seen = s_output_seen + amap->s_output_len;
+    guint8 *c_output_seen = c_input_seen + amap->c_input_len;
+
+    for (gint i = 0; ok && i < amap->len; i++) {
+        GigArgMapEntry *entry = &amap->pdata[i];
+
+        ok = (claim_slot(s_input_seen, s_input_len, entry->is_s_input, entry->s_input_pos)
+              && claim_slot(s_output_seen, amap->s_output_len, entry->is_s_output,
+                            entry->s_output_pos)
+              && claim_slot(c_input_seen, amap->c_input_len, entry->is_c_input,
+                            entry->c_input_pos)
+              && claim_slot(c_output_seen, amap->c_output_len, entry->is_c_output,
+                            entry->c_output_pos));
+        counts[0] += entry->is_s_input;
+        counts[1] += entry->is_s_output;
+        counts[2] += entry->is_c_input;
+        counts[3] += entry->is_c_output;
+        if (entry->presence == GIG_ARG_PRESENCE_REQUIRED) {
+            required++;
+            // A required input after an optional one could not be
+            // given alone.
+            ok = ok && entry->s_input_pos < amap->s_input_req;
+        }
+    }
+    g_free(seen);
+
+    for (gint t = 0; ok && t < 4; t++)
+        ok = (counts[t] == lens[t]);
+    return ok && required == amap->s_input_req;
+}
+
+// Lays AMAP out as RECORD says.  The record comes from a file, so it
+// must describe the layout that computing it would give: each entry
+// agrees with its type from the typelib, and the index tables are
+// filled exactly.
+static gboolean
+arg_map_apply_record(GigArgMap *amap, GVariant *record)
+{
+    GVariant *entries, *return_val;
+    gboolean ok;
+
+    if (!g_variant_is_of_type(record, G_VARIANT_TYPE(GIG_AMAP_RECORD_TYPE)))
+        return FALSE;
+
+    g_variant_get(record, "((iiiii)@a" GIG_AMAP_ENTRY_RECORD_TYPE "@" GIG_AMAP_ENTRY_RECORD_TYPE ")",
+                  &amap->s_input_req, &amap->s_input_opt, &amap->s_output_len,
+                  &amap->c_input_len, &amap->c_output_len, &entries, &return_val);
+
+    ok = (amap->s_input_req >= 0 && amap->s_input_opt >= 0 && amap->s_output_len >= 0
+          && amap->c_input_len >= 0 && amap->c_output_len >= 0
+          && g_variant_n_children(entries) == (gsize)amap->len);
+
+    for (gint i = 0; ok && i < amap->len; i++) {
+        GVariant *entry_record = g_variant_get_child_value(entries, i);
+        ok = arg_map_entry_apply_record(amap, &amap->pdata[i], entry_record);
+        g_variant_unref(entry_record);
+    }
+    ok = ok && arg_map_entry_apply_record(amap, &amap->return_val, return_val);
+
+    // Children are claimed while the entries are read, so the entries
+    // are checked once all are read.
+    for (gint i = 0; ok && i < amap->len; i++)
+        ok = arg_map_entry_check(&amap->pdata[i]);
+    ok = (ok && arg_map_check_tables(amap)
+          && amap->return_val.s_direction == (amap->return_val.meta.is_out
+                                              ? GIG_ARG_DIRECTION_OUTPUT
+                                              : GIG_ARG_DIRECTION_VOID)
+          && !amap->return_val.is_c_input && !amap->return_val.is_c_output
+          && !amap->return_val.is_s_input && !amap->return_val.is_s_output);
+
+    g_variant_unref(entries);
+    g_variant_unref(return_val);
+    return ok;
+}
+
+// Returns the entry for the gsubr argument SPOS, or NULL if there is
+// no such argument.
+static GigArgMapEntry *
+input_entry_by_s(const GigArgMap *amap, gint spos)
+{
+    if (spos < 0 || spos >= amap->s_input_req + amap->s_input_opt)
+        return NULL;
+    return amap->s_input_entries[spos];
+}
+
 void
 gig_amap_free(GigArgMap *amap)
 {
@@ -287,6 +578,7 @@ gig_amap_free(GigArgMap *amap)
     gig_data_type_free(&amap->return_val.meta);
     g_free(amap->return_val.name);
     g_free(amap->pdata);
+    g_free(amap->s_input_entries);
     g_free(amap->name);
     amap->pdata = NULL;
     g_free(amap);
@@ -295,6 +587,9 @@ gig_amap_free(GigArgMap *amap)
 void
 gig_amap_dump(const gchar *name, const GigArgMap *amap)
 {
+    if (!gig_debug_enabled(GIG_DEBUG_AMAP))
+        return;
+
     gig_debug_amap("%s - argument mapping", name ? name : amap->name);
     gig_debug_amap(" SCM inputs required: %d, optional: %d, outputs: %d", amap->s_input_req,
                    amap->s_input_opt, amap->s_output_len);
@@ -360,14 +655,9 @@ GigArgMapEntry *
 gig_amap_get_input_entry_by_s(GigArgMap *amap, gint spos)
 {
     g_assert_nonnull(amap);
-    gint i = 0;
-    while (i < amap->len) {
-        if (amap->pdata[i].is_s_input && (amap->pdata[i].s_input_pos == spos)) {
-            return &amap->pdata[i];
-        }
-        i++;
-    }
-    g_assert_not_reached();
+    GigArgMapEntry *entry = input_entry_by_s(amap, spos);
+    g_assert_nonnull(entry);
+    return entry;
 }
 
 GigArgMapEntry *
@@ -375,14 +665,9 @@ gig_amap_get_output_entry_by_c(GigArgMap *amap, gint cpos)
 {
     g_assert_nonnull(amap);
 
-    gint i = 0;
-    while (i < amap->len) {
-        if (amap->pdata[i].is_c_output && (amap->pdata[i].c_output_pos == cpos)) {
-            return &amap->pdata[i];
-        }
-        i++;
-    }
-    g_return_val_if_reached(NULL);
+    if (cpos < 0 || cpos >= amap->c_output_len)
+        g_return_val_if_reached(NULL);
+    return amap->c_output_entries[cpos];
 }
 
 // If this output element is an array with another output element
@@ -394,15 +679,12 @@ gig_amap_output_child_c(GigArgMap *amap, gint c_output_pos, gint *cinvoke_output
     g_assert_nonnull(amap);
     g_assert_nonnull(cinvoke_output_array_size_index);
 
-    gint i = 0;
-    while (i < amap->len) {
-        if (amap->pdata[i].is_c_output && (amap->pdata[i].c_output_pos == c_output_pos)) {
-            if (amap->pdata[i].child) {
-                *cinvoke_output_array_size_index = amap->pdata[i].child->c_output_pos;
-                return TRUE;
-            }
-        }
-        i++;
+    if (c_output_pos < 0 || c_output_pos >= amap->c_output_len)
+        return FALSE;
+    GigArgMapEntry *entry = amap->c_output_entries[c_output_pos];
+    if (entry->child) {
+        *cinvoke_output_array_size_index = entry->child->c_output_pos;
+        return TRUE;
     }
     return FALSE;
 }
@@ -430,19 +712,13 @@ gig_amap_input_s_2_input_c(const GigArgMap *amap, gint s_input_pos, gint *c_inpu
     g_assert_nonnull(amap);
     g_assert_nonnull(c_input_pos);
 
-    gint i = 0;
-    while (i < amap->len) {
-        if (amap->pdata[i].is_s_input && (amap->pdata[i].s_input_pos == s_input_pos)) {
-            if (amap->pdata[i].is_c_input) {
-                *c_input_pos = amap->pdata[i].c_input_pos;
-                return TRUE;
-            }
-            else
-                return FALSE;
-        }
-        i++;
-    }
-    g_return_val_if_reached(FALSE);
+    GigArgMapEntry *entry = input_entry_by_s(amap, s_input_pos);
+    if (entry == NULL)
+        g_return_val_if_reached(FALSE);
+    if (!entry->is_c_input)
+        return FALSE;
+    *c_input_pos = entry->c_input_pos;
+    return TRUE;
 }
 
 gboolean
@@ -451,19 +727,13 @@ gig_amap_input_s_2_output_c(const GigArgMap *amap, gint s_input_pos, gint *c_out
     g_assert_nonnull(amap);
     g_assert_nonnull(c_output_pos);
 
-    gint i = 0;
-    while (i < amap->len) {
-        if (amap->pdata[i].is_s_input && (amap->pdata[i].s_input_pos == s_input_pos)) {
-            if (amap->pdata[i].is_c_output) {
-                *c_output_pos = amap->pdata[i].c_output_pos;
-                return TRUE;
-            }
-            else
-                return FALSE;
-        }
-        i++;
-    }
-    g_return_val_if_reached(FALSE);
+    GigArgMapEntry *entry = input_entry_by_s(amap, s_input_pos);
+    if (entry == NULL)
+        g_return_val_if_reached(FALSE);
+    if (!entry->is_c_output)
+        return FALSE;
+    *c_output_pos = entry->c_output_pos;
+    return TRUE;
 }
 
 // For the gsubr argument at position INDEX, if it is an array whose
@@ -477,24 +747,13 @@ gig_amap_input_s_2_child_input_c(const GigArgMap *amap, gint s_input_pos, gint *
     g_assert_nonnull(amap);
     g_assert_nonnull(c_input_pos);
 
-    gint i = 0;
-    while (i < amap->len) {
-        if (amap->pdata[i].is_s_input && (amap->pdata[i].s_input_pos == s_input_pos)) {
-            GigArgMapEntry *child = amap->pdata[i].child;
-            if (child) {
-                if (child->is_c_input) {
-                    *c_input_pos = child->c_input_pos;
-                    return TRUE;
-                }
-                else
-                    return FALSE;
-            }
-            else
-                return FALSE;
-        }
-        i++;
-    }
-    g_return_val_if_reached(FALSE);
+    GigArgMapEntry *entry = input_entry_by_s(amap, s_input_pos);
+    if (entry == NULL)
+        g_return_val_if_reached(FALSE);
+    if (entry->child == NULL || !entry->child->is_c_input)
+        return FALSE;
+    *c_input_pos = entry->child->c_input_pos;
+    return TRUE;
 }
 
 gboolean
@@ -503,24 +762,13 @@ gig_amap_input_s_2_child_output_c(const GigArgMap *amap, gint s_input_pos, gint
     g_assert_nonnull(amap);
     g_assert_nonnull(c_output_pos);
 
-    gint i = 0;
-    while (i < amap->len) {
-        if (amap->pdata[i].is_s_input && (amap->pdata[i].s_input_pos == s_input_pos)) {
-            GigArgMapEntry *child = amap->pdata[i].child;
-            if (child) {
-                if (child->is_c_output) {
-                    *c_output_pos = child->c_output_pos;
-                    return TRUE;
-                }
-                else
-                    return FALSE;
-            }
-            else
-                return FALSE;
-        }
-        i++;
-    }
-    g_return_val_if_reached(FALSE);
+    GigArgMapEntry *entry = input_entry_by_s(amap, s_input_pos);
+    if (entry == NULL)
+        g_return_val_if_reached(FALSE);
+    if (entry->child == NULL || !entry->child->is_c_output)
+        return FALSE;
+    *c_output_pos = entry->child->c_output_pos;
+    return TRUE;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -553,33 +801,20 @@ gig_amap_input_c2i(const GigArgMap *amap, gint cpos, gint *i)
     if (cpos < 0 || cpos >= amap->c_input_len) {
         g_return_val_if_reached(FALSE);
     }
-    gint j = 0;
-    while (j < amap->len) {
-        if (amap->pdata[j].is_c_input && (amap->pdata[j].c_input_pos == cpos)) {
-            *i = j;
-            return TRUE;
-        }
-        j++;
-    }
-    return FALSE;
+    *i = amap->c_input_entries[cpos]->i;
+    return TRUE;
 }
 
 
 gboolean
 gig_amap_input_s2i(const GigArgMap *amap, gint spos, gint *i)
 {
-    if (spos < 0 || spos >= amap->s_input_req + amap->s_input_opt) {
+    GigArgMapEntry *entry = input_entry_by_s(amap, spos);
+    if (entry == NULL) {
         g_return_val_if_reached(FALSE);
     }
-    gint j = 0;
-    while (j < amap->len) {
-        if (amap->pdata[j].is_s_input && (amap->pdata[j].s_input_pos == spos)) {
-            *i = j;
-            return TRUE;
-        }
-        j++;
-    }
-    return FALSE;
+    *i = entry->i;
+    return TRUE;
 }
 
 gboolean
@@ -588,41 +823,24 @@ gig_amap_input_c2s(const GigArgMap *amap, gint cpos, gint *spos)
     if (cpos < 0 || cpos >= amap->c_input_len) {
         g_return_val_if_reached(FALSE);
     }
-    gint j = 0;
-    while (j < amap->len) {
-        if (amap->pdata[j].is_c_input && (amap->pdata[j].c_input_pos == cpos)) {
-            if (amap->pdata[j].is_s_input) {
-                *spos = amap->pdata[j].s_input_pos;
-                return TRUE;
-            }
-            else {
-                return FALSE;
-            }
-        }
-        j++;
-    }
-    return FALSE;
+    GigArgMapEntry *entry = amap->c_input_entries[cpos];
+    if (!entry->is_s_input)
+        return FALSE;
+    *spos = entry->s_input_pos;
+    return TRUE;
 }
 
 gboolean
 gig_amap_input_s2c(const GigArgMap *am, gint spos, gint *cpos)
 {
-    if (spos < 0 || spos >= am->s_input_req + am->s_input_opt) {
+    GigArgMapEntry *entry = input_entry_by_s(am, spos);
+    if (entry == NULL) {
         g_return_val_if_reached(FALSE);
     }
-    int j = 0;
-    while (j < am->len) {
-        if (am->pdata[j].is_s_input && (am->pdata[j].s_input_pos == spos)) {
-            if (am->pdata[j].is_c_input) {
-                *cpos = am->pdata[j].c_input_pos;
-                return TRUE;
-            }
-            else
-                return FALSE;
-        }
-        j++;
-    }
-    return FALSE;
+    if (!entry->is_c_input)
+        return FALSE;
+    *cpos = entry->c_input_pos;
+    return TRUE;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -654,15 +872,8 @@ gig_amap_output_c2i(const GigArgMap *amap, gint cpos, gint *i)
 {
     if (cpos < 0 || cpos >= amap->c_output_len)
         g_return_val_if_reached(FALSE);
-    gint j = 0;
-    while (j < amap->len) {
-        if (amap->pdata[j].is_c_output && (amap->pdata[j].c_output_pos == cpos)) {
-            *i = j;
-            return TRUE;
-        }
-        j++;
-    }
-    return FALSE;
+    *i = amap->c_output_entries[cpos]->i;
+    return TRUE;
 }
 
 
@@ -671,15 +882,8 @@ gig_amap_output_s2i(const GigArgMap *amap, gint spos, gint *i)
 {
     if (spos < 0 || spos >= amap->s_output_len)
         g_return_val_if_reached(FALSE);
-    gint j = 0;
-    while (j < amap->len) {
-        if (amap->pdata[j].is_s_output && (amap->pdata[j].s_output_pos == spos)) {
-            *i = j;
-            return TRUE;
-        }
-        j++;
-    }
-    return FALSE;
+    *i = amap->s_output_entries[spos]->i;
+    return TRUE;
 }
 
 gboolean
@@ -687,19 +891,11 @@ gig_amap_output_c2s(const GigArgMap *amap, gint cpos, gint *spos)
 {
     if (cpos < 0 || cpos >= amap->c_output_len)
         g_return_val_if_reached(FALSE);
-    gint j = 0;
-    while (j < amap->len) {
-        if (amap->pdata[j].is_c_output && (amap->pdata[j].c_output_pos == cpos)) {
-            if (amap->pdata[j].is_s_output) {
-                *spos = amap->pdata[j].s_output_pos;
-                return TRUE;
-            }
-            else
-                return FALSE;
-        }
-        j++;
-    }
-    return FALSE;
+    GigArgMapEntry *entry = amap->c_output_entries[cpos];
+    if (!entry->is_s_output)
+        return FALSE;
+    *spos = entry->s_output_pos;
+    return TRUE;
 }
 
 gboolean
@@ -707,19 +903,11 @@ gig_amap_output_s2c(const GigArgMap *am, gint spos, gint *cpos)
 {
     if (spos < 0 || spos >= am->s_output_len)
         g_return_val_if_reached(FALSE);
-    int j = 0;
-    while (j < am->len) {
-        if (am->pdata[j].is_s_output && (am->pdata[j].s_output_pos == spos)) {
-            if (am->pdata[j].is_c_output) {
-                *cpos = am->pdata[j].c_output_pos;
-                return TRUE;
-            }
-            else
-                return FALSE;
-        }
-        j++;
-    }
-    return FALSE;
+    GigArgMapEntry *entry = am->s_output_entries[spos];
+    if (!entry->is_c_output)
+        return FALSE;
+    *cpos = entry->c_output_pos;
+    return TRUE;
 }
 
 ////////////////////////////////////////////////////////////////
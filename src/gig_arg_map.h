@@ -18,6 +18,8 @@
 
 #include <glib.h>
 #include <girepository.h>
+#include <libguile.h>
+#include "gig_arena.h"
 #include "gig_data_type.h"
 
 // *INDENT-OFF*
@@ -54,6 +56,13 @@ typedef enum
     GIG_ARG_PRESENCE_COUNT
 } GigArgPresence;
 
+// Converters between SCM objects and GIArguments, as chosen by
+// gig_argument_resolve_scm_to_c and gig_argument_resolve_c_to_scm.
+typedef void (*GigArgumentS2C)(const gchar *subr, gint argpos, GigTypeMeta *meta, SCM object,
+                               GigArena *must_free, GIArgument *arg, gsize *size);
+typedef void (*GigArgumentC2S)(const gchar *subr, gint argpos, GigTypeMeta *meta,
+                               GIArgument *arg, SCM *object, gsize size);
+
 // This structure contains the information necessary for choosing how
 // to convert between scheme and C arguments of a function or method
 // call.
@@ -95,6 +104,10 @@ struct _GigArgMapEntry
 
     GigArgMapEntry *child;
     GigArgMapEntry *parent;
+
+    // The converters for this argument's type.
+    GigArgumentS2C s2c;
+    GigArgumentC2S c2s;
 };
 
 typedef struct _GigArgMap GigArgMap;
@@ -121,6 +134,14 @@ struct _GigArgMap
     gint len;
 
     GigArgMapEntry return_val;
+
+    // Lookup tables from the SCM and C positions of arguments to
+    // their entries, so that translating a position doesn't have to
+    // search PDATA.
+    GigArgMapEntry **s_input_entries;
+    GigArgMapEntry **s_output_entries;
+    GigArgMapEntry **c_input_entries;
+    GigArgMapEntry **c_output_entries;
 };
 
 GigArgMap *gig_amap_new(const gchar *name, GICallableInfo *function_info);
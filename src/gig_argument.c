@@ -37,13 +37,20 @@
         g_error("unhandled argument type '%s' %s:%d", gig_type_meta_describe(meta), __FILE__, __LINE__); \
     } while(FALSE)
 
-static gpointer later_free(GPtrArray *must_free, GigTypeMeta *meta, gpointer ptr);
+static gpointer later_free(GigArena *must_free, GigTypeMeta *meta, gpointer ptr, gsize size);
+static gpointer scratch_alloc(GigArena *must_free, GigTypeMeta *meta, gsize size);
 
 // Fundamental types
 static void scm_to_c_interface(S2C_ARG_DECL);
 static void scm_to_c_char(S2C_ARG_DECL);
 static void scm_to_c_boolean(S2C_ARG_DECL);
 static void scm_to_c_integer(S2C_ARG_DECL);
+static void scm_to_c_int8(S2C_ARG_DECL);
+static void scm_to_c_int16(S2C_ARG_DECL);
+static void scm_to_c_int32(S2C_ARG_DECL);
+static void scm_to_c_uint8(S2C_ARG_DECL);
+static void scm_to_c_uint16(S2C_ARG_DECL);
+static void scm_to_c_uint32(S2C_ARG_DECL);
 static void scm_to_c_enum(S2C_ARG_DECL);
 static void scm_to_c_real(S2C_ARG_DECL);
 static void scm_to_c_string(S2C_ARG_DECL);
@@ -88,16 +95,29 @@ static void c_gptrarray_to_scm(C2S_ARG_DECL);
 static void c_ghashtable_to_scm(C2S_ARG_DECL);
 static void c_list_to_scm(C2S_ARG_DECL);
 
-// Use this to register allocated data to be freed after use.
+// Use this to register allocated data of SIZE bytes to be freed after
+// use.
 static gpointer
-later_free(GPtrArray *must_free, GigTypeMeta *meta, gpointer ptr)
+later_free(GigArena *must_free, GigTypeMeta *meta, gpointer ptr, gsize size)
 {
     if ((must_free != NULL) && meta->transfer != GI_TRANSFER_EVERYTHING)
-        g_ptr_array_insert(must_free, 0, ptr);
+        gig_arena_release_later(must_free, ptr, size, g_free);
     return ptr;
 }
 
-#define LATER_FREE(_ptr) later_free(must_free, meta, _ptr)
+// Use this to allocate zeroed memory for an argument.  Memory that
+// the callee doesn't take ownership of comes from the call's scratch
+// arena and is released when the call returns.
+static gpointer
+scratch_alloc(GigArena *must_free, GigTypeMeta *meta, gsize size)
+{
+    if ((must_free != NULL) && meta->transfer == GI_TRANSFER_NOTHING)
+        return gig_arena_alloc(must_free, size);
+    return g_malloc0(size);
+}
+
+#define LATER_FREE_STRING(_str) later_free(must_free, meta, _str, strlen(_str) + 1)
+#define SCRATCH_ALLOC(_size) scratch_alloc(must_free, meta, _size)
 
 static GType
 child_type(GigTypeMeta *meta, GIArgument *arg)
@@ -248,6 +268,81 @@ gig_argument_scm_to_c(S2C_ARG_DECL)
     }
 }
 
+// Returns the converter to use for arguments of type META.  This does
+// the dispatch of gig_argument_scm_to_c once, ahead of time, and picks
+// a converter with a fixnum fast path for the common integer types.
+GigArgumentS2C
+gig_argument_resolve_scm_to_c(GigTypeMeta *meta)
+{
+    switch (G_TYPE_FUNDAMENTAL(meta->gtype)) {
+    case G_TYPE_INTERFACE:
+        return scm_to_c_interface;
+    case G_TYPE_CHAR:
+    case G_TYPE_UCHAR:
+        return scm_to_c_char;
+    case G_TYPE_BOOLEAN:
+        return scm_to_c_boolean;
+    case G_TYPE_INT:
+        switch (meta->item_size) {
+        case 1:
+            return scm_to_c_int8;
+        case 2:
+            return scm_to_c_int16;
+        case 4:
+            return scm_to_c_int32;
+        default:
+            return scm_to_c_integer;
+        }
+    case G_TYPE_UINT:
+        if (meta->is_unichar)
+            return scm_to_c_integer;
+        switch (meta->item_size) {
+        case 1:
+            return scm_to_c_uint8;
+        case 2:
+            return scm_to_c_uint16;
+        case 4:
+            return scm_to_c_uint32;
+        default:
+            return scm_to_c_integer;
+        }
+    case G_TYPE_INT64:
+    case G_TYPE_UINT64:
+        return scm_to_c_integer;
+    case G_TYPE_ENUM:
+    case G_TYPE_FLAGS:
+        return scm_to_c_enum;
+    case G_TYPE_FLOAT:
+    case G_TYPE_DOUBLE:
+        return scm_to_c_real;
+    case G_TYPE_STRING:
+        return scm_to_c_string;
+    case G_TYPE_POINTER:
+        return scm_to_c_pointer;
+    case G_TYPE_BOXED:
+        return scm_to_c_boxed;
+    case G_TYPE_OBJECT:
+        return scm_to_c_object;
+    case G_TYPE_VARIANT:
+        return scm_to_c_variant;
+    default:
+        // Let the generic converter complain about it.
+        return gig_argument_scm_to_c;
+    }
+}
+
+// Converts OBJECT to a C argument, using the converter resolved for
+// ENTRY.
+void
+gig_argument_entry_scm_to_c(GigArgMapEntry *entry, const gchar *subr, gint argpos, SCM object,
+                            GigArena *must_free, GIArgument *arg, gsize *size)
+{
+    arg->v_pointer = NULL;
+    if (size)
+        *size = 0;
+    entry->s2c(subr, argpos, &entry->meta, object, must_free, arg, size);
+}
+
 static void
 scm_to_c_interface(S2C_ARG_DECL)
 {
@@ -384,6 +479,30 @@ scm_to_c_integer(S2C_ARG_DECL)
         UNHANDLED;
 }
 
+// Integers that fit in a fixnum, which is most of them, can skip the
+// range checks of scm_to_c_integer.
+#define FIXNUM_S2C(t,min,max)                                           \
+    static void                                                         \
+    scm_to_c_ ## t(S2C_ARG_DECL)                                        \
+    {                                                                   \
+        if (SCM_I_INUMP(object)) {                                      \
+            scm_t_signed_bits n = SCM_I_INUM(object);                   \
+            if (n >= (min) && n <= (max)) {                             \
+                arg->v_ ## t = n;                                       \
+                return;                                                 \
+            }                                                           \
+        }                                                               \
+        scm_to_c_integer(S2C_ARGS);                                     \
+    }
+
+FIXNUM_S2C(int8, INT8_MIN, INT8_MAX)
+FIXNUM_S2C(int16, INT16_MIN, INT16_MAX)
+FIXNUM_S2C(int32, INT32_MIN, INT32_MAX)
+FIXNUM_S2C(uint8, 0, UINT8_MAX)
+FIXNUM_S2C(uint16, 0, UINT16_MAX)
+FIXNUM_S2C(uint32, 0, (scm_t_signed_bits)MIN(UINT32_MAX, SCM_MOST_POSITIVE_FIXNUM))
+#undef FIXNUM_S2C
+
 static void
 scm_to_c_enum(S2C_ARG_DECL)
 {
@@ -462,7 +581,7 @@ scm_to_c_string(S2C_ARG_DECL)
             arg->v_string = scm_to_locale_string(object);
         else
             arg->v_string = scm_to_utf8_string(object);
-        LATER_FREE(arg->v_string);
+        LATER_FREE_STRING(arg->v_string);
     }
     else
         scm_wrong_type_arg_msg(subr, argpos, object, "string or bytevector");
@@ -527,7 +646,7 @@ scm_to_c_object(S2C_ARG_DECL)
         arg->v_pointer = NULL;
     }
     else {
-        if (!gig_type_check_typed_object(object, scm_from_gtype(meta->gtype)))
+        if (!gig_type_check_object_gtype(object, meta->gtype))
             scm_wrong_type_arg_msg(subr, argpos, object, g_type_name(meta->gtype));
 
         arg->v_pointer = gig_type_peek_object(object);
@@ -580,14 +699,11 @@ scm_to_c_native_boolean_array(S2C_ARG_DECL)
         scm_wrong_type_arg_msg(subr, argpos, object, "vector of booleans");
     *size = scm_c_vector_length(object);
     if (meta->is_zero_terminated) {
-        arg->v_pointer = malloc(sizeof(gboolean) * (*size + 1));
+        arg->v_pointer = SCRATCH_ALLOC(sizeof(gboolean) * (*size + 1));
         ((gboolean *)arg->v_pointer)[*size] = 0;
-        LATER_FREE(arg->v_pointer);
-    }
-    else {
-        arg->v_pointer = malloc(sizeof(gboolean) * *size);
-        LATER_FREE(arg->v_pointer);
     }
+    else
+        arg->v_pointer = SCRATCH_ALLOC(sizeof(gboolean) * *size);
     for (gsize i = 0; i < *size; i++)
         ((gboolean *)(arg->v_pointer))[i] = (gboolean)scm_is_true(scm_c_vector_ref(object, i));
 }
@@ -602,14 +718,11 @@ scm_to_c_native_unichar_array(S2C_ARG_DECL)
         scm_wrong_type_arg_msg(subr, argpos, object, "string");
     *size = scm_c_string_length(object);
     if (meta->is_zero_terminated) {
-        arg->v_pointer = malloc(sizeof(gunichar) * (*size + 1));
+        arg->v_pointer = SCRATCH_ALLOC(sizeof(gunichar) * (*size + 1));
         ((gunichar *)arg->v_pointer)[*size] = 0;
-        LATER_FREE(arg->v_pointer);
-    }
-    else {
-        arg->v_pointer = malloc(sizeof(gunichar) * *size);
-        LATER_FREE(arg->v_pointer);
     }
+    else
+        arg->v_pointer = SCRATCH_ALLOC(sizeof(gunichar) * *size);
     for (gsize i = 0; i < *size; i++)
         ((gunichar *)(arg->v_pointer))[i] = (gunichar)SCM_CHAR(scm_c_string_ref(object, i));
 }
@@ -644,8 +757,7 @@ scm_to_c_native_immediate_array(S2C_ARG_DECL)
             if (meta->is_zero_terminated) {
                 gsize len = SCM_BYTEVECTOR_LENGTH(object);
                 // Adding null terminator element.
-                arg->v_pointer = g_malloc0(len + item_size);
-                LATER_FREE(arg->v_pointer);
+                arg->v_pointer = SCRATCH_ALLOC(len + item_size);
                 memcpy(arg->v_pointer, SCM_BYTEVECTOR_CONTENTS(object), len);
             }
             else
@@ -938,14 +1050,11 @@ scm_to_c_native_gtype_array(S2C_ARG_DECL)
         scm_wrong_type_arg_msg(subr, argpos, object, "vector of gtype-ables");
     *size = scm_c_vector_length(object);
     if (meta->is_zero_terminated) {
-        arg->v_pointer = malloc(sizeof(GType) * (*size + 1));
+        arg->v_pointer = SCRATCH_ALLOC(sizeof(GType) * (*size + 1));
         ((GType *) arg->v_pointer)[*size] = 0;
-        LATER_FREE(arg->v_pointer);
-    }
-    else {
-        arg->v_pointer = malloc(sizeof(GType) * *size);
-        LATER_FREE(arg->v_pointer);
     }
+    else
+        arg->v_pointer = SCRATCH_ALLOC(sizeof(GType) * *size);
     for (gsize i = 0; i < *size; i++)
         ((GType *) (arg->v_pointer))[i] = scm_to_gtype(scm_c_vector_ref(object, i));
 }
@@ -983,13 +1092,10 @@ scm_to_c_native_interface_array(S2C_ARG_DECL)
             scm_wrong_type_arg_msg(subr, argpos, object, "vector of objects");
         *size = scm_c_vector_length(object);
         if (meta->params[0].is_ptr) {
-            if (meta->is_zero_terminated) {
-                arg->v_pointer = malloc(sizeof(gpointer) * (*size + 1));
-                ((gpointer *)arg->v_pointer)[*size] = 0;
-            }
-            else {
-                arg->v_pointer = malloc(sizeof(gpointer) * *size);
-            }
+            if (meta->is_zero_terminated)
+                arg->v_pointer = SCRATCH_ALLOC(sizeof(gpointer) * (*size + 1));
+            else
+                arg->v_pointer = SCRATCH_ALLOC(sizeof(gpointer) * *size);
             for (gsize i = 0; i < *size; i++) {
                 gpointer p = gig_type_peek_object(scm_c_vector_ref(object, i));
                 if (meta->transfer == GI_TRANSFER_EVERYTHING) {
@@ -1014,9 +1120,9 @@ scm_to_c_native_interface_array(S2C_ARG_DECL)
             GigTypeMeta *item_meta = &meta->params[0];
             gsize real_item_size = gig_meta_real_item_size(item_meta);
             if (meta->is_zero_terminated)
-                arg->v_pointer = g_malloc0(real_item_size * (*size + 1));
+                arg->v_pointer = SCRATCH_ALLOC(real_item_size * (*size + 1));
             else
-                arg->v_pointer = malloc(real_item_size * *size);
+                arg->v_pointer = SCRATCH_ALLOC(real_item_size * *size);
             for (gsize i = 0; i < *size; i++) {
                 gpointer p = gig_type_peek_object(scm_c_vector_ref(object, i));
                 if (meta->transfer == GI_TRANSFER_EVERYTHING)
@@ -1034,11 +1140,10 @@ scm_to_c_native_interface_array(S2C_ARG_DECL)
             *size = length;
             gint *ptr;
             if (meta->is_zero_terminated)
-                ptr = g_new0(gint, length + 1);
+                ptr = SCRATCH_ALLOC(sizeof(gint) * (length + 1));
             else
-                ptr = g_new0(gint, length);
+                ptr = SCRATCH_ALLOC(sizeof(gint) * length);
             arg->v_pointer = ptr;
-            LATER_FREE(ptr);
             SCM iter = object;
 
             for (gsize i = 0; i < length; i++, iter = scm_cdr(iter))
@@ -1078,15 +1183,14 @@ scm_to_c_native_string_array(S2C_ARG_DECL)
 
         elt = scm_vector_elements(object, &handle, &len, &inc);
         *size = len;
-        gchar **strv = g_new0(gchar *, len + 1);
-        LATER_FREE(strv);
+        gchar **strv = SCRATCH_ALLOC(sizeof(gchar *) * (len + 1));
 
         for (gsize i = 0; i < len; i++, elt += inc) {
             if (meta->params[0].pointer_type == GIG_DATA_LOCALE_STRING)
                 strv[i] = scm_to_locale_string(*elt);
             else
                 strv[i] = scm_to_utf8_string(*elt);
-            LATER_FREE(strv[i]);
+            LATER_FREE_STRING(strv[i]);
         }
         strv[len] = NULL;
         arg->v_pointer = strv;
@@ -1096,8 +1200,7 @@ scm_to_c_native_string_array(S2C_ARG_DECL)
     else if (scm_is_list(object)) {
         gsize len = scm_c_length(object);
         *size = len;
-        gchar **strv = g_new0(gchar *, len + 1);
-        LATER_FREE(strv);
+        gchar **strv = SCRATCH_ALLOC(sizeof(gchar *) * (len + 1));
         SCM iter = object;
         for (gsize i = 0; i < len; i++) {
             SCM elt = scm_car(iter);
@@ -1106,7 +1209,7 @@ scm_to_c_native_string_array(S2C_ARG_DECL)
             else
                 strv[i] = scm_to_utf8_string(elt);
             iter = scm_cdr(iter);
-            LATER_FREE(strv[i]);
+            LATER_FREE_STRING(strv[i]);
         }
         strv[len] = NULL;
         arg->v_pointer = strv;
@@ -1192,6 +1295,43 @@ gig_argument_c_to_scm(C2S_ARG_DECL)
     }
 }
 
+// Returns the converter to use for values of type META.  Only scalar
+// types get a converter of their own; everything else goes through
+// gig_argument_c_to_scm, which knows about void and NULL pointers.
+GigArgumentC2S
+gig_argument_resolve_c_to_scm(GigTypeMeta *meta)
+{
+    if (meta->is_nullable || meta->is_ptr)
+        return gig_argument_c_to_scm;
+
+    switch (G_TYPE_FUNDAMENTAL(meta->gtype)) {
+    case G_TYPE_CHAR:
+    case G_TYPE_UCHAR:
+        return c_char_to_scm;
+    case G_TYPE_BOOLEAN:
+        return c_boolean_to_scm;
+    case G_TYPE_INT:
+    case G_TYPE_UINT:
+    case G_TYPE_INT64:
+    case G_TYPE_UINT64:
+        return c_integer_to_scm;
+    case G_TYPE_FLOAT:
+    case G_TYPE_DOUBLE:
+        return c_real_to_scm;
+    default:
+        return gig_argument_c_to_scm;
+    }
+}
+
+// Converts ARG to an SCM object, using the converter resolved for
+// ENTRY.
+void
+gig_argument_entry_c_to_scm(GigArgMapEntry *entry, const gchar *subr, gint argpos,
+                            GIArgument *arg, SCM *object, gsize size)
+{
+    entry->c2s(subr, argpos, &entry->meta, arg, object, size);
+}
+
 static void
 c_char_to_scm(C2S_ARG_DECL)
 {
@@ -4,6 +4,7 @@
 #include <girepository.h>
 #include <libguile.h>
 #include "gig_arg_map.h"
+#include "gig_arena.h"
 
 // *INDENT-OFF*
 G_BEGIN_DECLS
@@ -11,7 +12,7 @@ G_BEGIN_DECLS
 
 #define S2C_ARG_DECL const gchar *subr, gint argpos,    \
         GigTypeMeta *meta, SCM object,               \
-        GPtrArray *must_free, GIArgument *arg, gsize *size
+        GigArena *must_free, GIArgument *arg, gsize *size
 #define S2C_ARGS subr, argpos, meta, object, must_free, arg, size
 
 #define C2S_ARG_DECL const gchar *subr, gint argpos,    \
@@ -21,6 +22,12 @@ G_BEGIN_DECLS
 
 void gig_argument_scm_to_c(S2C_ARG_DECL);
 void gig_argument_c_to_scm(C2S_ARG_DECL);
+GigArgumentS2C gig_argument_resolve_scm_to_c(GigTypeMeta *meta);
+GigArgumentC2S gig_argument_resolve_c_to_scm(GigTypeMeta *meta);
+void gig_argument_entry_scm_to_c(GigArgMapEntry *entry, const gchar *subr, gint argpos, SCM object,
+                                 GigArena *must_free, GIArgument *arg, gsize *size);
+void gig_argument_entry_c_to_scm(GigArgMapEntry *entry, const gchar *subr, gint argpos,
+                                 GIArgument *arg, SCM *object, gsize size);
 char *gig_argument_describe_arg(GIArgInfo *arg_info);
 char *gig_argument_describe_return(GITypeInfo *type_info, GITransfer transfer, gboolean null_ok,
                                    gboolean skip);
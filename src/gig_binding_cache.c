@@ -0,0 +1,485 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libguile.h>
+#include "gig_binding_cache.h"
+#include "gig_util.h"
+
+// Files of other versions are ignored, and replaced when written.
+// Bump this whenever GIG_BINDING_CACHE_TYPE, the keys made by
+// binding_cache_key or what gig_arg_map.c puts in a record changes,
+// since the typelib being the same does not catch those.
+#define GIG_BINDING_CACHE_VERSION 4
+
+// The version, the typelib path, the SHA-256 of the typelib's contents,
+// and the records sorted by key.
+#define GIG_BINDING_CACHE_TYPE "(ussa(sv))"
+
+typedef struct _GigBindingCache
+{
+    // The cache file, or NULL if the namespace has no typelib file.
+    gchar *path;
+    gchar *typelib_path;
+    // The checksum of the typelib, or NULL until a cache file or
+    // preloaded records are compared with it.
+    gchar *checksum;
+    // The records of a valid cache file, which stay mapped, or the
+    // preloaded records.
+    GMappedFile *file;
+    GVariant *records;
+    // The position of each record plus one, by key, made when the
+    // records are first searched.
+    GHashTable *index;
+    // The records made by this process, by key.
+    GHashTable *pending;
+    gboolean dirty;
+    // What became of the cache file, how many lookups found a record
+    // and how many records found did not fit their function.
+    const gchar *state;
+    guint hits;
+    guint rejected;
+} GigBindingCache;
+
+static gchar *cache_dir = NULL;
+static GHashTable *caches = NULL;
+static gboolean preloaded = FALSE;
+G_LOCK_DEFINE_STATIC(binding_cache);
+
+static void
+binding_cache_free(GigBindingCache *cache)
+{
+    g_free(cache->path);
+    g_free(cache->typelib_path);
+    g_free(cache->checksum);
+    if (cache->index != NULL)
+        g_hash_table_unref(cache->index);
+    if (cache->records != NULL)
+        g_variant_unref(cache->records);
+    if (cache->file != NULL)
+        g_mapped_file_unref(cache->file);
+    g_hash_table_unref(cache->pending);
+    g_free(cache);
+}
+
+gboolean
+gig_binding_cache_enabled(void)
+{
+    static gsize init = 0;
+
+    if (g_once_init_enter(&init)) {
+        const gchar *dir = g_getenv("GIG_BINDING_CACHE");
+        if (dir != NULL && dir[0] != '\0')
+            cache_dir = g_strdup(dir);
+        caches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify)binding_cache_free);
+        g_once_init_leave(&init, 1);
+    }
+    return cache_dir != NULL;
+}
+
+// Uses DIR instead of the directory named by GIG_BINDING_CACHE, or no
+// directory if DIR is NULL.  The caches that are open are closed
+// without being written.
+void
+gig_binding_cache_set_directory(const gchar *dir)
+{
+    gig_binding_cache_enabled();
+    G_LOCK(binding_cache);
+    g_free(cache_dir);
+    cache_dir = (dir != NULL && dir[0] != '\0') ? g_strdup(dir) : NULL;
+    g_hash_table_remove_all(caches);
+    G_UNLOCK(binding_cache);
+}
+
+// The key of INFO tells its type apart with a letter, since a method
+// and a signal may share a name.
+static gchar *
+binding_cache_key(GIBaseInfo *info)
+{
+    GIBaseInfo *container = g_base_info_get_container(info);
+    gchar type[3] = { 'a' + g_base_info_get_type(info), ':', '\0' };
+
+    return g_strconcat(type, container ? g_base_info_get_name(container) : "", ".",
+                       g_base_info_get_name(info), NULL);
+}
+
+// Returns the checksum of the typelib of CACHE, or NULL if it cannot
+// be read.  The typelib is hashed at most once per process, and only
+// when there are records to compare it with; modification times and
+// sizes would not tell a rebuilt typelib from the one the records
+// were made for.
+static const gchar *
+binding_cache_checksum(GigBindingCache *cache)
+{
+    if (cache->checksum == NULL && cache->typelib_path != NULL) {
+        GMappedFile *typelib = g_mapped_file_new(cache->typelib_path, FALSE, NULL);
+        if (typelib == NULL)
+            return NULL;
+        cache->checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                                                      (const guchar *)
+                                                      g_mapped_file_get_contents(typelib),
+                                                      g_mapped_file_get_length(typelib));
+        g_mapped_file_unref(typelib);
+    }
+    return cache->checksum;
+}
+
+// Maps the cache file of CACHE, if it belongs to the typelib as it is
+// now.  The file is not trusted to be well formed; one that is not
+// reads as version 0 and is ignored.
+static void
+binding_cache_map(GigBindingCache *cache)
+{
+    GMappedFile *file = g_mapped_file_new(cache->path, FALSE, NULL);
+    GVariant *root, *records;
+    guint32 version;
+    const gchar *typelib_path, *checksum;
+
+    if (file == NULL) {
+        cache->state = "missing";
+        return;
+    }
+
+    GBytes *bytes = g_mapped_file_get_bytes(file);
+    root = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(GIG_BINDING_CACHE_TYPE),
+                                                       bytes, FALSE));
+    g_bytes_unref(bytes);
+
+    g_variant_get(root, "(u&s&s@a(sv))", &version, &typelib_path, &checksum, &records);
+    if (version == GIG_BINDING_CACHE_VERSION && g_str_equal(typelib_path, cache->typelib_path)
+        && g_strcmp0(checksum, binding_cache_checksum(cache)) == 0) {
+        cache->file = file;
+        cache->records = records;
+        cache->state = "valid";
+    }
+    else {
+        g_variant_unref(records);
+        g_mapped_file_unref(file);
+        cache->state = "stale";
+    }
+    g_variant_unref(root);
+}
+
+static GigBindingCache *
+binding_cache_open(const gchar *_namespace)
+{
+    GigBindingCache *cache = g_new0(GigBindingCache, 1);
+    const gchar *typelib_path = g_irepository_get_typelib_path(NULL, _namespace);
+
+    cache->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify)g_variant_unref);
+    cache->state = "none";
+    if (typelib_path == NULL || !g_file_test(typelib_path, G_FILE_TEST_IS_REGULAR))
+        return cache;
+
+    cache->typelib_path = g_strdup(typelib_path);
+    // Without a cache directory, only preloaded records are used.  A
+    // cache file cannot be written without the checksum.
+    if (cache_dir == NULL || binding_cache_checksum(cache) == NULL)
+        return cache;
+    cache->path = g_strdup_printf("%s/%s-%s.cache", cache_dir, _namespace,
+                                  g_irepository_get_version(NULL, _namespace));
+    binding_cache_map(cache);
+    gig_debug_load("%s - binding cache %s is %s", _namespace, cache->path,
+                   cache->records ? "valid" : "missing or stale");
+    return cache;
+}
+
+static GigBindingCache *
+binding_cache_get(const gchar *_namespace)
+{
+    GigBindingCache *cache = g_hash_table_lookup(caches, _namespace);
+    if (cache == NULL) {
+        cache = binding_cache_open(_namespace);
+        g_hash_table_insert(caches, g_strdup(_namespace), cache);
+    }
+    return cache;
+}
+
+// Returns the record of KEY in the records of CACHE, or NULL.  The
+// keys point into the records, which stay alive as long as CACHE.
+static GVariant *
+records_find(GigBindingCache *cache, const gchar *key)
+{
+    GVariant *record = NULL;
+
+    if (cache->index == NULL) {
+        gsize n = g_variant_n_children(cache->records);
+        cache->index = g_hash_table_new(g_str_hash, g_str_equal);
+        for (gsize i = 0; i < n; i++) {
+            const gchar *entry_key;
+            g_variant_get_child(cache->records, i, "(&sv)", &entry_key, NULL);
+            g_hash_table_insert(cache->index, (gpointer)entry_key, GSIZE_TO_POINTER(i + 1));
+        }
+    }
+
+    gsize i = GPOINTER_TO_SIZE(g_hash_table_lookup(cache->index, key));
+    if (i > 0)
+        g_variant_get_child(cache->records, i - 1, "(&sv)", NULL, &record);
+    return record;
+}
+
+// Returns a new reference to the record of INFO, or NULL.
+GVariant *
+gig_binding_cache_lookup(GIBaseInfo *info)
+{
+    GVariant *record = NULL;
+
+    if (!gig_binding_cache_enabled() && !preloaded)
+        return NULL;
+
+    gchar *key = binding_cache_key(info);
+    G_LOCK(binding_cache);
+    GigBindingCache *cache = binding_cache_get(g_base_info_get_namespace(info));
+    record = g_hash_table_lookup(cache->pending, key);
+    if (record != NULL)
+        g_variant_ref(record);
+    else if (cache->records != NULL && (record = records_find(cache, key)) != NULL)
+        cache->hits++;
+    G_UNLOCK(binding_cache);
+    g_free(key);
+    return record;
+}
+
+// Counts a record of INFO that did not fit it.  The record made
+// instead replaces it.
+void
+gig_binding_cache_reject(GIBaseInfo *info)
+{
+    G_LOCK(binding_cache);
+    binding_cache_get(g_base_info_get_namespace(info))->rejected++;
+    G_UNLOCK(binding_cache);
+}
+
+// Keeps RECORD for INFO, to be written by the next flush.
+void
+gig_binding_cache_store(GIBaseInfo *info, GVariant *record)
+{
+    g_variant_ref_sink(record);
+    if (!gig_binding_cache_enabled()) {
+        g_variant_unref(record);
+        return;
+    }
+
+    G_LOCK(binding_cache);
+    GigBindingCache *cache = binding_cache_get(g_base_info_get_namespace(info));
+    if (cache->path != NULL) {
+        g_hash_table_replace(cache->pending, binding_cache_key(info), record);
+        cache->dirty = TRUE;
+    }
+    else
+        g_variant_unref(record);
+    G_UNLOCK(binding_cache);
+}
+
+// Uses the records of BYTES, which hold a cache file made for the
+// typelib of NAMESPACE, unless its cache file is valid.  Since the
+// file may have been made where the typelib had another path, only
+// the checksums of the typelibs are compared.  Returns whether the
+// records are used.
+gboolean
+gig_binding_cache_preload(const gchar *_namespace, GBytes *bytes)
+{
+    GVariant *root, *records;
+    guint32 version;
+    const gchar *checksum;
+    gboolean ok = FALSE;
+
+    gig_binding_cache_enabled();
+    root = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(GIG_BINDING_CACHE_TYPE),
+                                                       bytes, FALSE));
+    g_variant_get(root, "(u&s&s@a(sv))", &version, NULL, &checksum, &records);
+
+    G_LOCK(binding_cache);
+    GigBindingCache *cache = binding_cache_get(_namespace);
+    if (version == GIG_BINDING_CACHE_VERSION
+        && g_strcmp0(checksum, binding_cache_checksum(cache)) == 0) {
+        if (cache->records == NULL) {
+            cache->records = g_variant_ref(records);
+            cache->state = "preloaded";
+        }
+        preloaded = ok = TRUE;
+    }
+    G_UNLOCK(binding_cache);
+
+    gig_debug_load("%s - preloaded binding records %s", _namespace,
+                   ok ? "are used" : "do not match the typelib");
+    g_variant_unref(records);
+    g_variant_unref(root);
+    return ok;
+}
+
+static gboolean
+add_record(gpointer key, gpointer record, gpointer builder)
+{
+    g_variant_builder_add(builder, "(sv)", key, record);
+    return FALSE;
+}
+
+static gboolean
+binding_cache_write(GigBindingCache *cache)
+{
+    GTree *sorted = g_tree_new_full((GCompareDataFunc)strcmp, NULL, NULL,
+                                    (GDestroyNotify)g_variant_unref);
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer key, value;
+    GError *error = NULL;
+
+    // The records read from the file come first, so that the records
+    // made by this process replace them.
+    if (cache->records != NULL) {
+        gsize n = g_variant_n_children(cache->records);
+        for (gsize i = 0; i < n; i++) {
+            const gchar *entry_key;
+            GVariant *record;
+            g_variant_get_child(cache->records, i, "(&sv)", &entry_key, &record);
+            g_tree_insert(sorted, (gpointer)entry_key, record);
+        }
+    }
+    g_hash_table_iter_init(&iter, cache->pending);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        g_tree_insert(sorted, key, g_variant_ref(value));
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(sv)"));
+    g_tree_foreach(sorted, add_record, &builder);
+    g_tree_unref(sorted);
+
+    GVariant *root = g_variant_ref_sink(g_variant_new("(uss@a(sv))", GIG_BINDING_CACHE_VERSION,
+                                                      cache->typelib_path, cache->checksum,
+                                                      g_variant_builder_end(&builder)));
+    gboolean ok = (g_mkdir_with_parents(cache_dir, 0755) == 0
+                   && g_file_set_contents(cache->path, g_variant_get_data(root),
+                                          g_variant_get_size(root), &error));
+    if (!ok) {
+        gig_warning_load("could not write binding cache %s: %s", cache->path,
+                         error ? error->message : g_strerror(errno));
+        g_clear_error(&error);
+    }
+    g_variant_unref(root);
+    return ok;
+}
+
+// Writes the caches that have new records, and returns how many were
+// written.
+guint
+gig_binding_cache_flush(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    guint count = 0;
+
+    if (!gig_binding_cache_enabled())
+        return 0;
+
+    G_LOCK(binding_cache);
+    g_hash_table_iter_init(&iter, caches);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        GigBindingCache *cache = value;
+        if (cache->dirty && binding_cache_write(cache)) {
+            cache->dirty = FALSE;
+            count++;
+        }
+    }
+    G_UNLOCK(binding_cache);
+    return count;
+}
+
+static SCM
+scm_binding_cache_set_directory_x(SCM dir)
+{
+    SCM_ASSERT_TYPE(scm_is_false(dir) || scm_is_string(dir), dir, SCM_ARG1,
+                    "binding-cache-set-directory!", "string or #f");
+
+    gchar *_dir = scm_is_false(dir) ? NULL : scm_to_utf8_string(dir);
+    gig_binding_cache_set_directory(_dir);
+    free(_dir);
+    return SCM_UNSPECIFIED;
+}
+
+// Closes the caches without writing them, so that the cache files are
+// read again when next used.
+static SCM
+scm_binding_cache_reset_x(void)
+{
+    gig_binding_cache_enabled();
+    G_LOCK(binding_cache);
+    g_hash_table_remove_all(caches);
+    G_UNLOCK(binding_cache);
+    return SCM_UNSPECIFIED;
+}
+
+// Returns an alist of what became of the cache file of LIB, how many
+// records were found in it and how many of those were rejected, or #f
+// if LIB's cache is not open.
+static SCM
+scm_binding_cache_info(SCM lib)
+{
+    GigBindingCache *cache = NULL;
+    const gchar *state = NULL;
+    guint hits = 0, rejected = 0;
+
+    gig_binding_cache_enabled();
+    gchar *_lib = scm_to_utf8_string(lib);
+    G_LOCK(binding_cache);
+    cache = g_hash_table_lookup(caches, _lib);
+    if (cache != NULL) {
+        state = cache->state;
+        hits = cache->hits;
+        rejected = cache->rejected;
+    }
+    G_UNLOCK(binding_cache);
+    free(_lib);
+
+    if (state == NULL)
+        return SCM_BOOL_F;
+    return scm_list_3(scm_cons(scm_from_utf8_symbol("state"), scm_from_utf8_symbol(state)),
+                      scm_cons(scm_from_utf8_symbol("hits"), scm_from_uint(hits)),
+                      scm_cons(scm_from_utf8_symbol("rejected"), scm_from_uint(rejected)));
+}
+
+static SCM
+scm_binding_cache_flush_x(void)
+{
+    return scm_from_uint(gig_binding_cache_flush());
+}
+
+static SCM
+scm_binding_cache_preload_x(SCM lib, SCM bv)
+{
+    SCM_ASSERT_TYPE(scm_is_bytevector(bv), bv, SCM_ARG2, "binding-cache-preload!",
+                    "bytevector");
+
+    gchar *_lib = scm_to_utf8_string(lib);
+    GBytes *bytes = g_bytes_new(SCM_BYTEVECTOR_CONTENTS(bv), SCM_BYTEVECTOR_LENGTH(bv));
+    gboolean ok = gig_binding_cache_preload(_lib, bytes);
+    g_bytes_unref(bytes);
+    free(_lib);
+    return scm_from_bool(ok);
+}
+
+void
+gig_init_binding_cache(void)
+{
+    scm_c_define_gsubr("binding-cache-flush!", 0, 0, 0, scm_binding_cache_flush_x);
+    scm_c_define_gsubr("binding-cache-preload!", 2, 0, 0, scm_binding_cache_preload_x);
+    scm_c_define_gsubr("binding-cache-set-directory!", 1, 0, 0,
+                       scm_binding_cache_set_directory_x);
+    scm_c_define_gsubr("%binding-cache-reset!", 0, 0, 0, scm_binding_cache_reset_x);
+    scm_c_define_gsubr("%binding-cache-info", 1, 0, 0, scm_binding_cache_info);
+}
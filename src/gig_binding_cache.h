@@ -0,0 +1,42 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GIG_BINDING_CACHE_H
+#define GIG_BINDING_CACHE_H
+
+#include <glib.h>
+#include <girepository.h>
+
+// *INDENT-OFF*
+G_BEGIN_DECLS
+// *INDENT-ON*
+
+// The binding cache keeps what is derived from the callables of a
+// typelib in a file per typelib, in the directory named by the
+// GIG_BINDING_CACHE environment variable.  A cache file is only used
+// while its typelib has the same path, modification time and size.
+// The directory may also be set explicitly.  The records of a cache
+// file may also be preloaded, as modules made by gi-compile do.
+gboolean gig_binding_cache_enabled(void);
+void gig_binding_cache_set_directory(const gchar *dir);
+GVariant *gig_binding_cache_lookup(GIBaseInfo *info);
+void gig_binding_cache_reject(GIBaseInfo *info);
+void gig_binding_cache_store(GIBaseInfo *info, GVariant *record);
+gboolean gig_binding_cache_preload(const gchar *_namespace, GBytes *bytes);
+guint gig_binding_cache_flush(void);
+void gig_init_binding_cache(void);
+
+G_END_DECLS
+#endif
@@ -13,12 +13,18 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <string.h>
 #include <libguile.h>
 #include <libguile/hooks.h>
 #include <ffi.h>
 #include "gig_argument.h"
 #include "gig_callback.h"
 #include "gig_function.h"
+#include "gig_load_stats.h"
+#include "gig_stats.h"
+#include "gig_trace.h"
+#include "gig_type.h"
+#include "gig_watchdog.h"
 #include "gig_util.h"
 
 typedef struct _GigCallback GigCallback;
@@ -36,9 +42,19 @@ struct _GigCallback
     gchar *name;
     gpointer callback_ptr;
     ffi_type **atypes;
+    GigStats *stats;
+    guint32 trace_id;
+    // A virtual function takes the instance as its first argument, in
+    // addition to the arguments of its callable info, and a GError if
+    // it can throw.
+    guint8 is_vfunc:1;
+    guint8 can_throw:1;
 };
 
 GSList *callback_list = NULL;
+// Virtual function closures are kept apart from callbacks, since they
+// cannot be reused for a procedure passed as a callback.
+GSList *vfunc_list = NULL;
 
 SCM gig_before_c_callback_hook;
 SCM gig_before_callback_hook;
@@ -191,16 +207,31 @@ callback_binding_inner(struct callback_binding_args *args)
     GigCallback *gcb = args->gcb;
     SCM s_args = SCM_EOL;
     SCM s_ret;
+    gint64 stats_start = gig_stats_start();
+    guint32 trace = gig_trace_begin(&gcb->trace_id, GIG_STATS_CALLBACK, gcb->name);
+    GigWatchdogCall watchdog;
+    gig_watchdog_start(&watchdog);
+    gboolean borrow = gig_type_borrow_boxed;
 
     g_assert(cif != NULL);
     g_assert(ret != NULL);
     g_assert(ffi_args != NULL);
     g_assert(gcb != NULL);
 
-    guint n_args = cif->nargs;
+    guint n_args = cif->nargs - gcb->is_vfunc - gcb->can_throw;
+    guint offset = gcb->is_vfunc;
 
     scm_load_goops();
 
+    // Boxed arguments may be borrowed until the callback returns.
+    if (borrow || trace || watchdog.start) {
+        scm_dynwind_begin(0);
+        gig_trace_dynwind_exit(trace);
+        gig_watchdog_dynwind_watch(&watchdog, GIG_STATS_CALLBACK, gcb->name);
+        if (borrow)
+            gig_type_dynwind_borrow(SCM_BOOL_F);
+    }
+
     g_assert(scm_is_true(scm_procedure_p(gcb->s_func)));
     g_assert_cmpint(n_args, ==, g_callable_info_get_n_args(gcb->callback_info));
     g_assert(gcb->amap != NULL);
@@ -220,14 +251,20 @@ callback_binding_inner(struct callback_binding_args *args)
         if (!amap->pdata[i].is_s_input)
             continue;
 
-        convert_ffi_arg_to_giargument(ffi_args[i], cif->arg_types[i], amap->pdata[i].meta.is_ptr,
-                                      &giarg);
-        gig_argument_c_to_scm(callback_name, i, &amap->pdata[i].meta, &giarg, &s_entry, -1);
+        convert_ffi_arg_to_giargument(ffi_args[offset + i], cif->arg_types[offset + i],
+                                      amap->pdata[i].meta.is_ptr, &giarg);
+        gig_argument_entry_c_to_scm(&amap->pdata[i], callback_name, i, &giarg, &s_entry, -1);
         s_args = scm_cons(s_entry, s_args);
     }
     s_args = scm_reverse_x(s_args, SCM_EOL);
     gsize length = scm_c_length(s_args);
 
+    if (gcb->is_vfunc) {
+        gpointer self = *(gpointer *)ffi_args[0];
+        s_args = scm_cons(gig_type_transfer_object(G_TYPE_FROM_INSTANCE(self), self,
+                                                   GI_TRANSFER_NOTHING), s_args);
+    }
+
     if (scm_is_false(scm_hook_empty_p(gig_before_callback_hook)))
         scm_c_run_hook(gig_before_callback_hook,
                        scm_list_3(scm_from_utf8_string(g_base_info_get_name(gcb->callback_info)),
@@ -260,15 +297,15 @@ callback_binding_inner(struct callback_binding_args *args)
         if (amap->return_val.meta.gtype != G_TYPE_NONE) {
             start = 1;
             SCM real_ret = scm_c_value_ref(s_ret, 0);
-            gig_argument_scm_to_c(callback_name, 0, &amap->return_val.meta, real_ret, NULL, &giarg,
-                                  &size);
+            gig_argument_entry_scm_to_c(&amap->return_val, callback_name, 0, real_ret, NULL,
+                                        &giarg, &size);
             store_output(&(amap->return_val), (gpointer **)&ret, &giarg);
 
             if (amap->return_val.meta.has_size) {
                 gsize c_output_pos = amap->return_val.child->c_output_pos;
                 GIArgument tmp;
                 tmp.v_int64 = size;
-                store_output(amap->return_val.child, ffi_args[c_output_pos], &tmp);
+                store_output(amap->return_val.child, ffi_args[offset + c_output_pos], &tmp);
             }
         }
 
@@ -280,19 +317,69 @@ callback_binding_inner(struct callback_binding_args *args)
             if (entry->s_output_pos >= n_values)
                 scm_misc_error(callback_name, "too few return values", SCM_EOL);
             SCM real_value = scm_c_value_ref(s_ret, entry->s_output_pos + start);
-            gig_argument_scm_to_c(callback_name, real_cpos, &entry->meta, real_value, NULL, &giarg,
-                                  &size);
-            store_output(entry, ffi_args[c_output_pos], &giarg);
+            gig_argument_entry_scm_to_c(entry, callback_name, real_cpos, real_value, NULL, &giarg,
+                                        &size);
+            store_output(entry, ffi_args[offset + c_output_pos], &giarg);
 
             if (amap->return_val.meta.has_size) {
                 gsize size_pos = entry->child->c_output_pos;
                 GIArgument tmp;
                 tmp.v_int64 = size;
-                store_output(entry->child, ffi_args[size_pos], &tmp);
+                store_output(entry->child, ffi_args[offset + size_pos], &tmp);
             }
         }
     }
     g_free(callback_name);
+    if (borrow || trace || watchdog.start)
+        scm_dynwind_end();
+
+    gig_trace_end(trace);
+    if (stats_start)
+        gig_stats_record(&gcb->stats, GIG_STATS_CALLBACK, gcb->name, stats_start, FALSE, 0);
+    if (gig_watchdog_stalled(watchdog.start))
+        gig_watchdog_report(GIG_STATS_CALLBACK, gcb->name, watchdog.start, s_args);
+    return (void *)1;
+}
+
+static GQuark
+gig_scheme_error_quark(void)
+{
+    return g_quark_from_static_string("gig-scheme-error-quark");
+}
+
+static SCM
+callback_binding_body(void *data)
+{
+    callback_binding_inner(data);
+    return SCM_UNSPECIFIED;
+}
+
+// Stores the Scheme error of KEY and ARGS in the GError argument of a
+// virtual function, which then returns zero, FALSE or NULL.
+static SCM
+callback_binding_error(void *data, SCM key, SCM args)
+{
+    struct callback_binding_args *cb_args = data;
+    ffi_cif *cif = cb_args->cif;
+    GError **error = *(GError ***)cb_args->ffi_args[cif->nargs - 1];
+
+    SCM port = scm_open_output_string();
+    scm_print_exception(port, SCM_BOOL_F, key, args);
+    gchar *message = scm_to_utf8_string(scm_get_output_string(port));
+    g_strchomp(message);
+    g_set_error_literal(error, gig_scheme_error_quark(), 0, message);
+    free(message);
+
+    if (cif->rtype->type != FFI_TYPE_VOID)
+        memset(cb_args->ret, 0, MAX(cif->rtype->size, sizeof(ffi_arg)));
+    return SCM_UNSPECIFIED;
+}
+
+static void *
+callback_binding_catch(struct callback_binding_args *args)
+{
+    scm_c_catch(SCM_BOOL_T, callback_binding_body, args, callback_binding_error, args, NULL,
+                NULL);
     return (void *)1;
 }
 
@@ -307,14 +394,20 @@ callback_binding(ffi_cif *cif, gpointer ret, gpointer *ffi_args, gpointer user_d
 
     scm_init_guile();
 
+    // A virtual function that can throw reports Scheme errors to its
+    // caller as a GError.
+    void *(*inner)(struct callback_binding_args *) = callback_binding_inner;
+    if (args.gcb->can_throw)
+        inner = callback_binding_catch;
+
     // If we're not in the main thread, we catch and error at this
     // level.  But in the main thread, there is assuredly some higher
     // level catch.
 
     if (scm_is_true(scm_fluid_ref(gig_callback_thread_fluid)))
-        callback_binding_inner(&args);
+        inner(&args);
     else {
-        if (NULL == scm_with_guile(callback_binding_inner, &args))
+        if (NULL == scm_with_guile(inner, &args))
             scm_c_eval_string("(quit EXIT_FAILURE)");
     }
 }
@@ -329,6 +422,11 @@ c_callback_binding_inner(struct callback_binding_args *args)
     const gchar *name = "c callback";
     GigCallback *gcb = args->gcb;
     SCM s_args = SCM_UNDEFINED;
+    gint64 stats_start = gig_stats_start();
+    guint32 trace = gig_trace_begin(&gcb->trace_id, GIG_STATS_CALLBACK,
+                                    g_base_info_get_name(gcb->callback_info));
+    GigWatchdogCall watchdog;
+    gig_watchdog_start(&watchdog);
 
     g_assert(cif != NULL);
     g_assert(ret != NULL);
@@ -352,8 +450,21 @@ c_callback_binding_inner(struct callback_binding_args *args)
 
     // Use 'name' instead of gcb->name, which is NULL for C callbacks.
     GError *error = NULL;
+    scm_dynwind_begin(0);
+    gig_trace_dynwind_exit(trace);
+    gig_watchdog_dynwind_watch(&watchdog, GIG_STATS_CALLBACK,
+                               g_base_info_get_name(gcb->callback_info));
     SCM output = gig_callable_invoke(gcb->callback_info, gcb->c_func, gcb->amap, name, NULL,
                                      s_args, &error);
+    scm_dynwind_end();
+
+    gig_trace_end(trace);
+    if (stats_start)
+        gig_stats_record(&gcb->stats, GIG_STATS_CALLBACK, g_base_info_get_name(gcb->callback_info),
+                         stats_start, error != NULL, 0);
+    if (gig_watchdog_stalled(watchdog.start))
+        gig_watchdog_report(GIG_STATS_CALLBACK, g_base_info_get_name(gcb->callback_info),
+                            watchdog.start, s_args);
 
     if (error != NULL) {
         SCM err = scm_from_utf8_string(error->message);
@@ -389,9 +500,10 @@ c_callback_binding(ffi_cif *cif, gpointer ret, gpointer *ffi_args, gpointer user
 }
 
 // This procedure uses CALLBACK_INFO to create a dynamic FFI C closure
-// to use as an entry point to the scheme procedure S_FUNC.
+// to use as an entry point to the scheme procedure S_FUNC.  If
+// IS_VFUNC, CALLBACK_INFO is a GIVFuncInfo.
 GigCallback *
-gig_callback_new(const char *name, GICallbackInfo *callback_info, SCM s_func)
+gig_callback_new(const char *name, GICallbackInfo *callback_info, SCM s_func, gboolean is_vfunc)
 {
     g_assert(scm_is_true(scm_procedure_p(s_func)));
 
@@ -399,6 +511,11 @@ gig_callback_new(const char *name, GICallbackInfo *callback_info, SCM s_func)
     ffi_type **ffi_args = NULL;
     ffi_type *ffi_ret_type;
     gint n_args = g_callable_info_get_n_args(callback_info);
+    gint n_ffi_args;
+
+    gcb->is_vfunc = is_vfunc;
+    gcb->can_throw = is_vfunc && g_callable_info_can_throw_gerror(callback_info);
+    n_ffi_args = gcb->is_vfunc + n_args + gcb->can_throw;
 
     SCM s_name = scm_procedure_name(s_func);
     if (scm_is_symbol(s_name)) {
@@ -418,6 +535,8 @@ gig_callback_new(const char *name, GICallbackInfo *callback_info, SCM s_func)
     // Allocate the block of memory that FFI uses to hold a closure object,
     // and set a pointer to the corresponding executable address.
     gcb->closure = ffi_closure_alloc(sizeof(ffi_closure), &(gcb->callback_ptr));
+    gig_load_stats_count(GIG_LOAD_CLOSURES, 1);
+    gig_load_stats_count(GIG_LOAD_BYTES, sizeof(GigCallback) + sizeof(ffi_closure));
 
     g_return_val_if_fail(gcb->closure != NULL, NULL);
     g_return_val_if_fail(gcb->callback_ptr != NULL, NULL);
@@ -426,13 +545,18 @@ gig_callback_new(const char *name, GICallbackInfo *callback_info, SCM s_func)
     // Next, we begin to construct an FFI_CIF to describe the function call.
 
     // Initialize the argument info vectors.
-    if (n_args > 0) {
-        ffi_args = g_new0(ffi_type *, n_args);
+    if (n_ffi_args > 0) {
+        ffi_args = g_new0(ffi_type *, n_ffi_args);
+        gig_load_stats_count(GIG_LOAD_BYTES, n_ffi_args * sizeof(ffi_type *));
         gcb->atypes = ffi_args;
     }
 
+    if (gcb->is_vfunc)
+        ffi_args[0] = &ffi_type_pointer;
     for (gint i = 0; i < n_args; i++)
-        ffi_args[i] = amap_entry_to_ffi_type(&gcb->amap->pdata[i]);
+        ffi_args[gcb->is_vfunc + i] = amap_entry_to_ffi_type(&gcb->amap->pdata[i]);
+    if (gcb->can_throw)
+        ffi_args[n_ffi_args - 1] = &ffi_type_pointer;
 
     GITypeInfo *ret_type_info = g_callable_info_get_return_type(callback_info);
     ffi_ret_type = amap_entry_to_ffi_type(&gcb->amap->return_val);
@@ -440,7 +564,7 @@ gig_callback_new(const char *name, GICallbackInfo *callback_info, SCM s_func)
 
     // Initialize the CIF Call Interface Struct.
     ffi_status prep_ok;
-    prep_ok = ffi_prep_cif(&(gcb->cif), FFI_DEFAULT_ABI, n_args, ffi_ret_type, ffi_args);
+    prep_ok = ffi_prep_cif(&(gcb->cif), FFI_DEFAULT_ABI, n_ffi_args, ffi_ret_type, ffi_args);
 
     if (prep_ok != FFI_OK)
         scm_misc_error("gig-callback-new",
@@ -487,6 +611,8 @@ gig_callback_new_for_callback(GICallbackInfo *info, gpointer c_func)
     g_return_val_if_fail(prep_ok == FFI_OK, NULL);
 
     gcb->closure = ffi_closure_alloc(sizeof(ffi_closure), &(gcb->callback_ptr));
+    gig_load_stats_count(GIG_LOAD_CLOSURES, 1);
+    gig_load_stats_count(GIG_LOAD_BYTES, sizeof(GigCallback) + sizeof(ffi_closure));
     closure_ok = ffi_prep_closure_loc(gcb->closure, &(gcb->cif), c_callback_binding, gcb,
                                       gcb->callback_ptr);
     g_return_val_if_fail(closure_ok == FFI_OK, NULL);
@@ -515,11 +641,40 @@ gig_callback_to_c(const char *name, GICallbackInfo *cb_info, SCM s_func)
 
     // Create a new entry if necessary.
     scm_gc_protect_object(s_func);
-    gcb = gig_callback_new(name, cb_info, s_func);
+    gcb = gig_callback_new(name, cb_info, s_func, FALSE);
     callback_list = g_slist_prepend(callback_list, gcb);
     return gcb->callback_ptr;
 }
 
+// Returns a new C entry point to S_FUNC with the signature of the
+// virtual function VFUNC_INFO.  It lives as long as the program.
+gpointer
+gig_callback_to_c_for_vfunc(const char *name, GIVFuncInfo *vfunc_info, SCM s_func)
+{
+    g_assert(vfunc_info != NULL);
+    g_assert(scm_is_true(scm_procedure_p(s_func)));
+
+    scm_gc_protect_object(s_func);
+    GigCallback *gcb = gig_callback_new(name, vfunc_info, s_func, TRUE);
+    vfunc_list = g_slist_prepend(vfunc_list, gcb);
+    return gcb->callback_ptr;
+}
+
+// Frees the virtual function CALLBACK made by
+// gig_callback_to_c_for_vfunc, which must no longer be installed.
+void
+gig_callback_free_for_vfunc(gpointer callback)
+{
+    for (GSList *x = vfunc_list; x != NULL; x = x->next) {
+        GigCallback *gcb = x->data;
+        if (gcb->callback_ptr == callback) {
+            vfunc_list = g_slist_delete_link(vfunc_list, x);
+            callback_free(gcb);
+            return;
+        }
+    }
+}
+
 SCM
 gig_callback_to_scm(const char *name, GICallbackInfo *info, gpointer callback)
 {
@@ -680,6 +835,7 @@ callback_free(GigCallback *gcb)
     g_base_info_unref(gcb->callback_info);
     g_free(gcb->atypes);
     gcb->atypes = NULL;
+    gig_stats_free(gcb->stats);
 
     if (gcb->name) {
         g_free(gcb->name);
@@ -698,4 +854,6 @@ gig_fini_callback(void)
     g_debug("Freeing callbacks");
     g_slist_free_full(callback_list, (GDestroyNotify)callback_free);
     callback_list = NULL;
+    g_slist_free_full(vfunc_list, (GDestroyNotify)callback_free);
+    vfunc_list = NULL;
 }
@@ -11,6 +11,8 @@ G_BEGIN_DECLS
 
 SCM gig_callback_to_scm(const char *name, GICallbackInfo *info, gpointer proc);
 gpointer gig_callback_to_c(const char *name, GICallbackInfo *callback_info, SCM s_func);
+gpointer gig_callback_to_c_for_vfunc(const char *name, GIVFuncInfo *vfunc_info, SCM s_func);
+void gig_callback_free_for_vfunc(gpointer callback);
 void gig_init_callback(void);
 
 G_END_DECLS
@@ -1,5 +1,10 @@
+#include <stdlib.h>
+#include <string.h>
 #include "gig_closure.h"
 #include "gig_value.h"
+#include "gig_stats.h"
+#include "gig_trace.h"
+#include "gig_watchdog.h"
 #include "gig_type.h"
 #include "gig_util.h"
 
@@ -10,6 +15,8 @@ struct _GigClosure
     GClosure closure;
     SCM callback;
     SCM inout_mask;
+    GigStats *stats;
+    guint32 trace_id;
     // potential flags if we want to use marshal_data for various purposes
     // (e.g. storing signal info)
     guint16 reserved;
@@ -29,13 +36,72 @@ _gig_closure_invalidate(gpointer data, GClosure *closure)
     }
 }
 
+static void
+_gig_closure_finalize(gpointer data, GClosure *closure)
+{
+    GigClosure *pc = (GigClosure *)closure;
+    gig_stats_free(pc->stats);
+    pc->stats = NULL;
+}
+
+// Returns a newly allocated name for the procedure of PC, for
+// statistics and traces, to be freed with g_free.
+static gchar *
+closure_name(GigClosure *pc)
+{
+    SCM s_name = scm_procedure_name(pc->callback);
+    if (scm_is_symbol(s_name)) {
+        gchar *_name = scm_to_utf8_string(scm_symbol_to_string(s_name));
+        gchar *name = g_strdup(_name);
+        free(_name);
+        return name;
+    }
+    return g_strdup("anonymous closure");
+}
+
+static void
+closure_stats_record(GigClosure *pc, gint64 start)
+{
+    // The name is only looked up when the counters are allocated.
+    gchar *name = pc->stats == NULL ? closure_name(pc) : NULL;
+    gig_stats_record(&pc->stats, GIG_STATS_CLOSURE, name, start, FALSE, 0);
+    g_free(name);
+}
+
+static guint32
+closure_trace_begin(GigClosure *pc)
+{
+    if (G_LIKELY(!gig_trace_enabled))
+        return 0;
+
+    gchar *name = pc->trace_id == 0 ? closure_name(pc) : NULL;
+    guint32 trace = gig_trace_enter(&pc->trace_id, GIG_STATS_CLOSURE, name);
+    g_free(name);
+    return trace;
+}
+
 static void
 _gig_closure_marshal(GClosure *closure, GValue *ret, guint n_params, const GValue *params,
                      gpointer hint, gpointer marshal_data)
 {
     GigClosure *pc = (GigClosure *)closure;
+    gint64 start = gig_stats_start();
+    guint32 trace = closure_trace_begin(pc);
+    GigWatchdogCall watchdog;
+    gig_watchdog_start(&watchdog);
+    gboolean borrow = gig_type_borrow_boxed;
     SCM args = scm_make_list(scm_from_uint(n_params), SCM_UNDEFINED);
 
+    // Boxed arguments may be borrowed for the extent of the handler.
+    // The monitor thread cannot look up the name of the closure.
+    if (borrow || trace || watchdog.start) {
+        scm_dynwind_begin(0);
+        gig_trace_dynwind_exit(trace);
+        gig_watchdog_dynwind_watch(&watchdog, GIG_STATS_CLOSURE, NULL);
+        if (borrow)
+            gig_type_dynwind_borrow(SCM_BOOL_F);
+    }
+
     SCM iter = args;
     for (guint i = 0; i < n_params; i++, iter = scm_cdr(iter))
         scm_set_car_x(iter, gig_value_as_scm(params + i, TRUE));
@@ -70,7 +136,7 @@ _gig_closure_marshal(GClosure *closure, GValue *ret, guint n_params, const GValu
         gsize bit_count = scm_c_bitvector_count(pc->inout_mask);
         if (bit_count == 0 && nvalues == 1)
             /* fast path */
-            return;
+            goto out;
         if (bit_count < nvalues - idx)
             scm_misc_error(NULL, "~S returned more values than we should unpack",
                            scm_list_1(pc->callback));
@@ -91,6 +157,18 @@ _gig_closure_marshal(GClosure *closure, GValue *ret, guint n_params, const GValu
         }
         scm_array_handle_release(&handle);
     }
+
+  out:
+    if (borrow || trace || watchdog.start)
+        scm_dynwind_end();
+    gig_trace_end(trace);
+    if (start)
+        closure_stats_record(pc, start);
+    if (gig_watchdog_stalled(watchdog.start)) {
+        gchar *name = closure_name(pc);
+        gig_watchdog_report(GIG_STATS_CLOSURE, name, watchdog.start, args);
+        g_free(name);
+    }
 }
 
 GClosure *
@@ -99,6 +177,7 @@ gig_closure_new(SCM callback, SCM inout_mask)
     GClosure *closure = g_closure_new_simple(sizeof(GigClosure), NULL);
     GigClosure *gig_closure = (GigClosure *)closure;
     g_closure_add_invalidate_notifier(closure, NULL, _gig_closure_invalidate);
+    g_closure_add_finalize_notifier(closure, NULL, _gig_closure_finalize);
     g_closure_set_marshal(closure, _gig_closure_marshal);
     // FIXME: what about garbage collection?
     gig_closure->callback = scm_gc_protect_object(callback);
@@ -18,6 +18,7 @@
 #include "gig_argument.h"
 #include "gig_data_type.h"
 #include "gig_arg_map.h"
+#include "gig_load_stats.h"
 #include "gig_util.h"
 
 static void gig_type_meta_init_from_type_info(GigTypeMeta *type, GITypeInfo *ti);
@@ -71,6 +72,7 @@ static void
 add_params(GigTypeMeta *meta, gint n)
 {
     meta->params = g_new0(GigTypeMeta, n);
+    gig_load_stats_count(GIG_LOAD_BYTES, n * sizeof(GigTypeMeta));
     meta->n_params = n;
 }
 
@@ -21,8 +21,12 @@
 #include "gig_arg_map.h"
 #include "gig_function.h"
 #include "gig_function_private.h"
+#include "gig_load_stats.h"
 #include "gig_type.h"
 #include "gig_signal.h"
+#include "gig_stats.h"
+#include "gig_trace.h"
+#include "gig_watchdog.h"
 
 typedef struct _GigFunction
 {
@@ -33,8 +37,66 @@ typedef struct _GigFunction
     gchar *name;
     ffi_type **atypes;
     GigArgMap *amap;
+
+    // The call plan for the wrapped C function, resolved once when
+    // the gsubr is created.
+    GIFunctionInvoker invoker;
+    GITypeInfo *return_type;
+    guint8 has_invoker:1;
+    guint8 is_method:1;
+    guint8 can_throw:1;
+    // Whether the gsubr takes its arguments as a rest list, which
+    // is the case when there are more than SCM_GSUBR_MAX of them.
+    guint8 has_rest:1;
+    guint8 padding:4;
+
+    // The call counters, allocated on the first call made while
+    // statistics are enabled.
+    GigStats *stats;
+    guint32 trace_id;
 } GigFunction;
 
+// The argument arrays for one call of a GICallable.  The frame's
+// storage comes from the caller's stack when the argument map is
+// small enough, and from a thread-local pool otherwise.
+typedef struct _GigInvokeFrame GigInvokeFrame;
+typedef struct _GigInvokePool GigInvokePool;
+
+struct _GigInvokeFrame
+{
+    // The C input arguments, including the instance slot of a method.
+    GIArgument *in_args;
+    gint in_len;
+    // The C input arguments, not including the instance slot.
+    GIArgument *c_in_args;
+    GIArgument *out_args;
+    GIArgument *out_boxes;
+    gint out_len;
+    GigArena *must_free;
+    // The bytes of temporaries that were allocated for the call, as
+    // found when the frame was released.
+    gsize temp_bytes;
+    GigInvokePool *pool;
+    // The Scheme instance of a method call, which owns borrowed return
+    // values, or #f.
+    SCM owner;
+};
+
+struct _GigInvokePool
+{
+    GigInvokePool *next;
+    GIArgument *slots;
+    gsize n_slots;
+    GigArena *must_free;
+};
+
+// Most GI functions take fewer arguments than this, so their frames
+// fit on the C stack.
+#define GIG_INVOKE_FRAME_STACK_SLOTS 24
+
+static void invoke_pool_free_all(GigInvokePool *pool);
+static GPrivate invoke_pools = G_PRIVATE_INIT((GDestroyNotify)invoke_pool_free_all);
+
 static GHashTable *function_cache;
 SCM ensure_generic_proc;
 SCM make_proc;
@@ -60,17 +122,20 @@ static GigGsubr *create_gsubr(GIFunctionInfo *function_info, const gchar *name,
 static void make_formals(GICallableInfo *, GigArgMap *, gint n_inputs, SCM self_type,
                          SCM *formals, SCM *specializers);
 static void function_binding(ffi_cif *cif, gpointer ret, gpointer *ffi_args, gpointer user_data);
-static SCM function_invoke(GIFunctionInfo *info, GigArgMap *amap, const gchar *name,
-                           GObject *object, SCM args, GError **error);
+static SCM function_invoke(GigFunction *gfn, SCM s_self, GObject *object, const SCM *argv,
+                           gint argc, GError **error);
+static gboolean function_call(GigFunction *gfn, GIArgument *in_args, GIArgument *out_args,
+                              GIArgument *return_arg, GError **error);
 static SCM convert_output_args(GigArgMap *amap, const gchar *name, GIArgument *in, GIArgument *out,
                                SCM output);
 static void object_list_to_c_args(GigArgMap *amap, const gchar *subr,
-                                  SCM s_args, GArray *in_args, GPtrArray *cinvoke_free_array,
-                                  GArray *out_args);
+                                  const SCM *argv, gint argc,
+                                  GIArgument *in_args, GigArena *cinvoke_free_array,
+                                  GIArgument *out_args);
 static void
 store_argument(gint invoke_in, gint invoke_out, gboolean inout, gboolean inout_free,
-               GIArgument *arg, GArray *cinvoke_input_arg_array, GPtrArray *cinvoke_free_array,
-               GArray *cinvoke_output_arg_array);
+               GIArgument *arg, GIArgument *in_args, GigArena *cinvoke_free_array,
+               GIArgument *out_args);
 static void function_free(GigFunction *fn);
 static void gig_fini_function(void);
 static SCM gig_function_define1(const gchar *public_name, SCM proc, int opt, SCM formals,
@@ -105,6 +170,219 @@ default_definition(SCM name)
 
 #undef LOOKUP_DEFINITION
 
+// While a definition batch is open, the methods made for generics are
+// collected instead of being added one at a time as they are made, and
+// the generics are only defined when the batch is closed.  Only the
+// thread that opened the batch uses it, and only while the current
+// module is the one it was opened in.
+static GThread *batch_owner = NULL;
+static gint batch_depth = 0;
+static SCM batch_module;
+// Generic -> methods to add, latest first.
+static SCM batch_methods;
+// Name -> generic to define.
+static SCM batch_definitions;
+// The lists interned by the batch, which are forgotten when it is
+// closed.
+static GHashTable *batch_signatures;
+static SCM batch_signature_lists;
+G_LOCK_DEFINE_STATIC(batch);
+
+static SCM cons_proc;
+static SCM add_methods_proc = SCM_UNDEFINED;
+
+static gboolean
+batch_is_open(void)
+{
+    return (batch_depth > 0 && batch_owner == g_thread_self()
+            && scm_is_eq(scm_current_module(), batch_module));
+}
+
+static guint
+signature_hash(gconstpointer key)
+{
+    SCM list = SCM_PACK_POINTER(key);
+    guint hash = 0;
+
+    for (; scm_is_pair(list); list = scm_cdr(list))
+        hash = hash * 31 + g_direct_hash(SCM_UNPACK_POINTER(scm_car(list)));
+    return hash ^ g_direct_hash(SCM_UNPACK_POINTER(list));
+}
+
+static gboolean
+signature_equal(gconstpointer a, gconstpointer b)
+{
+    SCM x = SCM_PACK_POINTER(a), y = SCM_PACK_POINTER(b);
+
+    for (; scm_is_pair(x) && scm_is_pair(y); x = scm_cdr(x), y = scm_cdr(y))
+        if (!scm_is_eq(scm_car(x), scm_car(y)))
+            return FALSE;
+    return scm_is_eq(x, y);
+}
+
+// Returns the first list that the open batch interned with the same
+// elements as LIST, compared with eq?, so that the methods of all
+// functions with the same signature share their formals and
+// specializers.  Outside of a batch, LIST is returned.
+SCM
+gig_function_intern_signature(SCM list)
+{
+    if (!batch_is_open())
+        return list;
+
+    gpointer interned = g_hash_table_lookup(batch_signatures, SCM_UNPACK_POINTER(list));
+    if (interned != NULL)
+        return SCM_PACK_POINTER(interned);
+    scm_hashq_set_x(batch_signature_lists, list, SCM_BOOL_T);
+    g_hash_table_add(batch_signatures, SCM_UNPACK_POINTER(list));
+    return list;
+}
+
+// Forgets what the batch holds.  The batch must be closed.
+static void
+batch_clear(void)
+{
+    g_hash_table_remove_all(batch_signatures);
+    scm_hash_clear_x(batch_signature_lists);
+    scm_hash_clear_x(batch_methods);
+    scm_hash_clear_x(batch_definitions);
+}
+
+// Closes the batch at LEVEL and those nested in it, when they are left
+// through a non-local exit.  What the outermost batch holds is dropped
+// instead of being added.
+static void
+batch_abort(void *level)
+{
+    gboolean drop = FALSE;
+
+    G_LOCK(batch);
+    if (batch_owner == g_thread_self() && batch_depth >= GPOINTER_TO_INT(level)) {
+        batch_depth = GPOINTER_TO_INT(level) - 1;
+        if (batch_depth == 0) {
+            batch_owner = NULL;
+            batch_module = SCM_BOOL_F;
+            drop = TRUE;
+        }
+    }
+    G_UNLOCK(batch);
+
+    if (drop)
+        batch_clear();
+}
+
+// Opens a definition batch, to be closed by gig_define_batch_end before
+// the current dynwind context ends.  If the context is left through a
+// non-local exit instead, the batch is dropped.  Batches nest, and only
+// the outermost one adds the methods.
+void
+gig_define_batch_begin(void)
+{
+    gint level = 0;
+
+    G_LOCK(batch);
+    if (batch_depth == 0 || batch_owner == g_thread_self()) {
+        if (batch_depth == 0) {
+            batch_owner = g_thread_self();
+            batch_module = scm_current_module();
+        }
+        level = ++batch_depth;
+    }
+    G_UNLOCK(batch);
+
+    if (level > 0)
+        scm_dynwind_unwind_handler(batch_abort, GINT_TO_POINTER(level), 0);
+}
+
+// Adds METHODS, latest first, to GENERIC in one pass, so that GOOPS
+// resets the dispatch state of GENERIC once rather than per method.
+static void
+add_methods(SCM generic, SCM methods)
+{
+    if (SCM_UNBNDP(add_methods_proc))
+        add_methods_proc = scm_c_private_ref("gi oop", "%add-methods!");
+    if (scm_is_pair(methods))
+        scm_call_2(add_methods_proc, generic, scm_reverse(methods));
+}
+
+void
+gig_define_batch_end(void)
+{
+    gboolean last = FALSE;
+
+    G_LOCK(batch);
+    if (batch_depth > 0 && batch_owner == g_thread_self()) {
+        last = (batch_depth == 1);
+        if (!last)
+            batch_depth--;
+    }
+    G_UNLOCK(batch);
+    if (!last)
+        return;
+
+    // The batch is closed before its methods are added, so that an
+    // error in GOOPS does not leave it open.
+    SCM module = batch_module;
+    SCM pending = scm_hash_map_to_list(cons_proc, batch_methods);
+    SCM definitions = scm_hash_map_to_list(cons_proc, batch_definitions);
+
+    G_LOCK(batch);
+    batch_depth = 0;
+    batch_owner = NULL;
+    batch_module = SCM_BOOL_F;
+    G_UNLOCK(batch);
+    batch_clear();
+
+    for (; scm_is_pair(pending); pending = scm_cdr(pending))
+        add_methods(scm_caar(pending), scm_cdar(pending));
+    for (; scm_is_pair(definitions); definitions = scm_cdr(definitions))
+        scm_module_define(module, scm_caar(definitions), scm_cdar(definitions));
+}
+
+// Returns what NAME is defined as, for a function or property to
+// extend, including what the open batch defines.
+SCM
+gig_function_definition(SCM name)
+{
+    if (batch_is_open()) {
+        SCM generic = scm_hashq_ref(batch_definitions, name, SCM_BOOL_F);
+        if (scm_is_true(generic))
+            return generic;
+    }
+    return default_definition(name);
+}
+
+void
+gig_function_add_method(SCM generic, SCM method)
+{
+    if (batch_is_open())
+        scm_hashq_set_x(batch_methods, generic,
+                        scm_cons(method, scm_hashq_ref(batch_methods, generic, SCM_EOL)));
+    else
+        scm_call_2(add_method_proc, generic, method);
+}
+
+// Adds the methods of GENERIC that the open batch holds now, for
+// instance before it is replaced by an accessor that copies them.
+void
+gig_function_flush_generic(SCM generic)
+{
+    if (!batch_is_open() || !scm_is_generic(generic))
+        return;
+    SCM methods = scm_hashq_ref(batch_methods, generic, SCM_EOL);
+    scm_hashq_remove_x(batch_methods, generic);
+    add_methods(generic, methods);
+}
+
+void
+gig_function_define_generic(SCM name, SCM generic)
+{
+    if (batch_is_open())
+        scm_hashq_set_x(batch_definitions, name, generic);
+    else
+        scm_define(name, generic);
+}
+
 SCM
 gig_function_define(GType type, GICallableInfo *info, const gchar *_namespace, SCM defs)
 {
@@ -170,11 +448,14 @@ gig_function_define1(const gchar *public_name, SCM proc, int opt, SCM formals, S
     g_return_val_if_fail(public_name != NULL, SCM_UNDEFINED);
 
     SCM sym_public_name = scm_from_utf8_symbol(public_name);
-    SCM generic = default_definition(sym_public_name);
-    if (!scm_is_generic(generic))
+    SCM generic = gig_function_definition(sym_public_name);
+    if (!scm_is_generic(generic)) {
         generic = scm_call_2(ensure_generic_proc, generic, sym_public_name);
+        gig_load_stats_count(GIG_LOAD_GENERICS, 1);
+    }
 
-    SCM t_formals = formals, t_specializers = specializers;
+    SCM t_formals = gig_function_intern_signature(formals);
+    SCM t_specializers = gig_function_intern_signature(specializers);
 
     do {
         SCM mthd = scm_call_7(make_proc,
@@ -183,16 +464,17 @@ gig_function_define1(const gchar *public_name, SCM proc, int opt, SCM formals, S
                               kwd_formals, t_formals,
                               kwd_procedure, proc);
 
-        scm_call_2(add_method_proc, generic, mthd);
+        gig_function_add_method(generic, mthd);
+        gig_load_stats_count(GIG_LOAD_METHODS, 1);
 
         if (scm_is_eq(t_formals, SCM_EOL))
             break;
 
-        t_formals = scm_drop_right_1(t_formals);
-        t_specializers = scm_drop_right_1(t_specializers);
+        t_formals = gig_function_intern_signature(scm_drop_right_1(t_formals));
+        t_specializers = gig_function_intern_signature(scm_drop_right_1(t_specializers));
     } while (opt-- > 0);
 
-    scm_define(sym_public_name, generic);
+    gig_function_define_generic(sym_public_name, generic);
     return sym_public_name;
 }
 
@@ -210,7 +492,11 @@ proc4function(GIFunctionInfo *info, const gchar *name, SCM self_type,
         return SCM_UNDEFINED;
     }
 
-    return scm_c_make_gsubr(name, 0, 0, 1, func_gsubr);
+    // Wide functions take a rest list, because gsubrs are limited in
+    // the number of arguments they can declare.
+    if (*req + *opt > SCM_GSUBR_MAX)
+        return scm_c_make_gsubr(name, 0, 0, 1, func_gsubr);
+    return scm_c_make_gsubr(name, *req, *opt, 0, func_gsubr);
 }
 
 static SCM
@@ -258,17 +544,28 @@ proc4signal(GISignalInfo *info, const gchar *name, SCM self_type, int *req, int
 
     SCM signal = gig_make_signal(2, slots, values);
 
-    // check for collisions
-    SCM current_definition = current_module_definition(scm_from_utf8_symbol(name));
-    if (scm_is_true(current_definition))
-        for (SCM iter = scm_generic_function_methods(current_definition);
-             scm_is_pair(iter); iter = scm_cdr(iter))
-            if (scm_is_equal(*specializers, scm_method_specializers(scm_car(iter)))) {
-                // we'd be overriding an already defined generic method, let's not do that
-                scm_slot_set_x(signal, scm_from_utf8_symbol("procedure"),
-                               scm_method_procedure(scm_car(iter)));
-                break;
-            }
+    // check for collisions, including with what the open batch has yet
+    // to define, latest first
+    SCM sym_name = scm_from_utf8_symbol(name);
+    SCM current_definition = SCM_BOOL_F;
+    SCM methods = SCM_EOL;
+    if (batch_is_open())
+        current_definition = scm_hashq_ref(batch_definitions, sym_name, SCM_BOOL_F);
+    if (scm_is_false(current_definition))
+        current_definition = current_module_definition(sym_name);
+    if (scm_is_generic(current_definition)) {
+        methods = scm_generic_function_methods(current_definition);
+        if (batch_is_open())
+            methods = scm_append(scm_list_2(scm_hashq_ref(batch_methods, current_definition,
+                                                          SCM_EOL), methods));
+    }
+    for (SCM iter = methods; scm_is_pair(iter); iter = scm_cdr(iter))
+        if (scm_is_equal(*specializers, scm_method_specializers(scm_car(iter)))) {
+            // we'd be overriding an already defined generic method, let's not do that
+            scm_slot_set_x(signal, scm_from_utf8_symbol("procedure"),
+                           scm_method_procedure(scm_car(iter)));
+            break;
+        }
 
     return signal;
 }
@@ -285,7 +582,7 @@ check_gsubr_cache(GICallableInfo *function_info, SCM self_type, gint *required_i
 
     gig_amap_s_input_count(gfn->amap, required_input_count, optional_input_count);
 
-    if (g_callable_info_is_method(gfn->function_info))
+    if (gfn->is_method)
         (*required_input_count)++;
 
     make_formals(gfn->function_info,
@@ -380,15 +677,34 @@ create_gsubr(GIFunctionInfo *function_info, const gchar *name, SCM self_type,
     }
 
     gfn = g_new0(GigFunction, 1);
+    gig_load_stats_count(GIG_LOAD_BYTES, sizeof(GigFunction));
     gfn->function_info = function_info;
     gfn->amap = amap;
     g_free(gfn->name);
     gfn->name = g_strdup(name);
     g_base_info_ref(function_info);
+    gfn->is_method = g_callable_info_is_method(function_info);
+    gfn->can_throw = g_callable_info_can_throw_gerror(function_info);
+
+    // Resolve the C symbol and prepare the FFI call interface for the
+    // wrapped function now, so that calling it doesn't have to.  If
+    // this fails, g_function_info_invoke will report the error when
+    // the procedure gets called.
+    GError *error = NULL;
+    if (g_function_info_prep_invoker(function_info, &gfn->invoker, &error)) {
+        gfn->has_invoker = TRUE;
+        gfn->return_type = g_callable_info_get_return_type(function_info);
+        g_assert_cmpint(gfn->invoker.cif.nargs, ==,
+                        gfn->is_method + amap->len + gfn->can_throw);
+    }
+    else {
+        gig_debug_load("%s - could not prepare invoker: %s", name, error->message);
+        g_clear_error(&error);
+    }
 
     gig_amap_s_input_count(gfn->amap, required_input_count, optional_input_count);
 
-    if (g_callable_info_is_method(gfn->function_info))
+    if (gfn->is_method)
         (*required_input_count)++;
 
     make_formals(gfn->function_info, gfn->amap, *required_input_count + *optional_input_count,
@@ -399,6 +715,8 @@ create_gsubr(GIFunctionInfo *function_info, const gchar *name, SCM self_type,
     // object, and set a pointer to the corresponding executable
     // address.
     gfn->closure = ffi_closure_alloc(sizeof(ffi_closure), &(gfn->function_ptr));
+    gig_load_stats_count(GIG_LOAD_CLOSURES, 1);
+    gig_load_stats_count(GIG_LOAD_BYTES, sizeof(ffi_closure));
 
     g_return_val_if_fail(gfn->closure != NULL, NULL);
     g_return_val_if_fail(gfn->function_ptr != NULL, NULL);
@@ -407,12 +725,19 @@ create_gsubr(GIFunctionInfo *function_info, const gchar *name, SCM self_type,
     // Next, we begin to construct an FFI_CIF to describe the function
     // call.
 
-    // Initialize the argument info vectors.
-    gint have_args = 0;
-    if (*required_input_count + *optional_input_count > 0) {
-        gfn->atypes = g_new0(ffi_type *, 1);
-        gfn->atypes[0] = &ffi_type_pointer;
-        have_args = 1;
+    // Initialize the argument info vectors.  Each argument is an SCM,
+    // unless there are too many of them and they come packed in a
+    // list.
+    gint n_args = *required_input_count + *optional_input_count;
+    if (n_args > SCM_GSUBR_MAX) {
+        gfn->has_rest = TRUE;
+        n_args = 1;
+    }
+    if (n_args > 0) {
+        gfn->atypes = g_new0(ffi_type *, n_args);
+        gig_load_stats_count(GIG_LOAD_BYTES, n_args * sizeof(ffi_type *));
+        for (gint i = 0; i < n_args; i++)
+            gfn->atypes[i] = &ffi_type_pointer;
     }
     else
         gfn->atypes = NULL;
@@ -422,7 +747,7 @@ create_gsubr(GIFunctionInfo *function_info, const gchar *name, SCM self_type,
 
     // Initialize the CIF Call Interface Struct.
     ffi_status prep_ok;
-    prep_ok = ffi_prep_cif(&(gfn->cif), FFI_DEFAULT_ABI, have_args, ffi_ret_type, gfn->atypes);
+    prep_ok = ffi_prep_cif(&(gfn->cif), FFI_DEFAULT_ABI, n_args, ffi_ret_type, gfn->atypes);
 
     if (prep_ok != FFI_OK)
         scm_misc_error("gir-function-create-gsubr",
@@ -446,28 +771,88 @@ create_gsubr(GIFunctionInfo *function_info, const gchar *name, SCM self_type,
 }
 
 static void
-gig_callable_prepare_invoke(GigArgMap *amap,
-                            const gchar *name,
-                            GObject *self,
-                            SCM args,
-                            GArray **cinvoke_input_arg_array,
-                            GArray **cinvoke_output_arg_array,
-                            GPtrArray **cinvoke_free_array,
-                            GIArgument **out_args, GIArgument **out_boxes)
-{
-    *cinvoke_input_arg_array = g_array_new(FALSE, TRUE, sizeof(GIArgument));
-    *cinvoke_output_arg_array = g_array_new(FALSE, TRUE, sizeof(GIArgument));
-    *cinvoke_free_array = g_ptr_array_new_with_free_func(g_free);
+invoke_pool_free_all(GigInvokePool *pool)
+{
+    while (pool != NULL) {
+        GigInvokePool *next = pool->next;
+        gig_arena_free(pool->must_free);
+        g_free(pool->slots);
+        g_free(pool);
+        pool = next;
+    }
+}
 
-    // Convert the scheme arguments into C.
-    object_list_to_c_args(amap, name, args, *cinvoke_input_arg_array,
-                          *cinvoke_free_array, *cinvoke_output_arg_array);
-    // For methods calls, the object gets inserted as the 1st argument.
-    if (self) {
-        GIArgument self_arg;
-        self_arg.v_pointer = self;
-        g_array_prepend_val(*cinvoke_input_arg_array, self_arg);
+// Sets up FRAME for a call described by AMAP.  When HAS_SELF is true,
+// the first input slot is reserved for the instance argument SELF.
+// STACK is caller storage of N_STACK arguments that is used when it
+// is large enough.
+static void
+invoke_frame_init(GigInvokeFrame *frame, GigArgMap *amap, gboolean has_self, gpointer self,
+                  GIArgument *stack, gsize n_stack)
+{
+    GigInvokePool *pool = g_private_get(&invoke_pools);
+    if (pool != NULL)
+        g_private_set(&invoke_pools, pool->next);
+    else {
+        pool = g_new0(GigInvokePool, 1);
+        pool->must_free = gig_arena_new();
     }
+    pool->next = NULL;
+
+    frame->pool = pool;
+    frame->must_free = pool->must_free;
+    frame->temp_bytes = 0;
+    frame->owner = SCM_BOOL_F;
+    frame->in_len = amap->c_input_len + (has_self ? 1 : 0);
+    frame->out_len = amap->c_output_len;
+
+    // The input arguments, the output arguments and the boxes that
+    // hold immediate output values.
+    gsize n_slots = frame->in_len + 2 * frame->out_len;
+    GIArgument *slots = stack;
+    if (n_slots > n_stack) {
+        if (n_slots > pool->n_slots) {
+            pool->slots = g_renew(GIArgument, pool->slots, n_slots);
+            pool->n_slots = n_slots;
+        }
+        slots = pool->slots;
+    }
+    memset(slots, 0, n_slots * sizeof(GIArgument));
+
+    frame->in_args = slots;
+    frame->c_in_args = slots + (has_self ? 1 : 0);
+    frame->out_args = slots + frame->in_len;
+    frame->out_boxes = frame->out_args + frame->out_len;
+
+    if (has_self)
+        frame->in_args[0].v_pointer = self;
+}
+
+// Frees the temporaries of FRAME and returns its storage to the pool.
+// This is also the unwind handler of the call, so it may be called
+// on a frame that has already been released.
+static void
+invoke_frame_release(GigInvokeFrame *frame)
+{
+    GigInvokePool *pool = frame->pool;
+
+    if (pool == NULL)
+        return;
+
+    frame->temp_bytes = gig_arena_allocated(pool->must_free);
+    gig_arena_reset(pool->must_free);
+    pool->next = g_private_get(&invoke_pools);
+    g_private_set(&invoke_pools, pool);
+    frame->pool = NULL;
+}
+
+static void
+gig_callable_prepare_invoke(GigArgMap *amap, const gchar *name, const SCM *argv, gint argc,
+                            GigInvokeFrame *frame)
+{
+    // Convert the scheme arguments into C.
+    object_list_to_c_args(amap, name, argv, argc, frame->c_in_args, frame->must_free,
+                          frame->out_args);
 
     // Since, in the Guile binding, we're allocating the output
     // parameters in most cases, here's where we make space for
@@ -477,31 +862,22 @@ gig_callable_prepare_invoke(GigArgMap *amap,
     // allocate space for *all* the output arguments, even when not
     // needed.  It is easier than figuring out which output arguments
     // need allocation.
-    *out_args = (GIArgument *)((*cinvoke_output_arg_array)->data);
-    *out_boxes = g_new0(GIArgument, (*cinvoke_output_arg_array)->len);
-    g_ptr_array_insert(*cinvoke_free_array, 0, *out_boxes);
-    for (guint i = 0; i < (*cinvoke_output_arg_array)->len; i++)
-        if ((*out_args + i)->v_pointer == NULL)
-            (*out_args + i)->v_pointer = *out_boxes + i;
+    for (gint i = 0; i < frame->out_len; i++)
+        if (frame->out_args[i].v_pointer == NULL)
+            frame->out_args[i].v_pointer = frame->out_boxes + i;
 }
 
 static SCM
-gig_callable_return_value(GigArgMap *amap,
-                          const gchar *name,
-                          GObject *self,
-                          SCM args,
-                          gboolean ok,
-                          GIArgument *return_arg,
-                          GArray *cinvoke_input_arg_array,
-                          GArray *cinvoke_output_arg_array,
-                          GPtrArray *cinvoke_free_array,
-                          GIArgument *out_args, GIArgument *out_boxes)
+gig_callable_return_value(GigArgMap *amap, const gchar *name, gboolean ok,
+                          GIArgument *return_arg, GigInvokeFrame *frame)
 {
     SCM output = SCM_EOL;
+    GIArgument *out_args = frame->out_args;
+    GIArgument *out_boxes = frame->out_boxes;
 
     // Here is where I check to see if I used the allocated
     // output argument space created above.
-    for (guint i = 0; i < cinvoke_output_arg_array->len; i++)
+    for (gint i = 0; i < frame->out_len; i++)
         if (out_args[i].v_pointer == &out_boxes[i])
             memcpy(&out_args[i], &out_boxes[i], sizeof(GIArgument));
 
@@ -510,29 +886,29 @@ gig_callable_return_value(GigArgMap *amap,
         gsize sz = -1;
         if (amap->return_val.meta.has_size) {
             gsize idx = amap->return_val.child->c_output_pos;
-            sz = ((GIArgument *)(cinvoke_output_arg_array->data))[idx].v_size;
+            sz = out_args[idx].v_size;
         }
 
-        gig_argument_c_to_scm(name, -1, &amap->return_val.meta, return_arg, &s_return, sz);
+        // A boxed return value that is not transferred may be borrowed
+        // from the instance that returned it.
+        if (G_UNLIKELY(gig_type_borrow_boxed) && scm_is_true(frame->owner)) {
+            scm_dynwind_begin(0);
+            gig_type_dynwind_borrow(frame->owner);
+            gig_argument_entry_c_to_scm(&amap->return_val, name, -1, return_arg, &s_return, sz);
+            scm_dynwind_end();
+        }
+        else
+            gig_argument_entry_c_to_scm(&amap->return_val, name, -1, return_arg, &s_return,
+                                        sz);
         if (scm_is_eq(s_return, SCM_UNSPECIFIED))
             output = SCM_EOL;
         else
             output = scm_list_1(s_return);
 
-
-        if (self)
-            output = convert_output_args(amap, name,
-                                         (GIArgument *)cinvoke_input_arg_array->data + 1,
-                                         (GIArgument *)cinvoke_output_arg_array->data, output);
-        else
-            output = convert_output_args(amap, name,
-                                         (GIArgument *)cinvoke_input_arg_array->data,
-                                         (GIArgument *)cinvoke_output_arg_array->data, output);
+        output = convert_output_args(amap, name, frame->c_in_args, out_args, output);
     }
 
-    g_array_free(cinvoke_input_arg_array, TRUE);
-    g_array_free(cinvoke_output_arg_array, TRUE);
-    g_ptr_array_free(cinvoke_free_array, TRUE);
+    invoke_frame_release(frame);
 
     if (!ok)
         return SCM_UNDEFINED;
@@ -547,70 +923,133 @@ gig_callable_return_value(GigArgMap *amap,
     }
 }
 
+// Calls the C function of GFN, using its prepared call plan when one
+// is available.  The argument arrays are laid out as they would be for
+// g_function_info_invoke.
+static gboolean
+function_call(GigFunction *gfn, GIArgument *in_args, GIArgument *out_args,
+              GIArgument *return_arg, GError **error)
+{
+    if (!gfn->has_invoker) {
+        gint n_in = gfn->amap->c_input_len + gfn->is_method;
+        gint n_out = gfn->amap->c_output_len;
+        return g_function_info_invoke(gfn->function_info, in_args, n_in, out_args, n_out,
+                                      return_arg, error);
+    }
+
+    GigArgMap *amap = gfn->amap;
+    guint n_args = gfn->invoker.cif.nargs;
+    gpointer *ffi_args = g_alloca(sizeof(gpointer) * n_args);
+    GError *local_error = NULL;
+    gpointer error_address = &local_error;
+    GIFFIReturnValue ffi_return;
+    gint offset = 0;
+
+    if (gfn->is_method)
+        ffi_args[offset++] = &in_args[0];
+
+    // Input and inout arguments are passed from the input array, output
+    // arguments as pointers to their slots in the output array.
+    for (gint i = 0; i < amap->len; i++) {
+        GigArgMapEntry *entry = &amap->pdata[i];
+        if (entry->is_c_input)
+            ffi_args[offset + i] = &in_args[entry->c_input_pos + gfn->is_method];
+        else
+            ffi_args[offset + i] = &out_args[entry->c_output_pos];
+    }
+
+    if (gfn->can_throw)
+        ffi_args[n_args - 1] = &error_address;
+
+    ffi_call(&gfn->invoker.cif, gfn->invoker.native_address, &ffi_return, ffi_args);
+
+    if (local_error) {
+        g_propagate_error(error, local_error);
+        return FALSE;
+    }
+
+    gi_type_info_extract_ffi_return_value(gfn->return_type, &ffi_return, return_arg);
+    return TRUE;
+}
+
 static SCM
-function_invoke(GIFunctionInfo *func_info, GigArgMap *amap, const gchar *name, GObject *self,
-                SCM args, GError **error)
+function_invoke(GigFunction *gfn, SCM s_self, GObject *self, const SCM *argv, gint argc,
+                GError **error)
 {
-    GArray *cinvoke_input_arg_array;
-    GPtrArray *cinvoke_free_array;
-    GArray *cinvoke_output_arg_array;
-    GIArgument *out_args, *out_boxes;
+    GIArgument stack[GIG_INVOKE_FRAME_STACK_SLOTS];
+    GigInvokeFrame frame;
+    GigArgMap *amap = gfn->amap;
+    const gchar *name = gfn->name;
+    gint64 start = gig_stats_start();
+    guint32 trace = gig_trace_begin(&gfn->trace_id, GIG_STATS_FUNCTION, name);
+    GigWatchdogCall watchdog;
+    gig_watchdog_start(&watchdog);
 
-    gig_callable_prepare_invoke(amap, name, self, args,
-                                &cinvoke_input_arg_array,
-                                &cinvoke_output_arg_array,
-                                &cinvoke_free_array, &out_args, &out_boxes);
+    scm_dynwind_begin(0);
+    invoke_frame_init(&frame, amap, gfn->is_method, self, stack, G_N_ELEMENTS(stack));
+    frame.owner = s_self;
+    scm_dynwind_unwind_handler((void (*)(void *))invoke_frame_release, &frame, 0);
+    gig_trace_dynwind_exit(trace);
+    gig_watchdog_dynwind_watch(&watchdog, GIG_STATS_FUNCTION, name);
+    gig_callable_prepare_invoke(amap, name, argv, argc, &frame);
 
     // Make the actual call.
-    // Use GObject's ffi to call the C function.
-    g_debug("%s - calling with %d input and %d output arguments",
-            name, cinvoke_input_arg_array->len, cinvoke_output_arg_array->len);
+    gig_debug_call("%s - calling with %d input and %d output arguments",
+            name, frame.in_len, frame.out_len);
     gig_amap_dump(name, amap);
 
     GIArgument return_arg;
     return_arg.v_pointer = NULL;
-    gboolean ok = g_function_info_invoke(func_info, (GIArgument *)(cinvoke_input_arg_array->data),
-                                         cinvoke_input_arg_array->len,
-                                         (GIArgument *)(cinvoke_output_arg_array->data),
-                                         cinvoke_output_arg_array->len, &return_arg, error);
-    return gig_callable_return_value(amap, name, self, args, ok, &return_arg,
-                                     cinvoke_input_arg_array, cinvoke_output_arg_array,
-                                     cinvoke_free_array, out_args, out_boxes);
+    gboolean ok = function_call(gfn, frame.in_args, frame.out_args, &return_arg, error);
+    SCM output = gig_callable_return_value(amap, name, ok, &return_arg, &frame);
+    scm_dynwind_end();
+
+    gig_trace_end(trace);
+    if (start)
+        gig_stats_record(&gfn->stats, GIG_STATS_FUNCTION, name, start, !ok, frame.temp_bytes);
+    if (gig_watchdog_stalled(watchdog.start)) {
+        SCM args = SCM_EOL;
+        for (gint i = argc - 1; i >= 0; i--)
+            args = scm_cons(argv[i], args);
+        gig_watchdog_report(GIG_STATS_FUNCTION, name, watchdog.start, args);
+    }
+    return output;
 }
 
 SCM
 gig_callable_invoke(GICallableInfo *callable_info, gpointer callable, GigArgMap *amap,
                     const gchar *name, GObject *self, SCM args, GError **error)
 {
-    GArray *cinvoke_input_arg_array;
-    GPtrArray *cinvoke_free_array;
-    GArray *cinvoke_output_arg_array;
-    GIArgument *out_args, *out_boxes;
+    GIArgument stack[GIG_INVOKE_FRAME_STACK_SLOTS];
+    GigInvokeFrame frame;
     GIArgument return_arg;
     gboolean ok;
 
-    gig_callable_prepare_invoke(amap, name, self, args,
-                                &cinvoke_input_arg_array,
-                                &cinvoke_output_arg_array,
-                                &cinvoke_free_array, &out_args, &out_boxes);
+    gint argc = SCM_UNBNDP(args) ? 0 : scm_c_length(args);
+    SCM *argv = g_alloca(sizeof(SCM) * argc);
+    for (gint i = 0; i < argc; i++, args = scm_cdr(args))
+        argv[i] = scm_car(args);
+
+    scm_dynwind_begin(0);
+    invoke_frame_init(&frame, amap, self != NULL, self, stack, G_N_ELEMENTS(stack));
+    scm_dynwind_unwind_handler((void (*)(void *))invoke_frame_release, &frame, 0);
+    gig_callable_prepare_invoke(amap, name, argv, argc, &frame);
 
     // Make the actual call.
     // Use GObject's ffi to call the C function.
-    g_debug("%s - calling with %d input and %d output arguments",
-            name, cinvoke_input_arg_array->len, cinvoke_output_arg_array->len);
+    gig_debug_call("%s - calling with %d input and %d output arguments",
+            name, frame.in_len, frame.out_len);
     gig_amap_dump(name, amap);
 
     ok = g_callable_info_invoke(callable_info, callable,
-                                (GIArgument *)(cinvoke_input_arg_array->data),
-                                cinvoke_input_arg_array->len,
-                                (GIArgument *)(cinvoke_output_arg_array->data),
-                                cinvoke_output_arg_array->len, &return_arg,
+                                frame.in_args, frame.in_len,
+                                frame.out_args, frame.out_len, &return_arg,
                                 g_callable_info_is_method(callable_info),
                                 g_callable_info_can_throw_gerror(callable_info), error);
 
-    return gig_callable_return_value(amap, name, self, args, ok, &return_arg,
-                                     cinvoke_input_arg_array, cinvoke_output_arg_array,
-                                     cinvoke_free_array, out_args, out_boxes);
+    SCM output = gig_callable_return_value(amap, name, ok, &return_arg, &frame);
+    scm_dynwind_end();
+    return output;
 }
 
 
@@ -624,7 +1063,9 @@ function_binding(ffi_cif *cif, gpointer ret, gpointer *ffi_args, gpointer user_d
 {
     GigFunction *gfn = user_data;
     GObject *self = NULL;
-    SCM s_args = SCM_UNDEFINED;
+    SCM s_self = SCM_BOOL_F;
+    SCM *argv;
+    gint argc = 0;
 
     // When using GLib thread functions, could this be the entrypoint
     // into Guile for this thread?
@@ -637,27 +1078,50 @@ function_binding(ffi_cif *cif, gpointer ret, gpointer *ffi_args, gpointer user_d
 
     guint n_args = cif->nargs;
 
-    // we have either 0 args or 1 args, which is the already packed list
-    g_assert(n_args <= 1);
-
-    if (n_args)
-        s_args = SCM_PACK(*(scm_t_bits *) (ffi_args[0]));
-
-    if (SCM_UNBNDP(s_args))
-        s_args = SCM_EOL;
+    if (gfn->has_rest) {
+        // we have 1 arg, which is the already packed list
+        g_assert(n_args == 1);
+        SCM s_args = SCM_PACK(*(scm_t_bits *) (ffi_args[0]));
+        if (SCM_UNBNDP(s_args))
+            s_args = SCM_EOL;
+
+        argc = scm_c_length(s_args);
+        argv = g_alloca(sizeof(SCM) * argc);
+        for (gint i = 0; i < argc; i++, s_args = scm_cdr(s_args))
+            argv[i] = scm_car(s_args);
+    }
+    else {
+        // Optional arguments that weren't supplied are unbound, and
+        // only trailing arguments can be optional.
+        argv = g_alloca(sizeof(SCM) * n_args);
+        while (argc < n_args) {
+            SCM obj = SCM_PACK(*(scm_t_bits *) (ffi_args[argc]));
+            if (SCM_UNBNDP(obj))
+                break;
+            argv[argc++] = obj;
+        }
+    }
 
-    if (scm_is_false(scm_hook_empty_p(gig_before_function_hook)))
+    if (!scm_is_null(SCM_HOOK_PROCEDURES(gig_before_function_hook))) {
+        SCM s_args = SCM_EOL;
+        for (gint i = argc - 1; i >= 0; i--)
+            s_args = scm_cons(argv[i], s_args);
         scm_c_run_hook(gig_before_function_hook,
                        scm_list_2(scm_from_utf8_string(gfn->name), s_args));
+    }
 
-    if (g_callable_info_is_method(gfn->function_info)) {
-        self = gig_type_peek_object(scm_car(s_args));
-        s_args = scm_cdr(s_args);
+    if (gfn->is_method) {
+        if (argc < 1)
+            scm_error_num_args_subr(gfn->name);
+        s_self = argv[0];
+        self = gig_type_peek_object(s_self);
+        argv++;
+        argc--;
     }
 
     // Then invoke the actual function
     GError *err = NULL;
-    SCM output = function_invoke(gfn->function_info, gfn->amap, gfn->name, self, s_args, &err);
+    SCM output = function_invoke(gfn, s_self, self, argv, argc, &err);
 
     // If there is a GError, write an error and exit.
     if (err) {
@@ -675,8 +1139,7 @@ function_binding(ffi_cif *cif, gpointer ret, gpointer *ffi_args, gpointer user_d
 
 static void
 object_to_c_arg(GigArgMap *amap, gint s, const gchar *name, SCM obj,
-                GArray *cinvoke_input_arg_array, GPtrArray *cinvoke_free_array,
-                GArray *cinvoke_output_arg_array)
+                GIArgument *in_args, GigArena *cinvoke_free_array, GIArgument *out_args)
 {
     // Convert an input scheme argument to a C invoke argument
     GIArgument arg;
@@ -688,7 +1151,7 @@ object_to_c_arg(GigArgMap *amap, gint s, const gchar *name, SCM obj,
     gboolean inout, inout_free;
 
     entry = gig_amap_get_input_entry_by_s(amap, s);
-    gig_argument_scm_to_c(name, s, &entry->meta, obj, cinvoke_free_array, &arg, &size);
+    gig_argument_entry_scm_to_c(entry, name, s, obj, cinvoke_free_array, &arg, &size);
 
     // Store the converted argument.
     is_in = gig_amap_input_s2c(amap, s, &c_invoke_in);
@@ -708,7 +1171,7 @@ object_to_c_arg(GigArgMap *amap, gint s, const gchar *name, SCM obj,
     else
         inout_free = FALSE;
     store_argument(c_invoke_in, c_invoke_out, inout, inout_free, &arg,
-                   cinvoke_input_arg_array, cinvoke_free_array, cinvoke_output_arg_array);
+                   in_args, cinvoke_free_array, out_args);
 
     // If this argument is an array with an associated size, store the
     // array size as well.
@@ -718,8 +1181,8 @@ object_to_c_arg(GigArgMap *amap, gint s, const gchar *name, SCM obj,
         gsize dummy_size;
         gint c_child_invoke_out, i_child;
 
-        gig_argument_scm_to_c(name, s, &size_entry->meta, scm_from_size_t(size),
-                              cinvoke_free_array, &size_arg, &dummy_size);
+        gig_argument_entry_scm_to_c(size_entry, name, s, scm_from_size_t(size),
+                                    cinvoke_free_array, &size_arg, &dummy_size);
 
         is_in = gig_amap_input_c2i(amap, c_child_invoke_in, &i_child);
         is_out = gig_amap_output_i2c(amap, i_child, &c_child_invoke_out);
@@ -733,74 +1196,57 @@ object_to_c_arg(GigArgMap *amap, gint s, const gchar *name, SCM obj,
         else
             inout_free = FALSE;
         store_argument(c_child_invoke_in, c_child_invoke_out, inout, inout_free, &size_arg,
-                       cinvoke_input_arg_array, cinvoke_free_array, cinvoke_output_arg_array);
+                       in_args, cinvoke_free_array, out_args);
     }
 }
 
 static void
 store_argument(gint invoke_in, gint invoke_out, gboolean inout, gboolean inout_free,
-               GIArgument *arg, GArray *cinvoke_input_arg_array, GPtrArray *cinvoke_free_array,
-               GArray *cinvoke_output_arg_array)
+               GIArgument *arg, GIArgument *in_args, GigArena *cinvoke_free_array,
+               GIArgument *out_args)
 {
     GIArgument *parg;
 
     if (invoke_in >= 0) {
         if (inout) {
-            gpointer *dup = g_memdup(arg, sizeof(GIArgument));
-            parg = &g_array_index(cinvoke_input_arg_array, GIArgument, invoke_in);
-            parg->v_pointer = dup;
-
+            gpointer dup;
             if (inout_free)
-                g_ptr_array_insert(cinvoke_free_array, 0, dup);
+                dup = gig_arena_memdup(cinvoke_free_array, arg, sizeof(GIArgument));
+            else
+                dup = g_memdup(arg, sizeof(GIArgument));
+            parg = &in_args[invoke_in];
+            parg->v_pointer = dup;
 
-            parg = &g_array_index(cinvoke_output_arg_array, GIArgument, invoke_out);
+            parg = &out_args[invoke_out];
             parg->v_pointer = 0;
         }
         else {
-            parg = &g_array_index(cinvoke_input_arg_array, GIArgument, invoke_in);
+            parg = &in_args[invoke_in];
             *parg = *arg;
         }
     }
     else if (invoke_out >= 0) {
-        parg = &g_array_index(cinvoke_output_arg_array, GIArgument, invoke_out);
+        parg = &out_args[invoke_out];
         *parg = *arg;
     }
 }
 
 static void
 object_list_to_c_args(GigArgMap *amap,
-                      const gchar *subr, SCM s_args,
-                      GArray *cinvoke_input_arg_array,
-                      GPtrArray *cinvoke_free_array, GArray *cinvoke_output_arg_array)
+                      const gchar *subr, const SCM *argv, gint argc,
+                      GIArgument *in_args, GigArena *cinvoke_free_array, GIArgument *out_args)
 {
     g_assert_nonnull(amap);
     g_assert_nonnull(subr);
-    g_assert_nonnull(cinvoke_input_arg_array);
     g_assert_nonnull(cinvoke_free_array);
-    g_assert_nonnull(cinvoke_output_arg_array);
 
-    gint args_count, required, optional;
-    if (SCM_UNBNDP(s_args))
-        args_count = 0;
-    else
-        args_count = scm_c_length(s_args);
+    gint required, optional;
     gig_amap_s_input_count(amap, &required, &optional);
-    if (args_count < required || args_count > required + optional)
+    if (argc < required || argc > required + optional)
         scm_error_num_args_subr(subr);
 
-    gint input_len, output_len;
-    gig_amap_c_count(amap, &input_len, &output_len);
-
-    g_array_set_size(cinvoke_input_arg_array, input_len);
-    g_array_set_size(cinvoke_output_arg_array, output_len);
-
-    for (gint i = 0; i < args_count; i++) {
-        SCM obj = scm_c_list_ref(s_args, i);
-        object_to_c_arg(amap, i, subr, obj, cinvoke_input_arg_array, cinvoke_free_array,
-                        cinvoke_output_arg_array);
-
-    }
-    return;
+    for (gint i = 0; i < argc; i++)
+        object_to_c_arg(amap, i, subr, argv[i], in_args, cinvoke_free_array, out_args);
 }
 
 GIArgument *
@@ -848,11 +1294,11 @@ convert_output_args(GigArgMap *amap, const gchar *func_name, GIArgument *in, GIA
             // this array argument.
             GigArgMapEntry *size_entry = entry->child;
             GIArgument *size_arg = find_output_arg(size_entry, in, out);
-            gig_argument_c_to_scm(func_name, size_entry->i, &size_entry->meta, size_arg, &obj, -1);
+            gig_argument_entry_c_to_scm(size_entry, func_name, size_entry->i, size_arg, &obj, -1);
             size = scm_is_integer(obj) ? scm_to_int(obj) : 0;
         }
 
-        gig_argument_c_to_scm(func_name, c_output_pos, &entry->meta, arg, &obj, size);
+        gig_argument_entry_c_to_scm(entry, func_name, c_output_pos, arg, &obj, size);
         output = scm_cons(obj, output);
     }
     return scm_reverse_x(output, SCM_EOL);
@@ -874,6 +1320,13 @@ gig_init_function(void)
     ensure_generic_proc = scm_c_public_ref("oop goops", "ensure-generic");
     make_proc = scm_c_public_ref("oop goops", "make");
     add_method_proc = scm_c_public_ref("oop goops", "add-method!");
+    cons_proc = scm_c_public_ref("guile", "cons");
+
+    batch_signatures = g_hash_table_new(signature_hash, signature_equal);
+    batch_signature_lists = scm_permanent_object(scm_c_make_hash_table(127));
+    batch_methods = scm_permanent_object(scm_c_make_hash_table(127));
+    batch_definitions = scm_permanent_object(scm_c_make_hash_table(127));
+    batch_module = SCM_BOOL_F;
 
     kwd_specializers = scm_from_utf8_keyword("specializers");
     kwd_formals = scm_from_utf8_keyword("formals");
@@ -899,7 +1352,13 @@ function_free(GigFunction *gfn)
     g_free(gfn->atypes);
     gfn->atypes = NULL;
 
+    if (gfn->has_invoker) {
+        g_function_invoker_destroy(&gfn->invoker);
+        g_base_info_unref(gfn->return_type);
+    }
+
     gig_amap_free(gfn->amap);
+    gig_stats_free(gfn->stats);
 
     g_free(gfn);
 }
@@ -32,5 +32,12 @@ SCM gig_callable_invoke(GICallableInfo *callable_info, gpointer callable, GigArg
                         const gchar *name, GObject *self, SCM args, GError **error);
 void gig_init_function(void);
 
+// Definition batches collect the methods that loading makes, and add
+// them to their generics at once.  A batch must be opened in a dynwind
+// context, and closed before it ends; it is dropped if the context is
+// left through a non-local exit.
+void gig_define_batch_begin(void);
+void gig_define_batch_end(void);
+
 G_END_DECLS
 #endif
@@ -30,5 +30,10 @@ extern SCM kwd_procedure;
 extern SCM sym_self;
 
 SCM default_definition(SCM name);
+SCM gig_function_definition(SCM name);
+SCM gig_function_intern_signature(SCM list);
+void gig_function_add_method(SCM generic, SCM method);
+void gig_function_flush_generic(SCM generic);
+void gig_function_define_generic(SCM name, SCM generic);
 
 #endif
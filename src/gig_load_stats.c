@@ -0,0 +1,198 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include <libguile.h>
+#include "gig_load_stats.h"
+#include "gig_stats.h"
+
+// Info types are counted separately up to the last one that exists.
+#define GIG_LOAD_STATS_TYPES (GI_INFO_TYPE_UNRESOLVED + 1)
+
+typedef struct _GigLoadStats
+{
+    guint64 infos;
+    guint64 total_ns;
+    guint64 counters[GIG_LOAD_N_COUNTERS];
+} GigLoadStats;
+
+gboolean gig_load_stats_enabled = FALSE;
+
+// The counters of each namespace, as an array indexed by info type.
+G_LOCK_DEFINE_STATIC(load_stats);
+static GHashTable *load_stats = NULL;
+
+// The innermost info being loaded by this thread.
+static GPrivate current_frame;
+
+static const gchar *counter_names[] = {
+    [GIG_LOAD_CLASSES] = "classes",
+    [GIG_LOAD_GENERICS] = "generics",
+    [GIG_LOAD_METHODS] = "methods",
+    [GIG_LOAD_CLOSURES] = "closures",
+    [GIG_LOAD_BYTES] = "bytes"
+};
+
+// Returns the counters of FRAME, to be changed while the lock is held.
+static GigLoadStats *
+frame_stats(GigLoadFrame *frame)
+{
+    GigLoadStats *stats;
+
+    if (load_stats == NULL)
+        load_stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    stats = g_hash_table_lookup(load_stats, frame->_namespace);
+    if (stats == NULL) {
+        stats = g_new0(GigLoadStats, GIG_LOAD_STATS_TYPES);
+        g_hash_table_insert(load_stats, g_strdup(frame->_namespace), stats);
+    }
+    return &stats[MIN(frame->type, GIG_LOAD_STATS_TYPES - 1)];
+}
+
+void
+gig_load_stats_begin(GigLoadFrame *frame, GIBaseInfo *info)
+{
+    frame->parent = g_private_get(&current_frame);
+    frame->_namespace = g_base_info_get_namespace(info);
+    frame->type = g_base_info_get_type(info);
+    frame->nested_ns = 0;
+    frame->start = gig_stats_clock();
+    g_private_set(&current_frame, frame);
+}
+
+// Adds the time FRAME took, less what its nested frames took, to its
+// counters.  It is also called when loading is left through a
+// non-local exit.
+void
+gig_load_stats_end(GigLoadFrame *frame)
+{
+    gint64 elapsed = gig_stats_clock() - frame->start;
+
+    G_LOCK(load_stats);
+    GigLoadStats *stats = frame_stats(frame);
+    stats->infos++;
+    stats->total_ns += MAX(elapsed - frame->nested_ns, 0);
+    G_UNLOCK(load_stats);
+
+    if (frame->parent != NULL)
+        frame->parent->nested_ns += elapsed;
+    g_private_set(&current_frame, frame->parent);
+}
+
+void
+gig_load_stats_add(GigLoadCounter counter, guint n)
+{
+    GigLoadFrame *frame = g_private_get(&current_frame);
+
+    // What is made outside of loading, such as the classes of types
+    // that are first seen in an argument, is not counted.
+    if (frame == NULL)
+        return;
+    G_LOCK(load_stats);
+    frame_stats(frame)->counters[counter] += n;
+    G_UNLOCK(load_stats);
+}
+
+static SCM
+scm_load_stats_enable_x(void)
+{
+    gig_load_stats_enabled = TRUE;
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_load_stats_disable_x(void)
+{
+    gig_load_stats_enabled = FALSE;
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_load_stats_enabled_p(void)
+{
+    return scm_from_bool(gig_load_stats_enabled);
+}
+
+static SCM
+scm_load_stats_reset_x(void)
+{
+    G_LOCK(load_stats);
+    if (load_stats != NULL)
+        g_hash_table_remove_all(load_stats);
+    G_UNLOCK(load_stats);
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+load_stats_to_scm(const gchar *_namespace, GIInfoType type, const GigLoadStats *stats)
+{
+    SCM entry = SCM_EOL;
+
+    for (gint i = GIG_LOAD_N_COUNTERS - 1; i >= 0; i--)
+        entry = scm_acons(scm_from_utf8_symbol(counter_names[i]),
+                          scm_from_uint64(stats->counters[i]), entry);
+    entry = scm_acons(scm_from_utf8_symbol("total-time"), scm_from_uint64(stats->total_ns),
+                      entry);
+    entry = scm_acons(scm_from_utf8_symbol("infos"), scm_from_uint64(stats->infos), entry);
+    entry = scm_acons(scm_from_utf8_symbol("info-type"),
+                      scm_from_utf8_symbol(g_info_type_to_string(type)), entry);
+    return scm_acons(scm_from_utf8_symbol("typelib"), scm_from_utf8_string(_namespace), entry);
+}
+
+// Returns a list with one alist for each namespace and info type of
+// which infos were loaded since the last reset.
+static SCM
+scm_load_stats_snapshot(void)
+{
+    GHashTable *copies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    GHashTableIter iter;
+    gpointer key, value;
+    SCM output = SCM_EOL;
+
+    // Copy the counters out so that no Scheme allocation happens while
+    // the lock is held.
+    G_LOCK(load_stats);
+    if (load_stats != NULL) {
+        g_hash_table_iter_init(&iter, load_stats);
+        while (g_hash_table_iter_next(&iter, &key, &value))
+            g_hash_table_insert(copies, g_strdup(key),
+                                g_memdup(value, GIG_LOAD_STATS_TYPES * sizeof(GigLoadStats)));
+    }
+    G_UNLOCK(load_stats);
+
+    g_hash_table_iter_init(&iter, copies);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GigLoadStats *stats = value;
+        for (gint type = 0; type < GIG_LOAD_STATS_TYPES; type++)
+            if (stats[type].infos > 0)
+                output = scm_cons(load_stats_to_scm(key, type, &stats[type]), output);
+    }
+    g_hash_table_unref(copies);
+    return output;
+}
+
+void
+gig_init_load_stats(void)
+{
+    const gchar *enabled = g_getenv("GIG_LOAD_STATS");
+    if (enabled != NULL && enabled[0] != '\0')
+        gig_load_stats_enabled = TRUE;
+
+    scm_c_define_gsubr("load-stats-enable!", 0, 0, 0, scm_load_stats_enable_x);
+    scm_c_define_gsubr("load-stats-disable!", 0, 0, 0, scm_load_stats_disable_x);
+    scm_c_define_gsubr("load-stats-enabled?", 0, 0, 0, scm_load_stats_enabled_p);
+    scm_c_define_gsubr("load-stats-reset!", 0, 0, 0, scm_load_stats_reset_x);
+    scm_c_define_gsubr("load-stats-snapshot", 0, 0, 0, scm_load_stats_snapshot);
+}
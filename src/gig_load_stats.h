@@ -0,0 +1,65 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GIG_LOAD_STATS_H
+#define GIG_LOAD_STATS_H
+
+#include <glib.h>
+#include <girepository.h>
+
+// *INDENT-OFF*
+G_BEGIN_DECLS
+// *INDENT-ON*
+
+// Load statistics attribute the time spent loading infos, and what
+// was made for them, to the namespace and type of the info being
+// loaded.  Loading an info that loads nested infos only counts what
+// the nested infos did not.  Bytes are counted where Guile-GI
+// allocates its own native memory, so allocations by Guile, GLib or
+// the GI repository are not included.
+
+typedef enum _GigLoadCounter
+{
+    GIG_LOAD_CLASSES,
+    GIG_LOAD_GENERICS,
+    GIG_LOAD_METHODS,
+    GIG_LOAD_CLOSURES,
+    GIG_LOAD_BYTES,
+    GIG_LOAD_N_COUNTERS
+} GigLoadCounter;
+
+// The load of one info, which lives on the stack of load_info.
+typedef struct _GigLoadFrame
+{
+    struct _GigLoadFrame *parent;
+    const gchar *_namespace;
+    GIInfoType type;
+    gint64 start;
+    gint64 nested_ns;
+} GigLoadFrame;
+
+extern gboolean gig_load_stats_enabled;
+
+void gig_load_stats_begin(GigLoadFrame *frame, GIBaseInfo *info);
+void gig_load_stats_end(GigLoadFrame *frame);
+void gig_load_stats_add(GigLoadCounter counter, guint n);
+void gig_init_load_stats(void);
+
+// Counts N of COUNTER for the info being loaded, if any.
+#define gig_load_stats_count(counter, n) \
+    do { if (G_UNLIKELY(gig_load_stats_enabled)) gig_load_stats_add(counter, n); } while (0)
+
+G_END_DECLS
+#endif
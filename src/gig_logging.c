@@ -21,6 +21,26 @@
 
 _Thread_local int logger_initialized = 0;
 
+// Until the environment has been parsed, every topic looks enabled,
+// so that the first check of each topic parses it.
+guint gig_debug_flags = G_MAXUINT;
+
+static const struct
+{
+    const gchar *name;
+    GigDebugFlags flag;
+} debug_topics[] = {
+    {"amap", GIG_DEBUG_AMAP},
+    {"load", GIG_DEBUG_LOAD},
+    {"transfers", GIG_DEBUG_TRANSFERS}
+};
+
+// The values of G_MESSAGES_DEBUG and GIG_DEBUG, as of the last
+// refresh.
+G_LOCK_DEFINE_STATIC(debug_env);
+static gchar *env_messages_debug = NULL;
+static gchar *env_gig_debug = NULL;
+
 static const GLogField *
 field_ref(const gchar *needle, const GLogField *fields, gsize n_fields)
 {
@@ -44,13 +64,59 @@ is_enabled(const GLogField *domain, const gchar *domains, gboolean allow_empty)
     return FALSE;
 }
 
+// Reads G_MESSAGES_DEBUG and GIG_DEBUG and recomputes the enabled
+// debug topics.
+void
+gig_debug_refresh(void)
+{
+    const gchar *messages_debug = g_getenv("G_MESSAGES_DEBUG");
+    const gchar *gig_debug = g_getenv("GIG_DEBUG");
+    guint flags = 0;
+
+    if (messages_debug != NULL
+        && (!strcmp(messages_debug, "all") || strstr(messages_debug, G_LOG_DOMAIN))) {
+        flags |= GIG_DEBUG_CALLS;
+        if (gig_debug != NULL)
+            for (gsize i = 0; i < G_N_ELEMENTS(debug_topics); i++)
+                if (!strcmp(gig_debug, "all") || strstr(gig_debug, debug_topics[i].name))
+                    flags |= debug_topics[i].flag;
+    }
+
+    G_LOCK(debug_env);
+    g_free(env_messages_debug);
+    g_free(env_gig_debug);
+    env_messages_debug = g_strdup(messages_debug);
+    env_gig_debug = g_strdup(gig_debug);
+    gig_debug_flags = flags;
+    G_UNLOCK(debug_env);
+}
+
+// The journal and custom loggers do their own filtering, so they get
+// messages of all topics.
+static void
+debug_enable_all(void)
+{
+    gig_debug_check(0);
+    gig_debug_flags = GIG_DEBUG_CALLS | GIG_DEBUG_AMAP | GIG_DEBUG_LOAD | GIG_DEBUG_TRANSFERS;
+}
+
+// Returns TRUE if the debug topic FLAG is enabled.
+gboolean
+gig_debug_check(guint flag)
+{
+    if (G_UNLIKELY(gig_debug_flags & GIG_DEBUG_UNPARSED))
+        gig_debug_refresh();
+    return (gig_debug_flags & flag) != 0;
+}
+
 static GLogWriterOutput
 gig_log_writer(GLogLevelFlags flags, const GLogField *fields, gsize n_fields, gpointer user_data)
 {
 #define LOG_FIELD(f) field_ref(f, fields, n_fields)
-#define ENV_MESSAGES_DEBUG (g_getenv("G_MESSAGES_DEBUG"))
-#define ENV_GIG_DEBUG (g_getenv("GIG_DEBUG"))
+#define ENV_MESSAGES_DEBUG env_messages_debug
+#define ENV_GIG_DEBUG env_gig_debug
     const GLogField *message;
+    gboolean enabled;
 
     const gchar *prefix = NULL, *color = NULL;
     if (!logger_initialized) {
@@ -76,15 +142,23 @@ gig_log_writer(GLogLevelFlags flags, const GLogField *fields, gsize n_fields, gp
         break;
     case G_LOG_LEVEL_INFO:
         color = "\033[1;32m%s\033[0m";
-        if (!is_enabled(LOG_FIELD("GLIB_DOMAIN"), ENV_MESSAGES_DEBUG, FALSE)
-            || !is_enabled(LOG_FIELD("GIG_DOMAIN"), ENV_GIG_DEBUG, TRUE))
+        gig_debug_check(0);
+        G_LOCK(debug_env);
+        enabled = (is_enabled(LOG_FIELD("GLIB_DOMAIN"), ENV_MESSAGES_DEBUG, FALSE)
+                   && is_enabled(LOG_FIELD("GIG_DOMAIN"), ENV_GIG_DEBUG, TRUE));
+        G_UNLOCK(debug_env);
+        if (!enabled)
             return G_LOG_WRITER_HANDLED;
         prefix = "INFO";
         break;
     case G_LOG_LEVEL_DEBUG:
         color = "\033[1;32m%s\033[0m";
-        if (!is_enabled(LOG_FIELD("GLIB_DOMAIN"), ENV_MESSAGES_DEBUG, FALSE)
-            || !is_enabled(LOG_FIELD("GIG_DOMAIN"), ENV_GIG_DEBUG, TRUE))
+        gig_debug_check(0);
+        G_LOCK(debug_env);
+        enabled = (is_enabled(LOG_FIELD("GLIB_DOMAIN"), ENV_MESSAGES_DEBUG, FALSE)
+                   && is_enabled(LOG_FIELD("GIG_DOMAIN"), ENV_GIG_DEBUG, TRUE));
+        G_UNLOCK(debug_env);
+        if (!enabled)
             return G_LOG_WRITER_HANDLED;
         prefix = "DEBUG";
         break;
@@ -124,6 +198,7 @@ gig_log_to_port(SCM port)
     SCM_ASSERT_TYPE(SCM_OPOUTPORTP(port), port, SCM_ARG1, "install-port-logger!",
                     "open output port");
     g_log_set_writer_func(gig_log_writer, SCM_UNPACK_POINTER(port), NULL);
+    gig_debug_refresh();
     return SCM_UNSPECIFIED;
 }
 
@@ -131,6 +206,7 @@ SCM
 gig_log_to_journal(void)
 {
     g_log_set_writer_func(g_log_writer_journald, NULL, NULL);
+    debug_enable_all();
     return SCM_UNSPECIFIED;
 }
 
@@ -195,13 +271,37 @@ gig_install_custom_logger(SCM func)
 {
     func = scm_gc_protect_object(func);
     g_log_set_writer_func(gig_log_custom_helper, SCM_UNPACK_POINTER(func), gig_unprotect_func);
+    debug_enable_all();
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_refresh_debug_topics_x(void)
+{
+    gig_debug_refresh();
     return SCM_UNSPECIFIED;
 }
 
+static SCM
+scm_debug_topics(void)
+{
+    SCM topics = SCM_EOL;
+
+    gig_debug_check(0);
+    for (gsize i = G_N_ELEMENTS(debug_topics); i > 0; i--)
+        if (gig_debug_flags & debug_topics[i - 1].flag)
+            topics = scm_cons(scm_from_utf8_symbol(debug_topics[i - 1].name), topics);
+    if (gig_debug_flags & GIG_DEBUG_CALLS)
+        topics = scm_cons(scm_from_utf8_symbol("calls"), topics);
+    return topics;
+}
+
 void
 gig_init_logging()
 {
     kwd_log_level = scm_from_utf8_keyword("log-level");
+    scm_c_define_gsubr("refresh-debug-topics!", 0, 0, 0, scm_refresh_debug_topics_x);
+    scm_c_define_gsubr("debug-topics", 0, 0, 0, scm_debug_topics);
     scm_c_define_gsubr("install-port-logger!", 1, 0, 0, gig_log_to_port);
     scm_c_define_gsubr("install-journal-logger!", 0, 0, 0, gig_log_to_journal);
     scm_c_define_gsubr("install-custom-logger!", 1, 0, 0, gig_install_custom_logger);
@@ -15,21 +15,57 @@
 
 #include <string.h>
 #include "gig_object.h"
+#include "gig_callback.h"
 #include "gig_type.h"
 #include "gig_util.h"
 #include "gig_signal.h"
 #include "gig_closure.h"
+#include "gig_load_stats.h"
 #include "gig_value.h"
+#include "gig_stats.h"
+#include "gig_trace.h"
+#include "gig_function.h"
 #include "gig_function_private.h"
 
-GQuark gig_user_object_properties;
+typedef struct _GigUserObjectInitInfo GigUserObjectInitInfo;
 
-typedef struct _GigUserObjectInitInfo
+// A virtual function of an ancestor that a user type overrides.
+typedef struct _GigVFuncOverride
+{
+    GIVFuncInfo *info;
+    // Where the function pointer is in the class struct.
+    gint offset;
+    gpointer func;
+    // The implementation that the type would have inherited, which
+    // chain-up calls, and how to call it.  It is NULL until the class
+    // is initialized, or if the parent has none.
+    gpointer parent_func;
+    GigArgMap *amap;
+} GigVFuncOverride;
+
+struct _GigUserObjectInitInfo
 {
     GType type;
     GPtrArray *properties;
     GPtrArray *signals;
-} GigUserObjectInitInfo;
+    GArray *vfuncs;
+    // The property values of an instance are stored in its private
+    // area, in the order of their property ids.
+    gint private_offset;
+    // The default values of the properties, which are copied into new
+    // instances as one block.  The values listed in DEEP_COPIES hold
+    // data of their own, and are copied one by one afterwards.
+    GValue *defaults;
+    guint *deep_copies;
+    guint n_deep_copies;
+    // The user type this one derives from, if any.
+    GigUserObjectInitInfo *parent_info;
+    // The nearest ancestor class that is not a user type, to which
+    // dispose and finalize chain up.
+    GObjectClass *native_parent_class;
+};
+
+static GQuark gig_user_object_info_quark;
 
 static SCM
 gig_object_take(GObject *object)
@@ -56,72 +92,6 @@ gig_paramspec_peek(SCM object)
     return gig_type_peek_typed_object(object, gig_paramspec_type);
 }
 
-static SCM
-gig_i_scm_make_gobject(SCM s_gtype, SCM s_prop_keylist)
-{
-#define FUNC "%make-gobject"
-    GType type;
-    GObject *obj;
-    GObjectClass *_class;
-    gsize n_prop;
-    const gchar **keys;
-    GValue *values;
-
-    type = scm_to_gtype(s_gtype);
-
-    SCM_ASSERT_TYPE(G_TYPE_IS_CLASSED(type), s_gtype, SCM_ARG1, FUNC,
-                    "typeid derived from G_TYPE_OBJECT or scheme type derived from <GObject>");
-
-    if (SCM_UNBNDP(gig_type_get_scheme_type(type)))
-        scm_misc_error(FUNC, "type ~S lacks introspection", scm_list_1(s_gtype));
-
-    scm_dynwind_begin(0);
-
-    if (scm_is_list(s_prop_keylist) && (scm_c_length(s_prop_keylist) != 0)) {
-        _class = g_type_class_ref(type);
-        scm_dynwind_unwind_handler(g_type_class_unref, _class, SCM_F_WIND_EXPLICITLY);
-
-        n_prop = scm_c_length(s_prop_keylist) / 2;
-        keys = scm_dynwind_or_bust(FUNC, calloc(n_prop, sizeof(char *)));
-        values = scm_dynwind_or_bust(FUNC, calloc(n_prop, sizeof(GValue)));
-
-        SCM iter = s_prop_keylist;
-        for (gsize i = 0; i < n_prop; i++, iter = scm_cddr(iter)) {
-            SCM key = scm_car(iter);
-            SCM s_value = scm_cadr(iter);
-
-            SCM_ASSERT_TYPE(scm_is_true(scm_keyword_p(key)), key, SCM_ARGn, FUNC, "keyword");
-
-            key = scm_symbol_to_string(scm_keyword_to_symbol(key));
-
-            keys[i] = scm_dynwind_or_bust(FUNC, scm_to_utf8_string(key));
-            GParamSpec *pspec = g_object_class_find_property(_class, keys[i]);
-            if (!pspec) {
-                scm_misc_error(FUNC, "unknown object parameter ~S", scm_list_1(key));
-            }
-            else {
-                GValue *value = &values[i];
-                g_value_init(value, G_PARAM_SPEC_VALUE_TYPE(pspec));
-                if (gig_value_from_scm(value, s_value))
-                    scm_misc_error(FUNC, "unable to convert parameter ~S", scm_list_1(s_value));
-            }
-        }
-    }
-    else {
-        n_prop = 0;
-        keys = NULL;
-        values = NULL;
-    }
-
-    obj = g_object_new_with_properties(type, n_prop, keys, values);
-    scm_dynwind_end();
-
-    g_assert(obj);
-
-    return gig_object_take(obj);
-#undef FUNC
-}
-
 static GParamSpec *
 get_paramspec(const GObject *self, const gchar *prop)
 {
@@ -152,6 +122,106 @@ gig_i_scm_get_pspec(SCM self, SCM prop)
     return gig_type_transfer_object(G_PARAM_SPEC_TYPE(pspec), pspec, GI_TRANSFER_NOTHING);
 }
 
+// What property access needs to know about a GParamSpec, worked out
+// once and kept as its qdata.
+typedef struct _GigPropertyPlan
+{
+    GType fundamental;
+    // Whether the property belongs to a class, rather than to an
+    // interface, so that it can be read without looking it up by name
+    // from instances of that class.
+    guint is_class_property:1;
+    guint is_unichar:1;
+} GigPropertyPlan;
+
+static GQuark gig_property_plan_quark;
+G_LOCK_DEFINE_STATIC(property_plan);
+
+// Returns the plan of PSPEC.
+static GigPropertyPlan *
+property_plan(GParamSpec *pspec)
+{
+    GigPropertyPlan *plan = g_param_spec_get_qdata(pspec, gig_property_plan_quark);
+    if (G_LIKELY(plan != NULL))
+        return plan;
+
+    G_LOCK(property_plan);
+    plan = g_param_spec_get_qdata(pspec, gig_property_plan_quark);
+    if (plan == NULL) {
+        plan = g_new0(GigPropertyPlan, 1);
+        plan->fundamental = G_TYPE_FUNDAMENTAL(G_PARAM_SPEC_VALUE_TYPE(pspec));
+        plan->is_unichar = G_IS_PARAM_SPEC_UNICHAR(pspec);
+        plan->is_class_property = G_TYPE_IS_OBJECT(pspec->owner_type);
+        g_param_spec_set_qdata_full(pspec, gig_property_plan_quark, plan, g_free);
+    }
+    G_UNLOCK(property_plan);
+    return plan;
+}
+
+static void
+property_get(GObject *obj, GParamSpec *pspec, GigPropertyPlan *plan, GValue *value)
+{
+    // This is what g_object_get_property does once it has found the
+    // property.  A subclass may override the property, so instances of
+    // other classes than its owner look it up by name.
+    if (plan->is_class_property && G_OBJECT_TYPE(obj) == pspec->owner_type)
+        G_OBJECT_GET_CLASS(obj)->get_property(obj, pspec->param_id, value, pspec);
+    else
+        g_object_get_property(obj, pspec->name, value);
+}
+
+static SCM
+property_value_as_scm(const GValue *value, GigPropertyPlan *plan)
+{
+    gboolean handled;
+    SCM ret;
+
+    if (plan->is_unichar)
+        return SCM_MAKE_CHAR(g_value_get_uint(value));
+
+    ret = gig_value_to_scm_basic_type(value, plan->fundamental, &handled);
+    if (!handled)
+        ret = gig_value_as_scm(value, TRUE);
+    return ret;
+}
+
+// Returns the GParamSpec that PROPERTY, a <GParam>, a symbol, a
+// keyword or a string, names for OBJ.  Any of its flags in REQUIRED
+// must be set.
+static GParamSpec *
+resolve_property(SCM self, GObject *obj, SCM property, GParamFlags required, const gchar *subr,
+                 gint pos)
+{
+    GParamSpec *pspec;
+
+    if (SCM_IS_A_P(property, gig_paramspec_type)) {
+        pspec = gig_paramspec_peek(property);
+        if (pspec != NULL && !g_type_is_a(G_OBJECT_TYPE(obj), pspec->owner_type))
+            pspec = NULL;
+    }
+    else {
+        SCM name = property;
+        if (scm_is_keyword(name))
+            name = scm_keyword_to_symbol(name);
+        if (scm_is_symbol(name))
+            name = scm_symbol_to_string(name);
+        SCM_ASSERT_TYPE(scm_is_string(name), property, pos, subr, "property name");
+
+        gchar *c_name = scm_to_utf8_string(name);
+        pspec = get_paramspec(obj, c_name);
+        free(c_name);
+    }
+
+    if (!pspec)
+        scm_misc_error(subr, "object of type ~A does not have a property ~A",
+                       scm_list_2(SCM_CLASS_OF(self), property));
+    if ((required & G_PARAM_READABLE) && !(pspec->flags & G_PARAM_READABLE))
+        scm_misc_error(subr, "property ~A is not readable", scm_list_1(property));
+    if ((required & G_PARAM_WRITABLE) && !(pspec->flags & G_PARAM_WRITABLE))
+        scm_misc_error(subr, "property ~A is not writable", scm_list_1(property));
+    return pspec;
+}
+
 static SCM
 gig_i_scm_get_property(SCM self, SCM property)
 {
@@ -162,22 +232,16 @@ gig_i_scm_get_property(SCM self, SCM property)
 
     GValue value = { 0, };
 
-    SCM_ASSERT(SCM_IS_A_P(self, gig_object_type), self, SCM_ARG1, "%get-property");
+    SCM_ASSERT(gig_type_check_typed_object(self, gig_object_type), self, SCM_ARG1,
+               "%get-property");
     SCM_ASSERT(SCM_IS_A_P(property, gig_paramspec_type), property, SCM_ARG2, "%get-property");
     obj = gig_object_peek(self);
-    pspec = gig_paramspec_peek(property);
-    if (!pspec || pspec != get_paramspec(obj, pspec->name)) {
-        scm_misc_error("%get-property",
-                       "object of type ~A does not have a property ~A",
-                       scm_list_2(SCM_CLASS_OF(self), property));
-    }
-    if (!(pspec->flags & G_PARAM_READABLE)) {
-        scm_misc_error("%get-property", "property ~A is not readable", scm_list_1(property));
-    }
+    pspec = resolve_property(self, obj, property, G_PARAM_READABLE, "%get-property", SCM_ARG2);
+    GigPropertyPlan *plan = property_plan(pspec);
 
     g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
-    g_object_get_property(obj, pspec->name, &value);
-    ret = gig_value_param_as_scm(&value, TRUE, pspec);
+    property_get(obj, pspec, plan, &value);
+    ret = property_value_as_scm(&value, plan);
     g_value_unset(&value);
 
     return ret;
@@ -191,27 +255,306 @@ gig_i_scm_set_property_x(SCM self, SCM property, SCM svalue)
 
     GValue value = { 0, };
 
-    SCM_ASSERT(SCM_IS_A_P(self, gig_object_type), self, SCM_ARG1, "%set-property!");
+    SCM_ASSERT(gig_type_check_typed_object(self, gig_object_type), self, SCM_ARG1,
+               "%set-property!");
     SCM_ASSERT(SCM_IS_A_P(property, gig_paramspec_type), property, SCM_ARG2, "%set-property");
 
     obj = gig_object_peek(self);
-    pspec = gig_paramspec_peek(property);
-    if (!pspec || pspec != get_paramspec(obj, pspec->name)) {
-        scm_misc_error("%set-property!",
-                       "object of type ~A does not have a property ~A",
-                       scm_list_2(SCM_CLASS_OF(self), property));
-    }
-    if (!(pspec->flags & G_PARAM_WRITABLE)) {
-        scm_misc_error("%set-property!", "property ~A is not writable", scm_list_1(property));
-    }
+    pspec = resolve_property(self, obj, property, G_PARAM_WRITABLE, "%set-property!", SCM_ARG2);
 
+    // Setting still goes by name, so that GObject can validate the
+    // value and emit notifications.
     g_value_init(&value, G_PARAM_SPEC_VALUE_TYPE(pspec));
     gig_value_from_scm_with_error(&value, svalue, "%set-property!", SCM_ARG3);
     g_object_set_property(obj, pspec->name, &value);
+    g_value_unset(&value);
 
     return SCM_UNSPECIFIED;
 }
 
+static void
+unset_values(GArray *values)
+{
+    for (guint i = 0; i < values->len; i++) {
+        GValue *value = &g_array_index(values, GValue, i);
+        if (G_IS_VALUE(value))
+            g_value_unset(value);
+    }
+    g_array_free(values, TRUE);
+}
+
+// Returns a list of the values of the properties PROPS of SELF, which
+// are read in one call.
+static SCM
+gig_i_scm_get_properties(SCM self, SCM props)
+{
+#define FUNC "get-properties"
+    SCM_ASSERT(gig_type_check_typed_object(self, gig_object_type), self, SCM_ARG1, FUNC);
+    GObject *obj = gig_object_peek(self);
+    gsize n_props = scm_c_length(props);
+    const gchar **names = g_alloca(sizeof(gchar *) * MAX(n_props, 1));
+    GigPropertyPlan **plans = g_alloca(sizeof(GigPropertyPlan *) * MAX(n_props, 1));
+    GArray *values = g_array_sized_new(FALSE, TRUE, sizeof(GValue), n_props);
+    SCM ret = SCM_EOL;
+
+    scm_dynwind_begin(0);
+    g_array_set_size(values, n_props);
+    scm_dynwind_unwind_handler((void (*)(void *))unset_values, values, SCM_F_WIND_EXPLICITLY);
+
+    SCM iter = props;
+    for (gsize i = 0; i < n_props; i++, iter = scm_cdr(iter)) {
+        GParamSpec *pspec = resolve_property(self, obj, scm_car(iter), G_PARAM_READABLE, FUNC,
+                                             SCM_ARG2 + i);
+        names[i] = pspec->name;
+        plans[i] = property_plan(pspec);
+        g_value_init(&g_array_index(values, GValue, i), G_PARAM_SPEC_VALUE_TYPE(pspec));
+    }
+
+#if GLIB_CHECK_VERSION(2, 54, 0)
+    g_object_getv(obj, n_props, names, (GValue *)values->data);
+#else
+    for (gsize i = 0; i < n_props; i++)
+        g_object_get_property(obj, names[i], &g_array_index(values, GValue, i));
+#endif
+
+    for (gsize i = n_props; i > 0; i--)
+        ret = scm_cons(property_value_as_scm(&g_array_index(values, GValue, i - 1), plans[i - 1]),
+                       ret);
+    scm_dynwind_end();
+    return ret;
+#undef FUNC
+}
+
+// Sets the properties of SELF from PROPS, a list of alternating
+// property names and values, in one call.  Notifications are held
+// back until all of them are set.
+static SCM
+gig_i_scm_set_properties_x(SCM self, SCM props)
+{
+#define FUNC "set-properties!"
+    SCM_ASSERT(gig_type_check_typed_object(self, gig_object_type), self, SCM_ARG1, FUNC);
+    GObject *obj = gig_object_peek(self);
+    gsize len = scm_c_length(props);
+    if (len % 2 != 0)
+        scm_misc_error(FUNC, "expected property names and values in pairs, got ~S",
+                       scm_list_1(props));
+    gsize n_props = len / 2;
+    const gchar **names = g_alloca(sizeof(gchar *) * MAX(n_props, 1));
+    GArray *values = g_array_sized_new(FALSE, TRUE, sizeof(GValue), n_props);
+
+    scm_dynwind_begin(0);
+    g_array_set_size(values, n_props);
+    scm_dynwind_unwind_handler((void (*)(void *))unset_values, values, SCM_F_WIND_EXPLICITLY);
+
+    SCM iter = props;
+    for (gsize i = 0; i < n_props; i++, iter = scm_cddr(iter)) {
+        GParamSpec *pspec = resolve_property(self, obj, scm_car(iter), G_PARAM_WRITABLE, FUNC,
+                                             SCM_ARG2 + 2 * i);
+        GValue *value = &g_array_index(values, GValue, i);
+        names[i] = pspec->name;
+        g_value_init(value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+        gig_value_from_scm_with_error(value, scm_cadr(iter), FUNC, SCM_ARG3 + 2 * i);
+    }
+
+#if GLIB_CHECK_VERSION(2, 54, 0)
+    g_object_setv(obj, n_props, names, (const GValue *)values->data);
+#else
+    g_object_freeze_notify(obj);
+    for (gsize i = 0; i < n_props; i++)
+        g_object_set_property(obj, names[i], &g_array_index(values, GValue, i));
+    g_object_thaw_notify(obj);
+#endif
+
+    scm_dynwind_end();
+    return SCM_UNSPECIFIED;
+#undef FUNC
+}
+
+// A constructor plan holds what creating objects of one type needs:
+// the properties that property keywords name, resolved once.  Each
+// type has one plan, which is kept as type qdata and never freed.  It
+// only grows to the number of properties of the type.
+typedef struct _GigConstructorPlan
+{
+    GRWLock lock;
+    // Maps keywords to the GParamSpecs of the properties they name.
+    // The keywords are protected from collection, so that their cells
+    // are not reused.
+    GHashTable *pspecs;
+} GigConstructorPlan;
+
+static GQuark gig_constructor_plan_quark;
+G_LOCK_DEFINE_STATIC(constructor_plan);
+
+static GigConstructorPlan *
+constructor_plan(GType type)
+{
+    GigConstructorPlan *plan = g_type_get_qdata(type, gig_constructor_plan_quark);
+    if (G_LIKELY(plan != NULL))
+        return plan;
+
+    G_LOCK(constructor_plan);
+    plan = g_type_get_qdata(type, gig_constructor_plan_quark);
+    if (plan == NULL) {
+        plan = g_new0(GigConstructorPlan, 1);
+        g_rw_lock_init(&plan->lock);
+        plan->pspecs = g_hash_table_new(NULL, NULL);
+        // The class reference is kept, since the plan holds the
+        // properties of the class.
+        g_type_class_ref(type);
+        g_type_set_qdata(type, gig_constructor_plan_quark, plan);
+    }
+    G_UNLOCK(constructor_plan);
+    return plan;
+}
+
+// Returns the property of TYPE that KEY names.  PLAN is the plan of
+// TYPE.
+static GParamSpec *
+constructor_plan_pspec(GigConstructorPlan *plan, GType type, SCM key, const gchar *subr)
+{
+    GParamSpec *pspec;
+    gboolean added = FALSE;
+
+    g_rw_lock_reader_lock(&plan->lock);
+    pspec = g_hash_table_lookup(plan->pspecs, SCM_UNPACK_POINTER(key));
+    g_rw_lock_reader_unlock(&plan->lock);
+    if (G_LIKELY(pspec != NULL))
+        return pspec;
+
+    SCM_ASSERT_TYPE(scm_is_keyword(key), key, SCM_ARGn, subr, "keyword");
+    SCM name = scm_symbol_to_string(scm_keyword_to_symbol(key));
+    gchar *c_name = scm_to_utf8_string(name);
+    pspec = g_object_class_find_property(g_type_class_peek(type), c_name);
+    free(c_name);
+    if (!pspec)
+        scm_misc_error(subr, "unknown object parameter ~S", scm_list_1(name));
+
+    g_rw_lock_writer_lock(&plan->lock);
+    if (!g_hash_table_contains(plan->pspecs, SCM_UNPACK_POINTER(key))) {
+        g_hash_table_insert(plan->pspecs, SCM_UNPACK_POINTER(key), pspec);
+        added = TRUE;
+    }
+    g_rw_lock_writer_unlock(&plan->lock);
+    if (added)
+        scm_gc_protect_object(key);
+    return pspec;
+}
+
+// Creates an object of TYPE.  ARGS holds N_ARGS alternating property
+// keywords and values; PROPS is what they were taken from.
+static GObject *
+construct_object(GType type, SCM props, const SCM *args, gsize n_args, const gchar *subr)
+{
+    if (n_args % 2 != 0)
+        scm_misc_error(subr, "expected property names and values in pairs, got ~S",
+                       scm_list_1(props));
+
+    gsize n_props = n_args / 2;
+    if (n_props == 0)
+        return g_object_new_with_properties(type, 0, NULL, NULL);
+
+    GigConstructorPlan *plan = constructor_plan(type);
+    const gchar **names = g_alloca(sizeof(gchar *) * n_props);
+    GArray *values = g_array_sized_new(FALSE, TRUE, sizeof(GValue), n_props);
+    GObject *obj;
+
+    scm_dynwind_begin(0);
+    g_array_set_size(values, n_props);
+    scm_dynwind_unwind_handler((void (*)(void *))unset_values, values, SCM_F_WIND_EXPLICITLY);
+
+    for (gsize i = 0; i < n_props; i++) {
+        GParamSpec *pspec = constructor_plan_pspec(plan, type, args[2 * i], subr);
+        GValue *value = &g_array_index(values, GValue, i);
+        SCM s_value = args[2 * i + 1];
+
+        names[i] = pspec->name;
+        g_value_init(value, G_PARAM_SPEC_VALUE_TYPE(pspec));
+        if (gig_value_from_scm(value, s_value))
+            scm_misc_error(subr, "unable to convert parameter ~S", scm_list_1(s_value));
+    }
+
+    obj = g_object_new_with_properties(type, n_props, names, (GValue *)values->data);
+    scm_dynwind_end();
+
+    g_assert(obj);
+    return obj;
+}
+
+static GType
+constructible_type(SCM s_gtype, const gchar *subr)
+{
+    GType type = scm_to_gtype(s_gtype);
+
+    SCM_ASSERT_TYPE(G_TYPE_IS_CLASSED(type), s_gtype, SCM_ARG1, subr,
+                    "typeid derived from G_TYPE_OBJECT or scheme type derived from <GObject>");
+
+    if (SCM_UNBNDP(gig_type_get_scheme_type(type)))
+        scm_misc_error(subr, "type ~S lacks introspection", scm_list_1(s_gtype));
+    return type;
+}
+
+static SCM
+gig_i_scm_make_gobject(SCM s_gtype, SCM s_prop_keylist)
+{
+#define FUNC "%make-gobject"
+    GType type = constructible_type(s_gtype, FUNC);
+    gsize n_args = 0;
+    SCM *args;
+
+    if (!SCM_UNBNDP(s_prop_keylist) && scm_is_list(s_prop_keylist))
+        n_args = scm_c_length(s_prop_keylist);
+    args = g_alloca(sizeof(SCM) * MAX(n_args, 1));
+
+    SCM iter = s_prop_keylist;
+    for (gsize i = 0; i < n_args; i++, iter = scm_cdr(iter))
+        args[i] = scm_car(iter);
+
+    return gig_object_take(construct_object(type, s_prop_keylist, args, n_args, FUNC));
+#undef FUNC
+}
+
+static void
+free_args(GArray *args)
+{
+    g_array_free(args, TRUE);
+}
+
+// Creates one object of TYPE for each vector in ROWS, which alternates
+// property keywords and values, and returns a vector of the objects.
+// All rows share the constructor plan of TYPE.
+static SCM
+gig_i_scm_make_objects(SCM s_gtype, SCM rows)
+{
+#define FUNC "make-objects"
+    GType type = constructible_type(s_gtype, FUNC);
+    SCM_ASSERT_TYPE(scm_is_vector(rows), rows, SCM_ARG2, FUNC, "vector");
+
+    size_t n_rows = scm_c_vector_length(rows);
+    SCM ret = scm_c_make_vector(n_rows, SCM_BOOL_F);
+    GArray *args = g_array_new(FALSE, FALSE, sizeof(SCM));
+
+    scm_dynwind_begin(0);
+    scm_dynwind_unwind_handler((void (*)(void *))free_args, args, SCM_F_WIND_EXPLICITLY);
+
+    for (size_t i = 0; i < n_rows; i++) {
+        SCM row = scm_c_vector_ref(rows, i);
+        SCM_ASSERT_TYPE(scm_is_vector(row), rows, SCM_ARG2, FUNC, "vector of property vectors");
+
+        size_t n_args = scm_c_vector_length(row);
+        g_array_set_size(args, n_args);
+        for (size_t j = 0; j < n_args; j++)
+            g_array_index(args, SCM, j) = scm_c_vector_ref(row, j);
+
+        GObject *obj = construct_object(type, row, (SCM *)args->data, n_args, FUNC);
+        scm_c_vector_set_x(ret, i, gig_object_take(obj));
+    }
+
+    scm_dynwind_end();
+    return ret;
+#undef FUNC
+}
+
 static void
 make_new_signal(GigSignalSpec *signal_spec, gpointer user_data)
 {
@@ -222,50 +565,53 @@ make_new_signal(GigSignalSpec *signal_spec, gpointer user_data)
                   NULL, signal_spec->return_type, signal_spec->n_params, signal_spec->param_types);
 }
 
+static GigUserObjectInitInfo *
+user_object_info(GType type)
+{
+    return g_type_get_qdata(type, gig_user_object_info_quark);
+}
+
+static GValue *
+user_object_values(gpointer instance, GigUserObjectInitInfo *info)
+{
+    return G_STRUCT_MEMBER_P(instance, info->private_offset);
+}
+
 static void
 gig_user_object_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec)
 {
-    GValue *properties = g_object_get_qdata(object, gig_user_object_properties);
-    GValue *property = properties + property_id - 1;
-    g_value_copy(property, value);
+    GValue *property = user_object_values(object, user_object_info(pspec->owner_type));
+    g_value_copy(property + property_id - 1, value);
 }
 
 static void
 gig_user_object_set_property(GObject *object, guint property_id,
                              const GValue *value, GParamSpec *pspec)
 {
-    GValue *properties = g_object_get_qdata(object, gig_user_object_properties);
-    GValue *property = properties + property_id - 1;
-    g_param_value_convert(pspec, value, property, FALSE);
+    GValue *property = user_object_values(object, user_object_info(pspec->owner_type));
+    g_param_value_convert(pspec, value, property + property_id - 1, FALSE);
 }
 
 static void
 gig_user_object_dispose(GObject *object)
 {
-    GType type, parent_type;
-    gpointer _parent_class;
-    GObjectClass *parent_class;
-
-    type = G_OBJECT_TYPE(object);
-    parent_type = g_type_parent(type);
-
-    g_assert(G_TYPE_IS_CLASSED(type));
-    g_assert(G_TYPE_IS_CLASSED(parent_type));
-
-    g_info("dispose is currently just calling the parent's dispose");
-
-    g_debug("disposing parent type");
-    _parent_class = g_type_class_ref(parent_type);
-    parent_class = G_OBJECT_CLASS(_parent_class);
-
-    parent_class->dispose(object);
-
-    g_type_class_unref(_parent_class);
+    GigUserObjectInitInfo *info = user_object_info(G_OBJECT_TYPE(object));
+    info->native_parent_class->dispose(object);
 }
 
 static void
 gig_user_object_finalize(GObject *object)
 {
+    GigUserObjectInitInfo *info = user_object_info(G_OBJECT_TYPE(object));
+    GObjectClass *native_parent_class = info->native_parent_class;
+
+    for (; info != NULL; info = info->parent_info) {
+        GValue *values = user_object_values(object, info);
+        for (guint i = 0; i < info->properties->len; i++)
+            if (G_IS_VALUE(values + i))
+                g_value_unset(values + i);
+    }
+    native_parent_class->finalize(object);
 }
 
 static void
@@ -281,6 +627,11 @@ gig_user_class_init(GObjectClass *_class, gpointer class_info)
     _class->dispose = gig_user_object_dispose;
     _class->finalize = gig_user_object_finalize;
 
+    if (init_info->parent_info != NULL)
+        init_info->native_parent_class = init_info->parent_info->native_parent_class;
+    else
+        init_info->native_parent_class = g_type_class_peek_parent(_class);
+
     /* Since the parent type could be anything, some pointer math is
      * required to figure out where our part of the object class is
      * located. */
@@ -288,34 +639,61 @@ gig_user_class_init(GObjectClass *_class, gpointer class_info)
 
     for (gsize i = 1; i <= n_properties; i++)
         g_object_class_install_property(_class, i, properties[i - 1]);
+
+    for (guint i = 0; i < init_info->vfuncs->len; i++) {
+        GigVFuncOverride *vfunc = &g_array_index(init_info->vfuncs, GigVFuncOverride, i);
+        // The class struct starts as a copy of the parent's.
+        vfunc->parent_func = G_STRUCT_MEMBER(gpointer, _class, vfunc->offset);
+        G_STRUCT_MEMBER(gpointer, _class, vfunc->offset) = vfunc->func;
+    }
+
+    init_info->defaults = g_new0(GValue, n_properties);
+    init_info->deep_copies = g_new(guint, n_properties);
+    for (guint i = 0; i < n_properties; i++) {
+        GValue *_default = init_info->defaults + i;
+        g_value_init(_default, G_PARAM_SPEC_VALUE_TYPE(properties[i]));
+        g_value_copy(g_param_spec_get_default_value(properties[i]), _default);
+        if (g_value_fits_pointer(_default) && g_value_peek_pointer(_default) != NULL)
+            init_info->deep_copies[init_info->n_deep_copies++] = i;
+    }
 }
 
 static void
-gig_user_object_init(GTypeInstance *instance, gpointer class_ptr)
+user_object_init_values(GTypeInstance *instance, GigUserObjectInitInfo *info)
 {
-    GType type = G_TYPE_FROM_CLASS(class_ptr);
-    GType parent_type = g_type_parent(type);
-    guint n_properties;
-    GParamSpec **properties;
-    GTypeQuery query;
-
-    g_type_query(parent_type, &query);
-    properties = g_object_class_list_properties(class_ptr, &n_properties);
-
-    GValue *instance_properties = g_new0(GValue, n_properties);
-    g_object_set_qdata(G_OBJECT(instance), gig_user_object_properties, instance_properties);
+    guint n_properties = info->properties->len;
+    GValue *values;
 
-    for (guint i = 0; i < n_properties; i++) {
-        const GValue *_default;
-        _default = g_param_spec_get_default_value(properties[i]);
-        g_value_init(instance_properties + i, properties[i]->value_type);
-        g_value_copy(_default, instance_properties + i);
+    if (n_properties == 0)
+        return;
+    values = user_object_values(instance, info);
+    if (G_IS_VALUE(values))
+        return;
+
+    memcpy(values, info->defaults, sizeof(GValue) * n_properties);
+    for (guint i = 0; i < info->n_deep_copies; i++) {
+        GValue *value = values + info->deep_copies[i];
+        memset(value, 0, sizeof(GValue));
+        g_value_init(value, G_VALUE_TYPE(info->defaults + info->deep_copies[i]));
+        g_value_copy(info->defaults + info->deep_copies[i], value);
     }
 }
 
+static void
+gig_user_object_init(GTypeInstance *instance, gpointer class_ptr)
+{
+    // Instance init runs for each type from the root down, but always
+    // with the class of the instance, so the first call for a user
+    // type sets up the values of all of them.
+    GigUserObjectInitInfo *info = user_object_info(G_TYPE_FROM_CLASS(class_ptr));
+    for (; info != NULL; info = info->parent_info)
+        user_object_init_values(instance, info);
+}
+
 static GType
 gig_user_object_define(const gchar *type_name,
-                       GType parent_type, GPtrArray *properties, GPtrArray *signals)
+                       GType parent_type, GPtrArray *properties, GPtrArray *signals,
+                       GArray *vfuncs)
 {
     GTypeInfo type_info;
     GigUserObjectInitInfo *class_init_info;
@@ -328,6 +706,7 @@ gig_user_object_define(const gchar *type_name,
     class_init_info = g_new0(GigUserObjectInitInfo, 1);
     class_init_info->properties = properties;
     class_init_info->signals = signals;
+    class_init_info->vfuncs = vfuncs;
 
     type_info.class_data = class_init_info;
 
@@ -338,13 +717,119 @@ gig_user_object_define(const gchar *type_name,
     type_info.class_init = (GClassInitFunc) gig_user_class_init;
     type_info.instance_init = gig_user_object_init;
     new_type = g_type_register_static(parent_type, type_name, &type_info, 0);
+    if (new_type == G_TYPE_INVALID) {
+        // The caller still owns the arrays.
+        g_free(class_init_info);
+        return new_type;
+    }
     class_init_info->type = new_type;
+    class_init_info->parent_info = user_object_info(parent_type);
+    if (properties->len > 0)
+        class_init_info->private_offset =
+            g_type_add_instance_private(new_type, sizeof(GValue) * properties->len);
+    g_type_set_qdata(new_type, gig_user_object_info_quark, class_init_info);
 
     return new_type;
 }
 
+// Finds the virtual function NAME of PARENT_TYPE or one of its
+// ancestors, and where it is stored in the class struct.
+static GIVFuncInfo *
+find_vfunc(GType parent_type, const gchar *name, gint *offset)
+{
+    for (GType type = parent_type; type != G_TYPE_INVALID; type = g_type_parent(type)) {
+        GIBaseInfo *info = g_irepository_find_by_gtype(NULL, type);
+        GIVFuncInfo *vfunc_info = NULL;
+        GIStructInfo *class_info = NULL;
+
+        if (info != NULL && GI_IS_OBJECT_INFO(info)) {
+            vfunc_info = g_object_info_find_vfunc(info, name);
+            class_info = g_object_info_get_class_struct(info);
+        }
+        if (info != NULL)
+            g_base_info_unref(info);
+
+        if (vfunc_info != NULL && class_info != NULL) {
+            gint n_fields = g_struct_info_get_n_fields(class_info);
+            for (gint i = 0; i < n_fields; i++) {
+                GIFieldInfo *field = g_struct_info_get_field(class_info, i);
+                gboolean found = g_str_equal(g_base_info_get_name(field), name);
+                if (found)
+                    *offset = g_field_info_get_offset(field);
+                g_base_info_unref(field);
+                if (found) {
+                    g_base_info_unref(class_info);
+                    return vfunc_info;
+                }
+            }
+        }
+        if (vfunc_info != NULL)
+            g_base_info_unref(vfunc_info);
+        if (class_info != NULL)
+            g_base_info_unref(class_info);
+    }
+    return NULL;
+}
+
+// Only overrides of a type that failed to be defined are cleared, so
+// their C functions were never installed.
+static void
+vfunc_override_clear(GigVFuncOverride *vfunc)
+{
+    g_base_info_unref(vfunc->info);
+    gig_amap_free(vfunc->amap);
+    gig_callback_free_for_vfunc(vfunc->func);
+}
+
+// Makes the C functions for S_VFUNCS, an alist of virtual function
+// names and the procedures that override them.  They are freed if the
+// current dynwind context is left non-locally.
+static GArray *
+make_vfunc_overrides(const gchar *type_name, GType parent_type, SCM s_vfuncs)
+{
+#define FUNC "%define-type"
+    GArray *vfuncs = g_array_new(FALSE, TRUE, sizeof(GigVFuncOverride));
+    g_array_set_clear_func(vfuncs, (GDestroyNotify)vfunc_override_clear);
+    scm_dynwind_unwind_handler((void (*)(void *))g_array_unref, vfuncs, 0);
+
+    for (SCM iter = s_vfuncs; scm_is_pair(iter); iter = scm_cdr(iter)) {
+        SCM entry = scm_car(iter);
+        SCM_ASSERT_TYPE(scm_is_pair(entry) && scm_is_symbol(scm_car(entry))
+                        && scm_is_true(scm_procedure_p(scm_cdr(entry))), s_vfuncs, SCM_ARG5, FUNC,
+                        "alist of virtual function names and procedures");
+
+        gchar *name = scm_to_utf8_string(scm_symbol_to_string(scm_car(entry)));
+        g_strdelimit(name, "-", '_');
+
+        // These are what user types are built on.
+        if (g_str_equal(name, "dispose") || g_str_equal(name, "finalize")
+            || g_str_equal(name, "get_property") || g_str_equal(name, "set_property")) {
+            free(name);
+            scm_misc_error(FUNC, "cannot override virtual function ~A", scm_list_1(scm_car(entry)));
+        }
+
+        GigVFuncOverride vfunc = { 0, };
+        GIVFuncInfo *vfunc_info = find_vfunc(parent_type, name, &vfunc.offset);
+        if (vfunc_info == NULL) {
+            free(name);
+            scm_misc_error(FUNC, "no virtual function ~A to override", scm_list_1(scm_car(entry)));
+        }
+
+        gchar *callback_name = g_strdup_printf("%s::%s", type_name, name);
+        vfunc.func = gig_callback_to_c_for_vfunc(callback_name, vfunc_info, scm_cdr(entry));
+        vfunc.info = vfunc_info;
+        vfunc.amap = gig_amap_new(callback_name, vfunc_info);
+        g_free(callback_name);
+        free(name);
+        g_array_append_val(vfuncs, vfunc);
+    }
+    return vfuncs;
+#undef FUNC
+}
+
 static SCM
-gig_i_scm_define_type(SCM s_type_name, SCM s_parent_type, SCM s_properties, SCM s_signals)
+gig_i_scm_define_type(SCM s_type_name, SCM s_parent_type, SCM s_properties, SCM s_signals,
+                      SCM s_vfuncs)
 {
     gchar *type_name;
     GType parent_type;
@@ -352,12 +837,14 @@ gig_i_scm_define_type(SCM s_type_name, SCM s_parent_type, SCM s_properties, SCM
     gsize n_properties, n_signals;
     GPtrArray *properties;
     GPtrArray *signals;
+    GArray *vfuncs;
 
     SCM_ASSERT(scm_is_string(s_type_name), s_type_name, SCM_ARG1, "%define-type");
     SCM_ASSERT(SCM_SUBCLASSP(s_parent_type, gig_object_type), s_parent_type, SCM_ARG2,
                "%define-type");
 
-    type_name = scm_to_utf8_string(s_type_name);
+    scm_dynwind_begin(0);
+    type_name = scm_dynwind_or_bust("%define-type", scm_to_utf8_string(s_type_name));
 
     parent_type = scm_to_gtype(s_parent_type);
 
@@ -366,6 +853,7 @@ gig_i_scm_define_type(SCM s_type_name, SCM s_parent_type, SCM s_properties, SCM
 
     SCM_UNBND_TO_BOOL_F(s_properties);
     SCM_UNBND_TO_BOOL_F(s_signals);
+    SCM_UNBND_TO_BOOL_F(s_vfuncs);
 
     SCM_ASSERT_TYPE(scm_is_false(s_properties) ||
                     scm_is_list(s_properties),
@@ -375,8 +863,15 @@ gig_i_scm_define_type(SCM s_type_name, SCM s_parent_type, SCM s_properties, SCM
                     scm_is_list(s_signals),
                     s_signals, SCM_ARG4, "%define-type", "list of signal specs or #f");
 
+    SCM_ASSERT_TYPE(scm_is_false(s_vfuncs) ||
+                    scm_is_list(s_vfuncs),
+                    s_vfuncs, SCM_ARG5, "%define-type", "alist of virtual functions or #f");
+
+    // The new type owns these once it is registered.
     properties = g_ptr_array_new();
+    scm_dynwind_unwind_handler((void (*)(void *))g_ptr_array_unref, properties, 0);
     signals = g_ptr_array_new_with_free_func((GDestroyNotify)gig_free_signalspec);
+    scm_dynwind_unwind_handler((void (*)(void *))g_ptr_array_unref, signals, 0);
 
     if (scm_is_list(s_properties)) {
         n_properties = scm_c_length(s_properties);
@@ -398,12 +893,62 @@ gig_i_scm_define_type(SCM s_type_name, SCM s_parent_type, SCM s_properties, SCM
         }
     }
 
-    new_type = gig_user_object_define(type_name, parent_type, properties, signals);
-    free(type_name);
+    vfuncs = make_vfunc_overrides(type_name, parent_type, s_vfuncs);
+    new_type = gig_user_object_define(type_name, parent_type, properties, signals, vfuncs);
+    if (new_type == G_TYPE_INVALID)
+        scm_misc_error("%define-type", "could not register type ~A", scm_list_1(s_type_name));
+    scm_dynwind_end();
     gig_type_define(new_type, SCM_UNDEFINED);
     return gig_type_get_scheme_type(new_type);
 }
 
+// Calls the implementation of the virtual function NAME that TYPE, a
+// registered type that overrides it, inherited from its parent.  This
+// is how an override chains up.
+static SCM
+gig_i_scm_chain_up(SCM s_type, SCM s_name, SCM self, SCM args)
+{
+#define FUNC "chain-up"
+    SCM_ASSERT_TYPE(SCM_SUBCLASSP(s_type, gig_object_type), s_type, SCM_ARG1, FUNC,
+                    "registered type");
+    GigUserObjectInitInfo *info = user_object_info(scm_to_gtype(s_type));
+    if (info == NULL)
+        scm_wrong_type_arg_msg(FUNC, SCM_ARG1, s_type, "registered type");
+    SCM_ASSERT_TYPE(scm_is_symbol(s_name), s_name, SCM_ARG2, FUNC, "symbol");
+    SCM_ASSERT_TYPE(gig_type_check_typed_object(self, s_type), self, SCM_ARG3, FUNC,
+                    "instance of the registered type");
+
+    gchar *name = scm_to_utf8_string(scm_symbol_to_string(s_name));
+    g_strdelimit(name, "-", '_');
+    GigVFuncOverride *vfunc = NULL;
+    for (guint i = 0; i < info->vfuncs->len && vfunc == NULL; i++) {
+        GigVFuncOverride *iter = &g_array_index(info->vfuncs, GigVFuncOverride, i);
+        if (g_str_equal(g_base_info_get_name(iter->info), name))
+            vfunc = iter;
+    }
+    free(name);
+
+    if (vfunc == NULL)
+        scm_misc_error(FUNC, "~A does not override virtual function ~A",
+                       scm_list_2(s_type, s_name));
+    if (vfunc->parent_func == NULL)
+        scm_misc_error(FUNC, "the parent of ~A does not implement virtual function ~A",
+                       scm_list_2(s_type, s_name));
+    if (vfunc->amap == NULL)
+        scm_misc_error(FUNC, "cannot call virtual function ~A", scm_list_1(s_name));
+
+    GError *error = NULL;
+    SCM output = gig_callable_invoke(vfunc->info, vfunc->parent_func, vfunc->amap, FUNC,
+                                     gig_object_peek(self), args, &error);
+    if (error != NULL) {
+        SCM err = scm_from_utf8_string(error->message);
+        g_error_free(error);
+        scm_misc_error(FUNC, "~A", scm_list_1(err));
+    }
+    return output;
+#undef FUNC
+}
+
 static void
 signal_lookup(const char *proc, GObject *self,
               SCM signal, SCM detail, guint *c_signal, GSignalQuery *query_info, GQuark *c_detail)
@@ -495,7 +1040,15 @@ gig_i_scm_emit(SCM self, SCM signal, SCM s_detail, SCM args)
     if (query_info.return_type != G_TYPE_NONE)
         g_value_init(&retval, query_info.return_type);
     g_debug("%s - emitting signal", g_signal_name(sigid));
+    gint64 start = gig_stats_start();
+    guint32 trace = gig_trace_enter_signal(sigid);
+    scm_dynwind_begin(0);
+    gig_trace_dynwind_exit(trace);
     g_signal_emitv(values, sigid, detail, &retval);
+    scm_dynwind_end();
+    gig_trace_end(trace);
+    if (start)
+        gig_stats_record_signal(sigid, start);
 
     if (query_info.return_type != G_TYPE_NONE)
         ret = scm_cons(gig_value_as_scm(&retval, FALSE), ret);
@@ -567,6 +1120,8 @@ gig_property_define(GType type, GIPropertyInfo *info, const gchar *_namespace, S
         gig_critical_load("%s is neither class nor interface, but we define properties, wtf?",
                           g_type_name(type));
     if (prop != NULL) {
+        // The plan is made here rather than on first use.
+        property_plan(prop);
         s_prop = gig_type_transfer_object(G_PARAM_SPEC_TYPE(prop), prop, GI_TRANSFER_NOTHING);
 
         def = do_define_property(long_name, s_prop, self_type, top_type);
@@ -590,50 +1145,63 @@ do_define_property(const gchar *public_name, SCM prop, SCM self_type, SCM value_
 {
     g_return_val_if_fail(public_name != NULL, SCM_UNDEFINED);
 
-    SCM sym_public_name, formals, specializers, generic, proc, setter;
+    SCM sym_public_name, formals, specializers, definition, generic, proc, setter;
 
     sym_public_name = scm_from_utf8_symbol(public_name);
-    generic = scm_call_2(ensure_accessor_proc, default_definition(sym_public_name),
-                         sym_public_name);
+    definition = gig_function_definition(sym_public_name);
+    // A generic that is not an accessor is replaced by one that copies
+    // its methods, so they must all be there.
+    gig_function_flush_generic(definition);
+    generic = scm_call_2(ensure_accessor_proc, definition, sym_public_name);
+    if (!scm_is_eq(generic, definition))
+        gig_load_stats_count(GIG_LOAD_GENERICS, 1);
 
     // getter
     proc = scm_procedure(prop);
-    formals = scm_list_1(sym_self);
-    specializers = scm_list_1(self_type);
+    formals = gig_function_intern_signature(scm_list_1(sym_self));
+    specializers = gig_function_intern_signature(scm_list_1(self_type));
 
-    scm_call_2(add_method_proc, generic,
-               scm_call_7(make_proc, method_type,
-                          kwd_specializers, specializers,
-                          kwd_formals, formals, kwd_procedure, proc));
+    gig_function_add_method(generic,
+                            scm_call_7(make_proc, method_type,
+                                       kwd_specializers, specializers,
+                                       kwd_formals, formals, kwd_procedure, proc));
 
     // setter
     setter = scm_setter(prop);
-    formals = scm_list_2(sym_self, sym_value);
-    specializers = scm_list_2(self_type, value_type);
+    formals = gig_function_intern_signature(scm_list_2(sym_self, sym_value));
+    specializers = gig_function_intern_signature(scm_list_2(self_type, value_type));
 
-    scm_call_2(add_method_proc, scm_setter(generic),
-               scm_call_7(make_proc, method_type,
-                          kwd_specializers, specializers,
-                          kwd_formals, formals, kwd_procedure, setter));
+    gig_function_add_method(scm_setter(generic),
+                            scm_call_7(make_proc, method_type,
+                                       kwd_specializers, specializers,
+                                       kwd_formals, formals, kwd_procedure, setter));
+    gig_load_stats_count(GIG_LOAD_METHODS, 2);
 
-    scm_define(sym_public_name, generic);
+    gig_function_define_generic(sym_public_name, generic);
     return sym_public_name;
 }
 
 void
 gig_init_object()
 {
-    gig_user_object_properties = g_quark_from_static_string("GigObject::properties");
+    gig_user_object_info_quark = g_quark_from_static_string("GigObject::user-object-info");
+    gig_property_plan_quark = g_quark_from_static_string("GigObject::property-plan");
+    gig_constructor_plan_quark = g_quark_from_static_string("GigObject::constructor-plan");
 
     sym_value = scm_from_utf8_symbol("value");
 
     ensure_accessor_proc = scm_c_public_ref("oop goops", "ensure-accessor");
 
     scm_c_define_gsubr("%make-gobject", 1, 1, 0, gig_i_scm_make_gobject);
+    scm_c_define_gsubr("make-objects", 2, 0, 0, gig_i_scm_make_objects);
     scm_c_define_gsubr("%object-get-pspec", 2, 0, 0, gig_i_scm_get_pspec);
     scm_c_define_gsubr("%get-property", 2, 0, 0, gig_i_scm_get_property);
     scm_c_define_gsubr("%set-property!", 3, 0, 0, gig_i_scm_set_property_x);
+    scm_c_define_gsubr("get-properties", 1, 0, 1, gig_i_scm_get_properties);
+    scm_c_define_gsubr("set-properties!", 1, 0, 1, gig_i_scm_set_properties_x);
+    scm_c_define_gsubr("chain-up", 3, 0, 1, gig_i_scm_chain_up);
+    scm_c_export("get-properties", "set-properties!", "make-objects", "chain-up", NULL);
     scm_c_define_gsubr("%connect", 4, 2, 0, gig_i_scm_connect);
     scm_c_define_gsubr("%emit", 2, 1, 1, gig_i_scm_emit);
-    scm_c_define_gsubr("%define-object-type", 2, 2, 0, gig_i_scm_define_type);
+    scm_c_define_gsubr("%define-object-type", 2, 3, 0, gig_i_scm_define_type);
 }
@@ -15,12 +15,14 @@
 
 #include <libguile.h>
 #include <girepository.h>
+#include "gig_binding_cache.h"
 #include "gig_type.h"
 #include "gig_object.h"
 #include "gig_function.h"
 #include "gig_util.h"
 #include "gig_constant.h"
 #include "gig_flag.h"
+#include "gig_load_stats.h"
 #include "gig_repository.h"
 
 static SCM
@@ -140,8 +142,27 @@ gig_repository_nested_infos(GIBaseInfo *base,
     }
 }
 
+static SCM load_info1(GIBaseInfo *info, LoadFlags flags, SCM defs);
+
 SCM
 load_info(GIBaseInfo *info, LoadFlags flags, SCM defs)
+{
+    GigLoadFrame frame;
+
+    if (G_LIKELY(!gig_load_stats_enabled) || info == NULL)
+        return load_info1(info, flags, defs);
+
+    scm_dynwind_begin(0);
+    gig_load_stats_begin(&frame, info);
+    scm_dynwind_unwind_handler((void (*)(void *))gig_load_stats_end, &frame,
+                               SCM_F_WIND_EXPLICITLY);
+    defs = load_info1(info, flags, defs);
+    scm_dynwind_end();
+    return defs;
+}
+
+static SCM
+load_info1(GIBaseInfo *info, LoadFlags flags, SCM defs)
 {
     g_return_val_if_fail(info != NULL, defs);
 
@@ -234,7 +255,9 @@ load_info(GIBaseInfo *info, LoadFlags flags, SCM defs)
         gig_critical_load("Unsupported irepository type 'VALUE'");
         break;
     case GI_INFO_TYPE_VFUNC:
-        gig_critical_load("Unsupported irepository type 'VFUNC'");
+        // Virtual functions are not bound; types made with
+        // register-type may override them.
+        gig_debug_load("%s.%s: skipping vfunc", parent_name, g_base_info_get_name(info));
         break;
     case GI_INFO_TYPE_FIELD:
         gig_critical_load("Unsupported irepository type 'FIELD'");
@@ -293,7 +316,398 @@ load(SCM info, SCM flags)
 
     GIBaseInfo *base_info = (GIBaseInfo *)gig_type_peek_object(info);
 
-    return load_info(base_info, load_flags, SCM_EOL);
+    scm_dynwind_begin(0);
+    gig_define_batch_begin();
+    SCM defs = load_info(base_info, load_flags, SCM_EOL);
+    gig_define_batch_end();
+    scm_dynwind_end();
+
+    return defs;
+}
+
+// Calls THUNK, which loads infos, so that the methods they make are
+// added to their generics once THUNK returns.
+static SCM
+load_batch(SCM thunk)
+{
+    scm_dynwind_begin(0);
+    gig_define_batch_begin();
+    SCM ret = scm_call_0(thunk);
+    gig_define_batch_end();
+    scm_dynwind_end();
+
+    return ret;
+}
+
+// The lazy index of a namespace maps each Scheme name that loading
+// the namespace would define to the functions, properties and signals
+// that define it.  Nested infos appear under both their long and their
+// short name, and are loaded only once.
+typedef struct _GigLazyIndex
+{
+    GHashTable *names;
+    GHashTable *loaded;
+} GigLazyIndex;
+
+// An entry of a precomputed index holds the location of its info,
+// which is only looked up when the entry is loaded.
+typedef struct _GigLazyEntry
+{
+    GIBaseInfo *info;
+    gchar *container;
+    GIInfoType type;
+    gchar *name;
+} GigLazyEntry;
+
+static GHashTable *lazy_indices;
+
+static GigLazyEntry *
+lazy_entry_new(GIBaseInfo *info)
+{
+    GigLazyEntry *entry = g_new0(GigLazyEntry, 1);
+    entry->info = info;
+    return entry;
+}
+
+static void
+lazy_index_add(GigLazyIndex *index, gchar *name, GigLazyEntry *entry)
+{
+    GPtrArray *entries = g_hash_table_lookup(index->names, name);
+    if (entries == NULL) {
+        entries = g_ptr_array_new();
+        g_hash_table_insert(index->names, name, entries);
+    }
+    else
+        g_free(name);
+    g_ptr_array_add(entries, entry);
+}
+
+// Returns the short name that load_info gives INFO, a method, property
+// or signal, as well as its long name, or NULL if it has none.
+static gchar *
+lazy_short_name(GIBaseInfo *info)
+{
+    if (GI_IS_PROPERTY_INFO(info))
+        return g_strdup(g_base_info_get_name(info));
+    if (GI_IS_CALLABLE_INFO(info) && g_callable_info_is_method(info))
+        return gig_callable_info_make_name(info, NULL);
+    return NULL;
+}
+
+// Adds the methods, properties and signals of BASE to INDEX, under the
+// names that load_info would give them.
+static void
+lazy_index_nested(GigLazyIndex *index, GIBaseInfo *base)
+{
+    const gchar *_namespace = g_base_info_get_name(base);
+    gint n_methods, n_properties, n_signals;
+    GigRepositoryNested method, property, nested_signal;
+
+    gig_repository_nested_infos(base, &n_methods, &method, &n_properties, &property,
+                                &n_signals, &nested_signal);
+
+    for (gint i = 0; i < n_methods + n_signals; i++) {
+        GIBaseInfo *info = (i < n_methods) ? method(base, i) : nested_signal(base, i - n_methods);
+        GigLazyEntry *entry = lazy_entry_new(info);
+        gchar *short_name = lazy_short_name(info);
+        lazy_index_add(index, gig_callable_info_make_name(info, _namespace), entry);
+        if (short_name != NULL)
+            lazy_index_add(index, short_name, entry);
+    }
+
+    for (gint i = 0; i < n_properties; i++) {
+        GIBaseInfo *info = property(base, i);
+        GigLazyEntry *entry = lazy_entry_new(info);
+        gchar *long_name = g_strdup_printf("%s:%s", _namespace, g_base_info_get_name(info));
+        lazy_index_add(index, gig_gname_to_scm_name(long_name), entry);
+        lazy_index_add(index, lazy_short_name(info), entry);
+        g_free(long_name);
+    }
+}
+
+// An "info" is a type or constant, which is any other top-level info.
+static const gchar *lazy_kinds[] = { "function", "signal", "property", "info" };
+static const GIInfoType lazy_kind_types[] = {
+    GI_INFO_TYPE_FUNCTION, GI_INFO_TYPE_SIGNAL, GI_INFO_TYPE_PROPERTY, GI_INFO_TYPE_INVALID
+};
+
+// Adds the entries of the precomputed index VEC to INDEX.  Each is a
+// vector of the name, the name of the container or #f, the kind and
+// the name of the info.  Entries at the same location are shared.
+static void
+lazy_index_precomputed(GigLazyIndex *index, SCM vec)
+{
+    GHashTable *locations = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    gsize n = scm_c_vector_length(vec);
+
+    for (gsize i = 0; i < n; i++) {
+        SCM row = scm_c_vector_ref(vec, i);
+        SCM_ASSERT_TYPE(scm_is_vector(row) && scm_c_vector_length(row) == 4, row, SCM_ARG2,
+                        "%lazy-index!", "vector of name, container, kind and info name");
+
+        gchar *kind = scm_to_utf8_string(scm_symbol_to_string(scm_c_vector_ref(row, 2)));
+        guint k = 0;
+        while (k < G_N_ELEMENTS(lazy_kinds) && !g_str_equal(kind, lazy_kinds[k]))
+            k++;
+        free(kind);
+        if (k == G_N_ELEMENTS(lazy_kinds))
+            scm_misc_error("%lazy-index!", "unknown kind in ~S", scm_list_1(row));
+
+        SCM s_container = scm_c_vector_ref(row, 1);
+        gchar *container = scm_is_true(s_container) ? scm_to_utf8_string(s_container) : NULL;
+        gchar *name = scm_to_utf8_string(scm_c_vector_ref(row, 3));
+        gchar *location = g_strdup_printf("%s/%d/%s", container ? container : "",
+                                          lazy_kind_types[k], name);
+        GigLazyEntry *entry = g_hash_table_lookup(locations, location);
+
+        if (entry == NULL) {
+            entry = g_new0(GigLazyEntry, 1);
+            entry->container = g_strdup(container);
+            entry->type = lazy_kind_types[k];
+            entry->name = g_strdup(name);
+            g_hash_table_insert(locations, location, entry);
+        }
+        else
+            g_free(location);
+        free(container);
+        free(name);
+
+        gchar *scm_name = scm_to_utf8_string(scm_symbol_to_string(scm_c_vector_ref(row, 0)));
+        lazy_index_add(index, g_strdup(scm_name), entry);
+        free(scm_name);
+    }
+    g_hash_table_unref(locations);
+}
+
+// Returns the info of ENTRY, looking it up in LIB if it was read from
+// a precomputed index, or NULL if LIB does not have it.
+static GIBaseInfo *
+lazy_entry_info(const gchar *lib, GigLazyEntry *entry)
+{
+    if (entry->info != NULL || entry->name == NULL)
+        return entry->info;
+
+    if (entry->container == NULL)
+        entry->info = g_irepository_find_by_name(NULL, lib, entry->name);
+    else {
+        GIBaseInfo *base = g_irepository_find_by_name(NULL, lib, entry->container);
+        gint n_methods, n_properties, n_signals, n = 0;
+        GigRepositoryNested method, property, nested_signal, nested = NULL;
+
+        if (base != NULL) {
+            gig_repository_nested_infos(base, &n_methods, &method, &n_properties, &property,
+                                        &n_signals, &nested_signal);
+            switch (entry->type) {
+            case GI_INFO_TYPE_FUNCTION:
+                n = n_methods;
+                nested = method;
+                break;
+            case GI_INFO_TYPE_SIGNAL:
+                n = n_signals;
+                nested = nested_signal;
+                break;
+            default:
+                n = n_properties;
+                nested = property;
+            }
+        }
+        for (gint i = 0; i < n && entry->info == NULL; i++) {
+            GIBaseInfo *info = nested(base, i);
+            if (g_str_equal(g_base_info_get_name(info), entry->name))
+                entry->info = info;
+            else
+                g_base_info_unref(info);
+        }
+        if (base != NULL)
+            g_base_info_unref(base);
+    }
+
+    if (entry->info == NULL
+        || (entry->type != GI_INFO_TYPE_INVALID
+            && g_base_info_get_type(entry->info) != entry->type)) {
+        gig_warning_load("%s - %s%s%s is not in the typelib", lib,
+                         entry->container ? entry->container : "",
+                         entry->container ? "." : "", entry->name);
+        g_clear_pointer(&entry->info, g_base_info_unref);
+        // Entries that are not found are not looked up again.
+        g_clear_pointer(&entry->name, g_free);
+    }
+    return entry->info;
+}
+
+// Loads the types and constants of LIB into the current module, and
+// indexes its functions, methods, properties and signals to be loaded
+// by lazy_load.  The names of the types and constants are indexed as
+// loaded, so that %lazy-index->vector has them.  If INDEX is given, it
+// is a precomputed index made by %lazy-index->vector, and nothing is
+// loaded or searched for in the typelib until it is looked up.
+// Returns the names that were defined.
+static SCM
+lazy_index(SCM lib, SCM s_index)
+{
+    scm_dynwind_begin(0);
+    gchar *_lib = scm_dynwind_or_bust("%lazy-index!", scm_to_utf8_string(lib));
+    gig_define_batch_begin();
+    gint n = g_irepository_get_n_infos(NULL, _lib);
+    gboolean precomputed = !SCM_UNBNDP(s_index) && scm_is_true(s_index);
+    SCM defs = SCM_EOL;
+
+    if (precomputed)
+        SCM_ASSERT_TYPE(scm_is_vector(s_index), s_index, SCM_ARG2, "%lazy-index!", "vector");
+    if (g_hash_table_contains(lazy_indices, _lib))
+        scm_misc_error("%lazy-index!", "~A is already indexed", scm_list_1(lib));
+
+    GigLazyIndex *index = g_new0(GigLazyIndex, 1);
+    index->names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)g_ptr_array_unref);
+    index->loaded = g_hash_table_new(NULL, NULL);
+    g_hash_table_insert(lazy_indices, g_strdup(_lib), index);
+
+    if (precomputed) {
+        lazy_index_precomputed(index, s_index);
+        n = 0;
+    }
+
+    for (gint i = 0; i < n; i++) {
+        GIBaseInfo *info = g_irepository_get_info(NULL, _lib, i);
+        GIInfoType type = g_base_info_get_type(info);
+
+        if (g_base_info_is_deprecated(info)) {
+            g_base_info_unref(info);
+            continue;
+        }
+        if (type == GI_INFO_TYPE_FUNCTION) {
+            lazy_index_add(index, gig_callable_info_make_name(info, NULL), lazy_entry_new(info));
+            continue;
+        }
+
+        SCM info_defs = load_info(info, LOAD_INFO_ONLY, SCM_EOL);
+        if (!scm_is_null(info_defs)) {
+            GigLazyEntry *entry = lazy_entry_new(g_base_info_ref(info));
+            g_hash_table_add(index->loaded, entry);
+            for (SCM iter = info_defs; scm_is_pair(iter); iter = scm_cdr(iter)) {
+                gchar *name = scm_to_utf8_string(scm_symbol_to_string(scm_car(iter)));
+                lazy_index_add(index, g_strdup(name), entry);
+                free(name);
+            }
+            defs = scm_append_x(scm_list_2(info_defs, defs));
+        }
+        // Only types that load_info defines have their nested infos
+        // loaded.
+        if (type == GI_INFO_TYPE_ENUM || type == GI_INFO_TYPE_FLAGS
+            || (GI_IS_REGISTERED_TYPE_INFO(info)
+                && g_registered_type_info_get_g_type(info) != G_TYPE_NONE))
+            lazy_index_nested(index, info);
+        g_base_info_unref(info);
+    }
+    gig_debug_load("%s - indexed %u names", _lib, g_hash_table_size(index->names));
+    gig_define_batch_end();
+    scm_dynwind_end();
+
+    return defs;
+}
+
+// Returns the names of the lazy index of LIB that have not been looked
+// up yet, with those of its types and constants, in the form that
+// %lazy-index! takes as a precomputed index.
+static SCM
+lazy_index_to_vector(SCM lib)
+{
+    scm_dynwind_begin(0);
+    gchar *_lib = scm_dynwind_or_bust("%lazy-index->vector", scm_to_utf8_string(lib));
+    GigLazyIndex *index = g_hash_table_lookup(lazy_indices, _lib);
+    GHashTableIter iter;
+    gpointer key, value;
+    SCM rows = SCM_EOL;
+
+    if (index == NULL)
+        scm_misc_error("%lazy-index->vector", "~A is not indexed", scm_list_1(lib));
+
+    g_hash_table_iter_init(&iter, index->names);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GPtrArray *entries = value;
+        for (guint i = 0; i < entries->len; i++) {
+            GIBaseInfo *info = lazy_entry_info(_lib, g_ptr_array_index(entries, i));
+            if (info == NULL)
+                continue;
+
+            GIBaseInfo *container = g_base_info_get_container(info);
+            GIInfoType type = g_base_info_get_type(info);
+            const gchar *kind = (type == GI_INFO_TYPE_SIGNAL) ? "signal"
+                : (type == GI_INFO_TYPE_PROPERTY) ? "property"
+                : (type == GI_INFO_TYPE_FUNCTION) ? "function" : "info";
+            SCM row = scm_c_make_vector(4, SCM_BOOL_F);
+
+            scm_c_vector_set_x(row, 0, scm_from_utf8_symbol(key));
+            if (container != NULL)
+                scm_c_vector_set_x(row, 1, scm_from_utf8_string(g_base_info_get_name(container)));
+            scm_c_vector_set_x(row, 2, scm_from_utf8_symbol(kind));
+            scm_c_vector_set_x(row, 3, scm_from_utf8_string(g_base_info_get_name(info)));
+            rows = scm_cons(row, rows);
+        }
+    }
+    scm_dynwind_end();
+
+    return scm_vector(rows);
+}
+
+// Loads what defines NAME in the lazy index of LIB into the current
+// module.  Returns the names that were defined, which are empty if LIB
+// does not define NAME or it was already loaded.
+//
+// Loading a method, property or signal by its long name also defines
+// its short name, which is then bound and no longer looked up here, so
+// everything else indexed under that short name is loaded with it.
+static SCM
+lazy_load(SCM lib, SCM name)
+{
+    scm_dynwind_begin(0);
+    gig_define_batch_begin();
+    gchar *_lib = scm_dynwind_or_bust("%lazy-load!", scm_to_utf8_string(lib));
+    gchar *first_name = scm_dynwind_or_bust("%lazy-load!",
+                                            scm_to_utf8_string(scm_symbol_to_string(name)));
+    GigLazyIndex *index = g_hash_table_lookup(lazy_indices, _lib);
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    GPtrArray *taken = g_ptr_array_new_with_free_func((GDestroyNotify)g_ptr_array_unref);
+    SCM defs = SCM_EOL;
+
+    scm_dynwind_unwind_handler((void (*)(void *))g_ptr_array_unref, names,
+                               SCM_F_WIND_EXPLICITLY);
+    scm_dynwind_unwind_handler((void (*)(void *))g_ptr_array_unref, taken,
+                               SCM_F_WIND_EXPLICITLY);
+    if (index == NULL)
+        scm_misc_error("%lazy-load!", "~A is not indexed", scm_list_1(lib));
+
+    g_ptr_array_add(names, g_strdup(first_name));
+    for (guint n = 0; n < names->len; n++) {
+        const gchar *_name = g_ptr_array_index(names, n);
+        GPtrArray *entries = g_hash_table_lookup(index->names, _name);
+        if (entries == NULL)
+            continue;
+        g_ptr_array_add(taken, g_ptr_array_ref(entries));
+        g_hash_table_remove(index->names, _name);
+
+        for (guint i = 0; i < entries->len; i++) {
+            GigLazyEntry *entry = g_ptr_array_index(entries, i);
+            if (!g_hash_table_add(index->loaded, entry))
+                continue;
+            GIBaseInfo *info = lazy_entry_info(_lib, entry);
+            if (info == NULL)
+                continue;
+            // Nested infos have their own entries.
+            defs = load_info(info, LOAD_INFO_ONLY, defs);
+
+            gchar *short_name = lazy_short_name(info);
+            if (short_name != NULL && !g_str_equal(short_name, _name))
+                g_ptr_array_add(names, short_name);
+            else
+                g_free(short_name);
+        }
+    }
+    gig_define_batch_end();
+    scm_dynwind_end();
+
+    return defs;
 }
 
 static SCM
@@ -349,12 +763,20 @@ prepend_search_path(SCM s_dir)
 void
 gig_init_repository()
 {
+    lazy_indices = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
     scm_c_define_gsubr("require", 1, 1, 0, require);
     scm_c_define_gsubr("infos", 1, 0, 0, infos);
     scm_c_define_gsubr("info", 2, 0, 0, info);
     scm_c_define_gsubr("%load-info", 1, 1, 0, load);
+    scm_c_define_gsubr("%load-batch", 1, 0, 0, load_batch);
+    scm_c_define_gsubr("%lazy-index!", 1, 1, 0, lazy_index);
+    scm_c_define_gsubr("%lazy-index->vector", 1, 0, 0, lazy_index_to_vector);
+    scm_c_define_gsubr("%lazy-load!", 2, 0, 0, lazy_load);
     scm_c_define_gsubr("get-search-path", 0, 0, 0, get_search_path);
     scm_c_define_gsubr("prepend-search-path!", 1, 0, 0, prepend_search_path);
+    gig_init_binding_cache();
+    gig_init_load_stats();
 
 #define D(x) scm_permanent_object(scm_c_define(#x, scm_from_uint(x)))
 
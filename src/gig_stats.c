@@ -0,0 +1,237 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// clock_gettime and CLOCK_MONOTONIC are POSIX, and are not declared
+// by <time.h> under -std=c11 otherwise.
+#define _POSIX_C_SOURCE 199309L
+
+#include <string.h>
+#include <time.h>
+#include <glib-object.h>
+#include <libguile.h>
+#include "gig_stats.h"
+
+gboolean gig_stats_enabled = FALSE;
+
+// Every GigStats that has been allocated, so that they can be reset
+// and read back.  Signals have no binding struct of their own, so
+// their counters are kept here too, by signal id.
+G_LOCK_DEFINE_STATIC(stats);
+static GHashTable *all_stats = NULL;
+static GHashTable *signal_stats = NULL;
+
+static const gchar *kind_names[] = {
+    [GIG_STATS_FUNCTION] = "function",
+    [GIG_STATS_CALLBACK] = "callback",
+    [GIG_STATS_SIGNAL] = "signal",
+    [GIG_STATS_CLOSURE] = "closure"
+};
+
+const gchar *
+gig_stats_kind_name(GigStatsKind kind)
+{
+    return kind_names[kind];
+}
+
+// Returns a monotonic time in nanoseconds.
+gint64
+gig_stats_clock(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#else
+    return g_get_monotonic_time() * 1000;
+#endif
+}
+
+static GigStats *
+stats_new(GigStatsKind kind, const gchar *name)
+{
+    GigStats *stats = g_new0(GigStats, 1);
+    stats->kind = kind;
+    stats->name = g_strdup(name);
+    if (all_stats == NULL)
+        all_stats = g_hash_table_new(NULL, NULL);
+    g_hash_table_add(all_stats, stats);
+    return stats;
+}
+
+static void
+stats_add(GigStats *stats, gint64 start, gboolean error, gsize temp_bytes)
+{
+    gint64 elapsed = gig_stats_clock() - start;
+    guint64 ns = MAX(elapsed, 1);
+    guint bucket = g_bit_storage(MIN(ns, G_MAXUINT32)) - 1;
+
+    stats->calls++;
+    stats->total_ns += ns;
+    stats->max_ns = MAX(stats->max_ns, ns);
+    stats->histogram[MIN(bucket, GIG_STATS_BUCKETS - 1)]++;
+    if (error)
+        stats->errors++;
+    stats->temp_bytes += temp_bytes;
+}
+
+// Adds one call that began at START to the counters in *STATS,
+// allocating them as a binding of KIND called NAME on first use.
+void
+gig_stats_record(GigStats **stats, GigStatsKind kind, const gchar *name, gint64 start,
+                 gboolean error, gsize temp_bytes)
+{
+    G_LOCK(stats);
+    if (*stats == NULL)
+        *stats = stats_new(kind, name);
+    stats_add(*stats, start, error, temp_bytes);
+    G_UNLOCK(stats);
+}
+
+void
+gig_stats_record_signal(guint signal_id, gint64 start)
+{
+    GigStats *stats;
+
+    G_LOCK(stats);
+    if (signal_stats == NULL)
+        signal_stats = g_hash_table_new(NULL, NULL);
+    stats = g_hash_table_lookup(signal_stats, GUINT_TO_POINTER(signal_id));
+    if (stats == NULL) {
+        GSignalQuery query;
+        g_signal_query(signal_id, &query);
+        gchar *name = g_strdup_printf("%s::%s", g_type_name(query.itype), query.signal_name);
+        stats = stats_new(GIG_STATS_SIGNAL, name);
+        g_free(name);
+        g_hash_table_insert(signal_stats, GUINT_TO_POINTER(signal_id), stats);
+    }
+    stats_add(stats, start, FALSE, 0);
+    G_UNLOCK(stats);
+}
+
+// Drops the counters of a binding that is going away.
+void
+gig_stats_free(GigStats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    G_LOCK(stats);
+    g_hash_table_remove(all_stats, stats);
+    G_UNLOCK(stats);
+    g_free(stats->name);
+    g_free(stats);
+}
+
+static SCM
+scm_stats_enable_x(void)
+{
+    gig_stats_enabled = TRUE;
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_stats_disable_x(void)
+{
+    gig_stats_enabled = FALSE;
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_stats_enabled_p(void)
+{
+    return scm_from_bool(gig_stats_enabled);
+}
+
+static SCM
+scm_stats_reset_x(void)
+{
+    GHashTableIter iter;
+    gpointer key;
+
+    G_LOCK(stats);
+    if (all_stats != NULL) {
+        g_hash_table_iter_init(&iter, all_stats);
+        while (g_hash_table_iter_next(&iter, &key, NULL)) {
+            GigStats *stats = key;
+            memset(&stats->calls, 0, sizeof(GigStats) - G_STRUCT_OFFSET(GigStats, calls));
+        }
+    }
+    G_UNLOCK(stats);
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+stats_to_scm(const GigStats *stats)
+{
+    SCM histogram = scm_c_make_vector(GIG_STATS_BUCKETS, SCM_INUM0);
+    for (gint i = 0; i < GIG_STATS_BUCKETS; i++)
+        SCM_SIMPLE_VECTOR_SET(histogram, i, scm_from_uint64(stats->histogram[i]));
+
+    return scm_list_n(scm_cons(scm_from_utf8_symbol("name"), scm_from_utf8_string(stats->name)),
+                      scm_cons(scm_from_utf8_symbol("kind"),
+                               scm_from_utf8_symbol(gig_stats_kind_name(stats->kind))),
+                      scm_cons(scm_from_utf8_symbol("calls"), scm_from_uint64(stats->calls)),
+                      scm_cons(scm_from_utf8_symbol("total-time"),
+                               scm_from_uint64(stats->total_ns)),
+                      scm_cons(scm_from_utf8_symbol("max-time"), scm_from_uint64(stats->max_ns)),
+                      scm_cons(scm_from_utf8_symbol("errors"), scm_from_uint64(stats->errors)),
+                      scm_cons(scm_from_utf8_symbol("temp-bytes"),
+                               scm_from_uint64(stats->temp_bytes)),
+                      scm_cons(scm_from_utf8_symbol("histogram"), histogram), SCM_UNDEFINED);
+}
+
+// Returns a list with one alist for each binding that has been called
+// since the last reset.
+static SCM
+scm_stats_snapshot(void)
+{
+    GArray *copies = g_array_new(FALSE, FALSE, sizeof(GigStats));
+    GHashTableIter iter;
+    gpointer key;
+    SCM output = SCM_EOL;
+
+    // Copy the counters out so that no Scheme allocation happens while
+    // the lock is held.
+    G_LOCK(stats);
+    if (all_stats != NULL) {
+        g_hash_table_iter_init(&iter, all_stats);
+        while (g_hash_table_iter_next(&iter, &key, NULL)) {
+            GigStats copy = *(GigStats *)key;
+            if (copy.calls == 0)
+                continue;
+            copy.name = g_strdup(copy.name);
+            g_array_append_val(copies, copy);
+        }
+    }
+    G_UNLOCK(stats);
+
+    for (guint i = 0; i < copies->len; i++) {
+        GigStats *copy = &g_array_index(copies, GigStats, i);
+        output = scm_cons(stats_to_scm(copy), output);
+        g_free(copy->name);
+    }
+    g_array_free(copies, TRUE);
+    return output;
+}
+
+void
+gig_init_stats(void)
+{
+    scm_c_define_gsubr("stats-enable!", 0, 0, 0, scm_stats_enable_x);
+    scm_c_define_gsubr("stats-disable!", 0, 0, 0, scm_stats_disable_x);
+    scm_c_define_gsubr("stats-enabled?", 0, 0, 0, scm_stats_enabled_p);
+    scm_c_define_gsubr("stats-reset!", 0, 0, 0, scm_stats_reset_x);
+    scm_c_define_gsubr("stats-snapshot", 0, 0, 0, scm_stats_snapshot);
+}
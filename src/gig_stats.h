@@ -0,0 +1,67 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GIG_STATS_H
+#define GIG_STATS_H
+
+#include <glib.h>
+
+// *INDENT-OFF*
+G_BEGIN_DECLS
+// *INDENT-ON*
+
+// Latencies are kept in a histogram of power-of-two nanosecond
+// buckets.  Bucket N counts calls that took [2^N, 2^(N+1)) ns, and
+// the last bucket also counts everything slower.
+#define GIG_STATS_BUCKETS 32
+
+typedef enum _GigStatsKind
+{
+    GIG_STATS_FUNCTION,
+    GIG_STATS_CALLBACK,
+    GIG_STATS_SIGNAL,
+    GIG_STATS_CLOSURE
+} GigStatsKind;
+
+// The counters of one binding.  A binding holds a NULL pointer until
+// it is first called while statistics are enabled.
+typedef struct _GigStats
+{
+    gchar *name;
+    GigStatsKind kind;
+    guint64 calls;
+    guint64 total_ns;
+    guint64 max_ns;
+    guint64 errors;
+    guint64 temp_bytes;
+    guint64 histogram[GIG_STATS_BUCKETS];
+} GigStats;
+
+extern gboolean gig_stats_enabled;
+
+const gchar *gig_stats_kind_name(GigStatsKind kind);
+gint64 gig_stats_clock(void);
+void gig_stats_record(GigStats **stats, GigStatsKind kind, const gchar *name, gint64 start,
+                      gboolean error, gsize temp_bytes);
+void gig_stats_record_signal(guint signal_id, gint64 start);
+void gig_stats_free(GigStats *stats);
+void gig_init_stats(void);
+
+// Returns the start time of a measured call, or zero when statistics
+// are disabled.
+#define gig_stats_start() (G_LIKELY(!gig_stats_enabled) ? 0 : gig_stats_clock())
+
+G_END_DECLS
+#endif
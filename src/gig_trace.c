@@ -0,0 +1,306 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <glib-object.h>
+#include <libguile.h>
+#include "gig_trace.h"
+
+#define GIG_TRACE_DEFAULT_CAPACITY 65536
+// Rounding up beyond this would not fit in a guint, and a buffer this
+// large is already hundreds of megabytes.
+#define GIG_TRACE_MAX_CAPACITY (1U << 24)
+
+typedef struct _GigTraceEvent
+{
+    gint64 time;
+    guint32 thread_id;
+    guint32 trace_id;
+    gboolean enter;
+} GigTraceEvent;
+
+typedef struct _GigTraceBinding
+{
+    gchar *name;
+    GigStatsKind kind;
+} GigTraceBinding;
+
+gboolean gig_trace_enabled = FALSE;
+
+// A ring buffer.  Writers claim a slot by incrementing next
+// atomically.  The capacity is a power of two, so that the slot index
+// stays consistent when the counter wraps.
+typedef struct _GigTraceRing
+{
+    guint capacity;
+    volatile guint next;
+    GigTraceEvent events[];
+} GigTraceRing;
+
+// The current ring is published as one pointer, so that writers always
+// see a buffer together with its own capacity.  A writer may still be
+// inside trace_record when the ring is replaced, so replaced rings are
+// kept in trace_retired and never freed.  Rings are only replaced when
+// tracing is restarted with a different capacity.
+static GigTraceRing *volatile trace_ring = NULL;
+static GSList *trace_retired = NULL;
+static gint64 trace_epoch = 0;
+
+// Trace ids index trace_bindings, offset by one so that zero means
+// that a binding has no id yet.
+G_LOCK_DEFINE_STATIC(trace);
+static GPtrArray *trace_bindings = NULL;
+static GHashTable *trace_ids_by_name = NULL;
+static GHashTable *trace_ids_by_signal = NULL;
+
+static volatile gint trace_thread_count = 0;
+static GPrivate trace_thread_id;
+
+static guint32
+current_thread_id(void)
+{
+    guint32 id = GPOINTER_TO_UINT(g_private_get(&trace_thread_id));
+    if (id == 0) {
+        id = g_atomic_int_add(&trace_thread_count, 1) + 1;
+        g_private_set(&trace_thread_id, GUINT_TO_POINTER(id));
+    }
+    return id;
+}
+
+// Returns the trace id of the binding of KIND called NAME.  Bindings
+// that share a name and kind, such as closures for the same
+// procedure, share an id.
+static guint32
+trace_intern(GigStatsKind kind, const gchar *name)
+{
+    gchar *key = g_strdup_printf("%d:%s", kind, name);
+    guint32 id;
+
+    G_LOCK(trace);
+    if (trace_bindings == NULL) {
+        trace_bindings = g_ptr_array_new();
+        trace_ids_by_name = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+    id = GPOINTER_TO_UINT(g_hash_table_lookup(trace_ids_by_name, key));
+    if (id == 0) {
+        GigTraceBinding *binding = g_new0(GigTraceBinding, 1);
+        binding->name = g_strdup(name);
+        binding->kind = kind;
+        g_ptr_array_add(trace_bindings, binding);
+        id = trace_bindings->len;
+        g_hash_table_insert(trace_ids_by_name, key, GUINT_TO_POINTER(id));
+        key = NULL;
+    }
+    G_UNLOCK(trace);
+    g_free(key);
+    return id;
+}
+
+static GigTraceRing *
+trace_ring_new(guint capacity)
+{
+    GigTraceRing *ring = g_malloc0(sizeof(GigTraceRing) + capacity * sizeof(GigTraceEvent));
+    ring->capacity = capacity;
+    return ring;
+}
+
+static void
+trace_record(guint32 trace_id, gboolean enter)
+{
+    GigTraceRing *ring = g_atomic_pointer_get(&trace_ring);
+
+    if (G_UNLIKELY(ring == NULL))
+        return;
+
+    guint next = (guint)g_atomic_int_add((volatile gint *)&ring->next, 1);
+    GigTraceEvent *event = &ring->events[next & (ring->capacity - 1)];
+
+    event->time = gig_stats_clock();
+    event->thread_id = current_thread_id();
+    event->trace_id = trace_id;
+    event->enter = enter;
+}
+
+guint32
+gig_trace_enter(guint32 *trace_id, GigStatsKind kind, const gchar *name)
+{
+    if (*trace_id == 0)
+        *trace_id = trace_intern(kind, name);
+    trace_record(*trace_id, TRUE);
+    return *trace_id;
+}
+
+guint32
+gig_trace_enter_signal(guint signal_id)
+{
+    guint32 id;
+
+    if (G_LIKELY(!gig_trace_enabled))
+        return 0;
+
+    G_LOCK(trace);
+    if (trace_ids_by_signal == NULL)
+        trace_ids_by_signal = g_hash_table_new(NULL, NULL);
+    id = GPOINTER_TO_UINT(g_hash_table_lookup(trace_ids_by_signal, GUINT_TO_POINTER(signal_id)));
+    G_UNLOCK(trace);
+
+    if (id == 0) {
+        GSignalQuery query;
+        g_signal_query(signal_id, &query);
+        gchar *name = g_strdup_printf("%s::%s", g_type_name(query.itype), query.signal_name);
+        id = trace_intern(GIG_STATS_SIGNAL, name);
+        g_free(name);
+
+        G_LOCK(trace);
+        g_hash_table_insert(trace_ids_by_signal, GUINT_TO_POINTER(signal_id),
+                            GUINT_TO_POINTER(id));
+        G_UNLOCK(trace);
+    }
+    trace_record(id, TRUE);
+    return id;
+}
+
+void
+gig_trace_exit(guint32 trace_id)
+{
+    // The exit is recorded even when tracing has been stopped since the
+    // binding was entered, so that every slice is closed.
+    trace_record(trace_id, FALSE);
+}
+
+static void
+trace_unwind(void *trace_id)
+{
+    gig_trace_exit(GPOINTER_TO_UINT(trace_id));
+}
+
+void
+gig_trace_dynwind_exit(guint32 trace_id)
+{
+    if (trace_id)
+        scm_dynwind_unwind_handler(trace_unwind, GUINT_TO_POINTER(trace_id), 0);
+}
+
+static SCM
+scm_trace_start_x(SCM s_capacity)
+{
+    guint capacity = GIG_TRACE_DEFAULT_CAPACITY;
+
+    if (!SCM_UNBNDP(s_capacity))
+        capacity = scm_to_uint(s_capacity);
+    if (capacity < 2 || capacity > GIG_TRACE_MAX_CAPACITY)
+        scm_out_of_range("trace-start!", s_capacity);
+    capacity = 1U << g_bit_storage(capacity - 1);
+
+    GigTraceRing *ring = g_atomic_pointer_get(&trace_ring);
+
+    if (gig_trace_enabled && ring != NULL && capacity != ring->capacity)
+        scm_misc_error("trace-start!", "cannot resize the trace buffer while tracing", SCM_EOL);
+
+    if (ring == NULL || capacity != ring->capacity) {
+        G_LOCK(trace);
+        if (ring != NULL)
+            trace_retired = g_slist_prepend(trace_retired, ring);
+        g_atomic_pointer_set(&trace_ring, trace_ring_new(capacity));
+        G_UNLOCK(trace);
+    }
+    if (trace_epoch == 0)
+        trace_epoch = gig_stats_clock();
+    gig_trace_enabled = TRUE;
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_trace_stop_x(void)
+{
+    gig_trace_enabled = FALSE;
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_trace_clear_x(void)
+{
+    GigTraceRing *ring = g_atomic_pointer_get(&trace_ring);
+
+    if (ring != NULL)
+        g_atomic_int_set((volatile gint *)&ring->next, 0);
+    trace_epoch = gig_stats_clock();
+    return SCM_UNSPECIFIED;
+}
+
+static void
+append_json_string(GString *out, const gchar *str)
+{
+    g_string_append_c(out, '"');
+    for (const gchar *p = str; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            g_string_append_printf(out, "\\%c", *p);
+        else if ((guchar)*p < 0x20)
+            g_string_append_printf(out, "\\u%04x", *p);
+        else
+            g_string_append_c(out, *p);
+    }
+    g_string_append_c(out, '"');
+}
+
+// Writes the recorded events, oldest first, to PORT in the Chrome
+// trace event format, which Perfetto can also read.  Timestamps are
+// in microseconds since tracing was started or cleared.
+static SCM
+scm_trace_dump(SCM port)
+{
+    GString *out = g_string_new("{\"traceEvents\":[");
+    GigTraceRing *ring = g_atomic_pointer_get(&trace_ring);
+    guint next = ring ? (guint)g_atomic_int_get((volatile gint *)&ring->next) : 0;
+    guint count = ring ? MIN(next, ring->capacity) : 0;
+
+    if (SCM_UNBNDP(port))
+        port = scm_current_output_port();
+
+    G_LOCK(trace);
+    for (guint i = next - count; i != next; i++) {
+        GigTraceEvent *event = &ring->events[i & (ring->capacity - 1)];
+        if (event->trace_id == 0 || event->time < trace_epoch)
+            continue;
+        GigTraceBinding *binding = g_ptr_array_index(trace_bindings, event->trace_id - 1);
+        gchar ts[G_ASCII_DTOSTR_BUF_SIZE];
+
+        // JSON numbers must not depend on the locale.
+        g_ascii_formatd(ts, sizeof(ts), "%.3f", (event->time - trace_epoch) / 1000.0);
+
+        if (out->str[out->len - 1] == '}')
+            g_string_append_c(out, ',');
+        g_string_append(out, "\n{\"name\":");
+        append_json_string(out, binding->name);
+        g_string_append_printf(out, ",\"cat\":\"%s\",\"ph\":\"%c\"",
+                               gig_stats_kind_name(binding->kind), event->enter ? 'B' : 'E');
+        g_string_append_printf(out, ",\"ts\":%s,\"pid\":1,\"tid\":%u}", ts, event->thread_id);
+    }
+    G_UNLOCK(trace);
+    g_string_append(out, "\n]}\n");
+
+    SCM str = scm_from_utf8_stringn(out->str, out->len);
+    g_string_free(out, TRUE);
+    scm_display(str, port);
+    return SCM_UNSPECIFIED;
+}
+
+void
+gig_init_trace(void)
+{
+    scm_c_define_gsubr("trace-start!", 0, 1, 0, scm_trace_start_x);
+    scm_c_define_gsubr("trace-stop!", 0, 0, 0, scm_trace_stop_x);
+    scm_c_define_gsubr("trace-clear!", 0, 0, 0, scm_trace_clear_x);
+    scm_c_define_gsubr("trace-dump", 0, 1, 0, scm_trace_dump);
+}
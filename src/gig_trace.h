@@ -0,0 +1,52 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GIG_TRACE_H
+#define GIG_TRACE_H
+
+#include <glib.h>
+#include "gig_stats.h"
+
+// *INDENT-OFF*
+G_BEGIN_DECLS
+// *INDENT-ON*
+
+// The trace recorder writes enter and exit events for calls across
+// the FFI boundary into a fixed-size ring buffer.  Each binding is
+// given a trace id the first time it is traced, which it keeps.
+
+extern gboolean gig_trace_enabled;
+
+guint32 gig_trace_enter(guint32 *trace_id, GigStatsKind kind, const gchar *name);
+guint32 gig_trace_enter_signal(guint signal_id);
+void gig_trace_exit(guint32 trace_id);
+void gig_init_trace(void);
+
+// Records entry into the binding whose trace id is stored in
+// *TRACE_ID, and returns that id, or zero when tracing is disabled.
+#define gig_trace_begin(trace_id, kind, name) \
+    (G_LIKELY(!gig_trace_enabled) ? 0 : gig_trace_enter(trace_id, kind, name))
+
+// Records exit from a binding that was entered with gig_trace_begin.
+#define gig_trace_end(trace_id) \
+    do { if (trace_id) gig_trace_exit(trace_id); } while (0)
+
+// Within a dynwind context, records the exit from a binding entered
+// with gig_trace_begin when a Scheme error escapes before
+// gig_trace_end is reached.
+void gig_trace_dynwind_exit(guint32 trace_id);
+
+G_END_DECLS
+#endif
@@ -15,11 +15,12 @@
 
 #include <libguile.h>
 #include <girepository.h>
-#include <ffi.h>
 #include "gig_type.h"
 #include "gig_util.h"
 #include "gig_object.h"
 #include "gig_type_private.h"
+#include "gig_load_stats.h"
+#include "gig_unref_queue.h"
 
 // In C, a GType is an integer.  It is an integer ID that maps to a
 // type of GObject.
@@ -70,8 +71,11 @@
 // Maps GType to SCM (pointer)
 static GHashTable *gig_type_gtype_hash = NULL;
 static GHashTable *gig_type_name_hash = NULL;
-// Maps SCM to GType
+// Maps SCM to GigClassInfo
 static GHashTable *gig_type_scm_hash = NULL;
+// Holds the GigClassInfo of a GType as qdata
+static GQuark gig_type_meta_quark;
+static GPtrArray *gig_type_metas = NULL;
 
 SCM gig_enum_type;
 SCM gig_flags_type;
@@ -85,6 +89,133 @@ static SCM make_class_proc;
 static SCM kwd_name;
 SCM sym_obarray;
 
+static SCM gig_fundamental_type;
+static SCM gig_boxed_type;
+
+static gsize
+bytes_size(gpointer ptr)
+{
+    return sizeof(gpointer) * 4 + g_bytes_get_size(ptr);
+}
+
+static gsize
+byte_array_size(gpointer ptr)
+{
+    return sizeof(GByteArray) + ((GByteArray *)ptr)->len;
+}
+
+static gsize
+array_size(gpointer ptr)
+{
+    return sizeof(GArray) + ((GArray *)ptr)->len * g_array_get_element_size(ptr);
+}
+
+static gsize
+ptr_array_size(gpointer ptr)
+{
+    return sizeof(GPtrArray) + ((GPtrArray *)ptr)->len * sizeof(gpointer);
+}
+
+// GdkPixbuf is not linked in, so gdk_pixbuf_get_byte_length is looked
+// up in its typelib when the type is first seen.
+static gsize (*pixbuf_get_byte_length)(gpointer);
+
+static gsize
+pixbuf_size(gpointer ptr)
+{
+    return pixbuf_get_byte_length(ptr);
+}
+
+static gboolean
+pixbuf_size_init(GType gtype)
+{
+    if (pixbuf_get_byte_length != NULL)
+        return TRUE;
+
+    GIBaseInfo *info = g_irepository_find_by_gtype(NULL, gtype);
+    if (info == NULL)
+        return FALSE;
+
+    GIFunctionInfo *method = NULL;
+    if (GI_IS_OBJECT_INFO(info))
+        method = g_object_info_find_method((GIObjectInfo *)info, "get_byte_length");
+    if (method != NULL) {
+        gpointer func = NULL;
+        if (g_typelib_symbol(g_base_info_get_typelib(method),
+                             g_function_info_get_symbol(method), &func))
+            pixbuf_get_byte_length = func;
+        g_base_info_unref(method);
+    }
+    g_base_info_unref(info);
+    return pixbuf_get_byte_length != NULL;
+}
+
+static void
+type_meta_init_size_func(GigClassInfo *meta)
+{
+    if (meta->gtype == G_TYPE_BYTES)
+        meta->size_func = bytes_size;
+    else if (meta->gtype == G_TYPE_BYTE_ARRAY)
+        meta->size_func = byte_array_size;
+    else if (meta->gtype == G_TYPE_ARRAY)
+        meta->size_func = array_size;
+    else if (meta->gtype == G_TYPE_PTR_ARRAY)
+        meta->size_func = ptr_array_size;
+    else if (g_str_equal(g_type_name(meta->gtype), "GdkPixbuf")
+             && pixbuf_size_init(meta->gtype))
+        meta->size_func = pixbuf_size;
+}
+
+// Returns the metadata of GTYPE, creating it if needed.  A new entry
+// inherits the ref and unref functions of its parent.
+static GigClassInfo *
+type_meta_ensure(GType gtype)
+{
+    GigClassInfo *meta = g_type_get_qdata(gtype, gig_type_meta_quark);
+    if (meta != NULL)
+        return meta;
+
+    meta = g_new0(GigClassInfo, 1);
+    gig_load_stats_count(GIG_LOAD_BYTES, sizeof(GigClassInfo));
+    meta->gtype = gtype;
+    meta->stype = SCM_UNDEFINED;
+    meta->size_proc = SCM_BOOL_F;
+
+    GType parent = g_type_parent(gtype);
+    GigClassInfo *parent_meta = parent ? g_type_get_qdata(parent, gig_type_meta_quark) : NULL;
+    if (parent_meta != NULL) {
+        meta->ref = parent_meta->ref;
+        meta->unref = parent_meta->unref;
+        meta->size_func = parent_meta->size_func;
+        meta->size_proc = parent_meta->size_proc;
+        if (scm_is_true(meta->size_proc))
+            scm_gc_protect_object(meta->size_proc);
+    }
+    type_meta_init_size_func(meta);
+
+    g_type_set_qdata(gtype, gig_type_meta_quark, meta);
+    g_ptr_array_add(gig_type_metas, meta);
+    return meta;
+}
+
+static GigClassInfo *
+class_meta(SCM stype)
+{
+    return g_hash_table_lookup(gig_type_scm_hash, SCM_UNPACK_POINTER(stype));
+}
+
+// Returns the metadata of the class of OBJ, if OBJ wraps an instance
+// of a GType.
+static GigClassInfo *
+instance_meta(SCM obj)
+{
+    if (!SCM_INSTANCEP(obj))
+        return NULL;
+
+    GigClassInfo *meta = class_meta(SCM_CLASS_OF(obj));
+    return (meta != NULL && meta->is_wrapper) ? meta : NULL;
+}
+
 gchar *
 gig_type_class_name_from_gtype(GType gtype)
 {
@@ -116,13 +247,497 @@ static SCM make_instance_proc;
 static SCM make_fundamental_proc;
 static SCM kwd_value;
 static SCM sym_value;
-static SCM sym_ref;
-static SCM sym_unref;
+static SCM sym_handle;
 static SCM sym_size;
 
 typedef gpointer (*GigTypeRefFunction)(gpointer);
 typedef void (*GigTypeUnrefFunction)(gpointer);
 
+// The value and handle slots of wrappers are read and written by the
+// index that each class looked up once, without going through GOOPS.
+// Instances of Scheme subclasses that have no GType of their own fall
+// back to the slot names.
+static SCM
+wrapper_slot_ref(SCM wrapper, SCM name, gsize index_offset)
+{
+    GigClassInfo *meta = instance_meta(wrapper);
+
+    if (G_LIKELY(meta != NULL))
+        return SCM_STRUCT_SLOT_REF(wrapper, G_STRUCT_MEMBER(gint, meta, index_offset));
+    return scm_slot_ref(wrapper, name);
+}
+
+static void
+wrapper_slot_set(SCM wrapper, SCM name, gsize index_offset, SCM value)
+{
+    GigClassInfo *meta = instance_meta(wrapper);
+
+    if (G_LIKELY(meta != NULL))
+        SCM_STRUCT_SLOT_SET(wrapper, G_STRUCT_MEMBER(gint, meta, index_offset), value);
+    else
+        scm_slot_set_x(wrapper, name, value);
+}
+
+#define wrapper_value(w) \
+    wrapper_slot_ref(w, sym_value, G_STRUCT_OFFSET(GigClassInfo, value_slot))
+#define wrapper_set_value(w, v) \
+    wrapper_slot_set(w, sym_value, G_STRUCT_OFFSET(GigClassInfo, value_slot), v)
+#define wrapper_handle(w) \
+    wrapper_slot_ref(w, sym_handle, G_STRUCT_OFFSET(GigClassInfo, handle_slot))
+#define wrapper_set_handle(w, v) \
+    wrapper_slot_set(w, sym_handle, G_STRUCT_OFFSET(GigClassInfo, handle_slot), v)
+
+// Maps the address of a C instance that is not an object to the
+// Scheme wrapper that owns a reference to it.  The values are weak, so
+// a wrapper stays in the cache for as long as it is reachable from
+// Scheme.  Since a wrapper keeps its instance alive, an address cannot
+// be reused while its entry is present.  Objects find their wrapper
+// through their qdata instead.
+static SCM wrapper_cache;
+
+static SCM
+wrapper_cache_key(gpointer ptr)
+{
+    return scm_from_uintptr_t((scm_t_uintptr)ptr);
+}
+
+// The native memory held by wrappers is reported to the GC when they
+// are made, so that large instances make collections happen sooner.
+// It is also counted here until the wrappers are collected or
+// disposed.
+G_LOCK_DEFINE_STATIC(retained);
+static gsize retained_bytes = 0;
+
+// A wrapper that owns its instance holds a handle in its handle slot,
+// by way of a pointer object whose finalizer releases the instance and
+// subtracts its count.  The pointer object in the value slot has no
+// finalizer, so that disposing a wrapper only needs to empty its
+// slots.
+typedef struct _GigWrapperHandle
+{
+    gpointer ptr;
+    void (*unref)(gpointer);
+    // The type of a boxed PTR, which has no unref function.
+    GType boxed_type;
+    gsize retained;
+    // For objects, a weak vector of length one that holds the wrapper,
+    // and the wrapper itself while it is protected, or else #f.
+    SCM box;
+    SCM strong;
+} GigWrapperHandle;
+
+// A wrapper owns its object through a toggle reference, and the
+// object's qdata points back to the wrapper's handle.  While C holds
+// other references to the object, the wrapper is protected, so that
+// it lives as long as the object does.  When the toggle reference is
+// the last one, only Scheme keeps the wrapper alive.  The lock guards
+// the qdata and the strong field of handles, since toggle notifications
+// can come from any thread.
+static GQuark wrapper_quark;
+G_LOCK_DEFINE_STATIC(wrapper_toggle);
+
+struct wrapper_toggle
+{
+    GObject *object;
+    gboolean is_last_ref;
+};
+
+static void *
+wrapper_toggle_inner(void *data)
+{
+    struct wrapper_toggle *toggle = data;
+    SCM unprotect = SCM_BOOL_F;
+
+    G_LOCK(wrapper_toggle);
+    GigWrapperHandle *handle = g_object_get_qdata(toggle->object, wrapper_quark);
+    if (handle != NULL && toggle->is_last_ref) {
+        unprotect = handle->strong;
+        handle->strong = SCM_BOOL_F;
+    }
+    else if (handle != NULL && scm_is_false(handle->strong)) {
+        // A wrapper that was already collected is replaced when the
+        // object is next wrapped.
+        SCM wrapper = scm_c_weak_vector_ref(handle->box, 0);
+        if (scm_is_true(wrapper))
+            handle->strong = scm_gc_protect_object(wrapper);
+    }
+    G_UNLOCK(wrapper_toggle);
+
+    if (scm_is_true(unprotect))
+        scm_gc_unprotect_object(unprotect);
+    return NULL;
+}
+
+static void
+wrapper_toggle_notify(gpointer data, GObject *object, gboolean is_last_ref)
+{
+    struct wrapper_toggle toggle = { object, is_last_ref };
+    scm_with_guile(wrapper_toggle_inner, &toggle);
+}
+
+// Makes HANDLE own its object, which is referenced by the caller,
+// through a toggle reference held by WRAPPER.
+static void
+object_wrapper_attach(GigWrapperHandle *handle, SCM wrapper)
+{
+    GObject *object = handle->ptr;
+
+    handle->box = scm_gc_protect_object(scm_c_make_weak_vector(1, wrapper));
+    handle->strong = scm_gc_protect_object(wrapper);
+    G_LOCK(wrapper_toggle);
+    g_object_set_qdata(object, wrapper_quark, handle);
+    G_UNLOCK(wrapper_toggle);
+
+    // The toggle reference takes over from the caller's.  If that was
+    // the only other one, the wrapper is unprotected right away.
+    g_object_add_toggle_ref(object, wrapper_toggle_notify, NULL);
+    g_object_unref(object);
+}
+
+// Unlinks HANDLE from its object, whose toggle reference is still to
+// be removed.
+static void
+object_wrapper_detach(GigWrapperHandle *handle)
+{
+    G_LOCK(wrapper_toggle);
+    if (g_object_get_qdata(handle->ptr, wrapper_quark) == handle)
+        g_object_set_qdata(handle->ptr, wrapper_quark, NULL);
+    SCM strong = handle->strong;
+    handle->strong = SCM_BOOL_F;
+    G_UNLOCK(wrapper_toggle);
+
+    if (scm_is_true(strong))
+        scm_gc_unprotect_object(strong);
+    scm_gc_unprotect_object(handle->box);
+    handle->box = SCM_BOOL_F;
+}
+
+static SCM
+object_wrapper_lookup(GObject *object)
+{
+    SCM wrapper = SCM_BOOL_F;
+
+    G_LOCK(wrapper_toggle);
+    GigWrapperHandle *handle = g_object_get_qdata(object, wrapper_quark);
+    if (handle != NULL)
+        wrapper = scm_c_weak_vector_ref(handle->box, 0);
+    G_UNLOCK(wrapper_toggle);
+    return wrapper;
+}
+
+static SCM
+wrapper_cache_lookup(GigClassInfo *meta, gpointer ptr)
+{
+    SCM wrapper;
+
+    if (G_TYPE_IS_OBJECT(meta->gtype))
+        wrapper = object_wrapper_lookup(ptr);
+    else {
+        wrapper = scm_hashv_ref(wrapper_cache, wrapper_cache_key(ptr), SCM_BOOL_F);
+        if (scm_is_true(wrapper) && scm_to_pointer(wrapper_value(wrapper)) != ptr)
+            return SCM_BOOL_F;
+    }
+
+    if (scm_is_false(wrapper) || !SCM_IS_A_P(wrapper, meta->stype))
+        return SCM_BOOL_F;
+    return wrapper;
+}
+
+// Releases PTR, which HANDLE owned, from the finalizer of the handle.
+static void
+wrapper_handle_unref(GigWrapperHandle *handle, gpointer ptr)
+{
+    if (scm_is_true(handle->box)) {
+        object_wrapper_detach(handle);
+        gig_unref_queue_toggle_ref(ptr, wrapper_toggle_notify);
+    }
+    else if (handle->boxed_type != G_TYPE_INVALID)
+        gig_unref_queue_boxed(handle->boxed_type, ptr);
+    else
+        handle->unref(ptr);
+}
+
+static void
+retained_subtract(gsize size)
+{
+    G_LOCK(retained);
+    retained_bytes -= size;
+    G_UNLOCK(retained);
+}
+
+static void
+wrapper_handle_free(gpointer data)
+{
+    GigWrapperHandle *handle = data;
+    if (handle->ptr != NULL)
+        wrapper_handle_unref(handle, handle->ptr);
+    retained_subtract(handle->retained);
+    g_free(handle);
+}
+
+// Releases the instance owned by WRAPPER now, rather than when its
+// handle is finalized, which then has nothing left to release.
+static void
+wrapper_handle_release(SCM wrapper)
+{
+    SCM s_handle = wrapper_handle(wrapper);
+    if (scm_is_false(s_handle))
+        return;
+
+    GigWrapperHandle *handle = scm_to_pointer(s_handle);
+    gpointer ptr = handle->ptr;
+    retained_subtract(handle->retained);
+    handle->retained = 0;
+    handle->ptr = NULL;
+    wrapper_set_handle(wrapper, SCM_BOOL_F);
+    if (ptr == NULL)
+        return;
+
+    // Only finalizers go through the unref queue.  Disposing releases
+    // the instance on the calling thread, whether or not it owns the
+    // default main context.
+    if (scm_is_true(handle->box)) {
+        object_wrapper_detach(handle);
+        g_object_remove_toggle_ref(ptr, wrapper_toggle_notify, NULL);
+    }
+    else if (handle->boxed_type != G_TYPE_INVALID)
+        g_boxed_free(handle->boxed_type, ptr);
+    else
+        handle->unref(ptr);
+}
+
+static gsize
+retained_size(GigClassInfo *meta, SCM wrapper, gpointer ptr)
+{
+    if (scm_is_true(meta->size_proc))
+        return scm_to_size_t(scm_call_1(meta->size_proc, wrapper));
+    else if (meta->size_func != NULL)
+        return meta->size_func(ptr);
+    else if (G_TYPE_IS_BOXED(meta->gtype))
+        return meta->size;
+    return 0;
+}
+
+// Returns the native memory that WRAPPER keeps alive, which is now
+// counted.
+static gsize
+retain(GigClassInfo *meta, SCM wrapper, gpointer ptr)
+{
+    if (!G_TYPE_IS_OBJECT(meta->gtype) && !G_TYPE_IS_BOXED(meta->gtype))
+        return 0;
+
+    gsize size = retained_size(meta, wrapper, ptr);
+    if (size == 0)
+        return 0;
+    scm_gc_register_allocation(size);
+
+    G_LOCK(retained);
+    retained_bytes += size;
+    G_UNLOCK(retained);
+    return size;
+}
+
+// Wrappers that own their instance and are made within a GObject
+// scope are added to the scope's list, and released when it is left.
+// Most code runs outside any scope, so the fluid is only read while
+// one is open somewhere.
+static SCM gobject_scope_fluid;
+static volatile gint gobject_scopes_open = 0;
+
+// Makes a wrapper that owns a reference to PTR.
+static SCM
+wrapper_cache_make(GigClassInfo *meta, gpointer ptr)
+{
+    SCM pointer = scm_from_pointer(ptr, NULL);
+    SCM wrapper = scm_call_3(make_instance_proc, meta->stype, kwd_value, pointer);
+
+    GigWrapperHandle *handle = g_new0(GigWrapperHandle, 1);
+    handle->ptr = ptr;
+    handle->unref = meta->unref;
+    handle->boxed_type = G_TYPE_IS_BOXED(meta->gtype) ? meta->gtype : G_TYPE_INVALID;
+    handle->box = SCM_BOOL_F;
+    handle->strong = SCM_BOOL_F;
+    wrapper_set_handle(wrapper, scm_from_pointer(handle, wrapper_handle_free));
+    handle->retained = retain(meta, wrapper, ptr);
+    if (G_TYPE_IS_OBJECT(meta->gtype))
+        object_wrapper_attach(handle, wrapper);
+    else
+        scm_hashv_set_x(wrapper_cache, wrapper_cache_key(ptr), wrapper);
+
+    if (G_UNLIKELY(g_atomic_int_get(&gobject_scopes_open) > 0)) {
+        SCM scope = scm_fluid_ref(gobject_scope_fluid);
+        if (scm_is_true(scope))
+            scm_set_car_x(scope, scm_cons(wrapper, scm_car(scope)));
+    }
+    return wrapper;
+}
+
+// When borrowing is enabled, boxed values that C only lends to Scheme
+// are wrapped without being copied, as long as there is a borrow
+// scope.  A scope is a pair of its owner, or #f, and the wrappers
+// borrowed in it.
+gboolean gig_type_borrow_boxed = FALSE;
+static SCM borrow_scope_fluid;
+// Maps each borrowed wrapper to its scope.  The keys are weak, and a
+// scope with an owner keeps the owner alive.
+static SCM borrowed_wrappers;
+// The owners that have lent wrappers, which are looked for in
+// borrowed_wrappers when the owner is disposed.  The keys are weak.
+static SCM lending_owners;
+static SCM null_pointer;
+
+static SCM
+borrow_object(GigClassInfo *meta, gpointer ptr, SCM scope)
+{
+    gig_debug_transfer("%p - borrowing", ptr);
+
+    SCM pointer = scm_from_pointer(ptr, NULL);
+    SCM wrapper = scm_call_3(make_instance_proc, meta->stype, kwd_value, pointer);
+    SCM owner = scm_car(scope);
+    scm_hashq_set_x(borrowed_wrappers, wrapper, scope);
+    if (scm_is_false(owner))
+        scm_set_cdr_x(scope, scm_cons(wrapper, scm_cdr(scope)));
+    else
+        scm_hashq_set_x(lending_owners, owner, SCM_BOOL_T);
+    return wrapper;
+}
+
+static SCM
+empty_if_lent_by(void *owner, SCM wrapper, SCM scope, SCM result)
+{
+    if (scm_is_pair(scope) && scm_is_eq(scm_car(scope), SCM_PACK((scm_t_bits)owner)))
+        wrapper_set_value(wrapper, null_pointer);
+    return result;
+}
+
+// Empties the wrappers borrowed from OWNER, which is being disposed.
+static void
+borrowed_from_end(SCM owner)
+{
+    if (scm_is_false(scm_hashq_ref(lending_owners, owner, SCM_BOOL_F)))
+        return;
+    scm_hashq_remove_x(lending_owners, owner);
+    scm_internal_hash_fold(empty_if_lent_by, (void *)SCM_UNPACK(owner), SCM_UNSPECIFIED,
+                           borrowed_wrappers);
+}
+
+// Empties the wrappers borrowed in SCOPE, which has no owner.
+static void
+borrow_scope_end(SCM scope)
+{
+    for (SCM iter = scm_cdr(scope); !scm_is_null(iter); iter = scm_cdr(iter))
+        wrapper_set_value(scm_car(iter), null_pointer);
+    scm_set_cdr_x(scope, SCM_EOL);
+}
+
+// Opens a borrow scope for the rest of the current dynwind context.
+// If OWNER is #f, the wrappers borrowed in it are emptied when the
+// context is left.  Otherwise, they keep OWNER alive, since it owns
+// the memory they point to.  If OWNER is itself borrowed, what is
+// borrowed from it joins OWNER's scope, so that it is emptied or kept
+// alive together with OWNER.
+void
+gig_type_dynwind_borrow(SCM owner)
+{
+    SCM scope = SCM_BOOL_F;
+
+    if (scm_is_true(owner))
+        scope = scm_hashq_ref(borrowed_wrappers, owner, SCM_BOOL_F);
+    if (scm_is_true(scope)) {
+        scm_dynwind_fluid(borrow_scope_fluid, scope);
+        return;
+    }
+
+    scope = scm_cons(owner, SCM_EOL);
+    scm_dynwind_fluid(borrow_scope_fluid, scope);
+    if (scm_is_false(owner))
+        scm_dynwind_unwind_handler_with_scm(borrow_scope_end, scope, SCM_F_WIND_EXPLICITLY);
+}
+
+// Only objects and boxed values can be disposed.
+static gboolean
+is_disposable(GigClassInfo *meta)
+{
+    return meta != NULL && (G_TYPE_IS_OBJECT(meta->gtype) || G_TYPE_IS_BOXED(meta->gtype));
+}
+
+static SCM disposed_wrappers;
+
+// Releases the instance owned by WRAPPER now, rather than when WRAPPER
+// is collected.  WRAPPER is emptied, as are the wrappers borrowed from
+// it, since they point into its instance.
+static void
+wrapper_dispose(SCM wrapper)
+{
+    SCM pointer = wrapper_value(wrapper);
+
+    gpointer ptr = scm_to_pointer(pointer);
+    if (ptr == NULL)
+        return;
+
+    if (scm_is_true(scm_hashq_ref(borrowed_wrappers, wrapper, SCM_BOOL_F))) {
+        // A borrowed wrapper owns nothing, so it is only emptied.
+        wrapper_set_value(wrapper, null_pointer);
+        return;
+    }
+
+    gig_debug_transfer("%p - disposing", ptr);
+    wrapper_set_value(wrapper, null_pointer);
+    SCM key = wrapper_cache_key(ptr);
+    if (scm_is_eq(scm_hashv_ref(wrapper_cache, key, SCM_BOOL_F), wrapper))
+        scm_hashv_remove_x(wrapper_cache, key);
+    scm_hashq_set_x(disposed_wrappers, wrapper, SCM_BOOL_T);
+    borrowed_from_end(wrapper);
+    wrapper_handle_release(wrapper);
+}
+
+static void
+gobject_scope_begin(void *unused)
+{
+    g_atomic_int_add(&gobject_scopes_open, 1);
+}
+
+static void
+gobject_scope_end(SCM scope)
+{
+    SCM wrappers = scm_car(scope);
+
+    scm_set_car_x(scope, SCM_EOL);
+    g_atomic_int_add(&gobject_scopes_open, -1);
+    // Release the newest wrappers first, as a stack would.
+    for (; !scm_is_null(wrappers); wrappers = scm_cdr(wrappers))
+        wrapper_dispose(scm_car(wrappers));
+}
+
+// Calls THUNK.  The objects and boxed values that are wrapped while it
+// runs are released when it returns or exits non-locally.  If THUNK is
+// re-entered through a continuation, the scope is open again, and
+// releases what is wrapped from then on.
+static SCM
+scm_call_with_gobject_scope(SCM thunk)
+{
+    SCM_ASSERT_TYPE(scm_is_true(scm_procedure_p(thunk)), thunk, SCM_ARG1,
+                    "call-with-gobject-scope", "thunk");
+    SCM scope = scm_list_1(SCM_EOL);
+
+    scm_dynwind_begin(SCM_F_DYNWIND_REWINDABLE);
+    scm_dynwind_rewind_handler(gobject_scope_begin, NULL, SCM_F_WIND_EXPLICITLY);
+    scm_dynwind_fluid(gobject_scope_fluid, scope);
+    scm_dynwind_unwind_handler_with_scm(gobject_scope_end, scope, SCM_F_WIND_EXPLICITLY);
+    SCM ret = scm_call_0(thunk);
+    scm_dynwind_end();
+    return ret;
+}
+
+static SCM
+scm_dispose_x(SCM obj)
+{
+    SCM_ASSERT_TYPE(is_disposable(instance_meta(obj)), obj, SCM_ARG1, "dispose!",
+                    "object or boxed value");
+    wrapper_dispose(obj);
+    return SCM_UNSPECIFIED;
+}
+
 SCM
 gig_type_transfer_object(GType type, gpointer ptr, GITransfer transfer)
 {
@@ -131,54 +746,108 @@ gig_type_transfer_object(GType type, gpointer ptr, GITransfer transfer)
 
     gig_debug_transfer("gig_type_transfer_object(%s, %p, %d)", g_type_name(type), ptr, transfer);
 
-    SCM scm_type = gig_type_get_scheme_type(type);
-    g_return_val_if_fail(SCM_CLASSP(scm_type), SCM_BOOL_F);
-    GigTypeRefFunction ref;
-    ref = (GigTypeRefFunction)scm_to_pointer(scm_class_ref(scm_type, sym_ref));
-    GigTypeUnrefFunction unref;
-    unref = (GigTypeUnrefFunction)scm_to_pointer(scm_class_ref(scm_type, sym_unref));
-
-    SCM pointer;
-    switch (transfer) {
-    case GI_TRANSFER_NOTHING:
-        pointer = scm_from_pointer(ref(ptr), unref);
-        break;
-
-    case GI_TRANSFER_CONTAINER:
-    case GI_TRANSFER_EVERYTHING:
-        pointer = scm_from_pointer(ptr, unref);
-        break;
+    GigClassInfo *meta = g_type_get_qdata(type, gig_type_meta_quark);
+    if (meta == NULL || SCM_UNBNDP(meta->stype)) {
+        gig_type_get_scheme_type(type);
+        meta = g_type_get_qdata(type, gig_type_meta_quark);
+    }
+    g_return_val_if_fail(meta != NULL && SCM_CLASSP(meta->stype), SCM_BOOL_F);
+    g_return_val_if_fail(meta->ref != NULL || G_TYPE_IS_BOXED(type), SCM_BOOL_F);
+
+    // Reuse the wrapper of this instance, if there is one.  It already
+    // owns a reference, so a transferred reference is dropped.
+    SCM wrapper = wrapper_cache_lookup(meta, ptr);
+    if (scm_is_true(wrapper)) {
+        gig_debug_transfer("%p - reusing wrapper", ptr);
+        if (transfer == GI_TRANSFER_NOTHING)
+            return wrapper;
+        if (meta->unref != NULL)
+            meta->unref(ptr);
+        else
+            g_boxed_free(type, ptr);
+        return wrapper;
+    }
+
+    // Boxed types have no ref function, so the alternative would be a
+    // copy.
+    if (G_UNLIKELY(gig_type_borrow_boxed) && transfer == GI_TRANSFER_NOTHING
+        && meta->ref == NULL) {
+        SCM scope = scm_fluid_ref(borrow_scope_fluid);
+        if (scm_is_true(scope))
+            return borrow_object(meta, ptr, scope);
     }
 
-    return scm_call_3(make_instance_proc, scm_type, kwd_value, pointer);
-}
+    gpointer ref = ptr;
+    if (transfer == GI_TRANSFER_NOTHING) {
+        if (meta->ref != NULL)
+            ref = meta->ref(ptr);
+        else
+            ref = g_boxed_copy(type, ptr);
+    }
 
-static SCM gig_fundamental_type;
-static SCM gig_boxed_type;
+    // For boxed types, the reference may be a copy, so the wrapper is
+    // cached under the address of what it wraps.
+    return wrapper_cache_make(meta, ref);
+}
 
 gboolean
 gig_type_check_object(SCM obj)
 {
-    return SCM_IS_A_P(obj, gig_fundamental_type);
+    return instance_meta(obj) != NULL || SCM_IS_A_P(obj, gig_fundamental_type);
 }
 
 gboolean
 gig_type_check_typed_object(SCM obj, SCM expected_type)
 {
+    GigClassInfo *meta = instance_meta(obj);
+    GigClassInfo *expected = class_meta(expected_type);
+
+    if (meta != NULL && expected != NULL && expected->is_wrapper)
+        return g_type_is_a(meta->gtype, expected->gtype);
     return SCM_IS_A_P(obj, expected_type);
 }
 
+// Whether OBJ wraps an instance of GTYPE.
+gboolean
+gig_type_check_object_gtype(SCM obj, GType gtype)
+{
+    GigClassInfo *meta = instance_meta(obj);
+
+    if (meta != NULL)
+        return g_type_is_a(meta->gtype, gtype);
+    return SCM_IS_A_P(obj, scm_from_gtype(gtype));
+}
+
+static gpointer
+peek_value(SCM obj)
+{
+    gpointer ptr = scm_to_pointer(wrapper_value(obj));
+
+    if (G_LIKELY(ptr != NULL))
+        return ptr;
+    if (scm_is_true(scm_hashq_ref(borrowed_wrappers, obj, SCM_BOOL_F)))
+        scm_misc_error(NULL, "borrowed value ~S was used after its scope ended; "
+                       "use boxed-copy to keep it", scm_list_1(obj));
+    if (scm_is_true(scm_hashq_ref(disposed_wrappers, obj, SCM_BOOL_F)))
+        scm_misc_error(NULL, "~S was used after it was disposed", scm_list_1(obj));
+    return ptr;
+}
+
 gpointer
 gig_type_peek_typed_object(SCM obj, SCM expected_type)
 {
-    g_return_val_if_fail(SCM_IS_A_P(obj, expected_type), NULL);
-    return scm_to_pointer(scm_slot_ref(obj, sym_value));
+    g_return_val_if_fail(gig_type_check_typed_object(obj, expected_type), NULL);
+    return peek_value(obj);
 }
 
 gpointer
 gig_type_peek_object(SCM obj)
 {
-    return gig_type_peek_typed_object(obj, gig_fundamental_type);
+    GigClassInfo *meta = instance_meta(obj);
+
+    if (meta == NULL)
+        g_return_val_if_fail(SCM_IS_A_P(obj, gig_fundamental_type), NULL);
+    return peek_value(obj);
 }
 
 static SCM type_less_p_proc;
@@ -194,13 +863,32 @@ type_less_p(SCM a, SCM b)
     return scm_less_p(key_b, key_a);
 }
 
+static SCM class_slot_definition_proc;
+static SCM slot_definition_index_proc;
+
+// Returns the index of the slot NAME in the instances of STYPE.
+static gint
+slot_index(SCM stype, SCM name)
+{
+    SCM slot = scm_call_2(class_slot_definition_proc, stype, name);
+    return scm_to_int(scm_call_1(slot_definition_index_proc, slot));
+}
+
 SCM
 gig_type_associate(GType gtype, SCM stype)
 {
+    GigClassInfo *meta = type_meta_ensure(gtype);
+    meta->stype = stype;
+    meta->is_wrapper = SCM_SUBCLASSP(stype, gig_fundamental_type);
+    if (meta->is_wrapper) {
+        meta->value_slot = slot_index(stype, sym_value);
+        meta->handle_slot = slot_index(stype, sym_handle);
+    }
+
     g_hash_table_insert(gig_type_gtype_hash, GSIZE_TO_POINTER(gtype), SCM_UNPACK_POINTER(stype));
     scm_set_object_property_x(stype, sym_sort_key,
                               scm_from_size_t(g_hash_table_size(gig_type_gtype_hash)));
-    g_hash_table_insert(gig_type_scm_hash, SCM_UNPACK_POINTER(stype), GSIZE_TO_POINTER(gtype));
+    g_hash_table_insert(gig_type_scm_hash, SCM_UNPACK_POINTER(stype), meta);
     return scm_class_name(stype);
 }
 
@@ -227,6 +915,7 @@ gig_type_define_with_info(GIRegisteredTypeInfo *info, SCM dsupers, SCM slots)
         gchar *name = g_strdup_printf("<%s>", _name);
         SCM class_name = scm_from_utf8_symbol(name);
         cls = scm_call_4(make_class_proc, dsupers, slots, kwd_name, class_name);
+        gig_load_stats_count(GIG_LOAD_CLASSES, 1);
         gig_debug_load("%s - creating new type", name);
         g_hash_table_insert(gig_type_name_hash, _name, SCM_UNPACK_POINTER(cls));
         g_free(name);
@@ -321,8 +1010,6 @@ gig_type_define_full(GType gtype, SCM defs, SCM extra_supers)
             dsupers = scm_cons(SCM_PACK_POINTER(sparent), extra_supers);
             new_type = scm_call_4(make_class_proc, dsupers, slots, kwd_name, type_class_name);
 
-            GigBoxedFuncs *funcs = _boxed_funcs_for_type(gtype);
-
             GIRepository *repository;
             GIBaseInfo *info;
             gsize size = 0;
@@ -335,8 +1022,11 @@ gig_type_define_full(GType gtype, SCM defs, SCM extra_supers)
                 g_base_info_unref(info);
             }
 
-            scm_class_set_x(new_type, sym_ref, scm_from_pointer(funcs->copy, NULL));
-            scm_class_set_x(new_type, sym_unref, scm_from_pointer(funcs->free, NULL));
+            GigClassInfo *meta = type_meta_ensure(gtype);
+            meta->ref = NULL;
+            meta->unref = NULL;
+            meta->size = size;
+
             scm_class_set_x(new_type, sym_size, scm_from_size_t(size));
             break;
         }
@@ -374,6 +1064,7 @@ gig_type_define_full(GType gtype, SCM defs, SCM extra_supers)
         }
 
         g_return_val_if_fail(!SCM_UNBNDP(new_type), defs);
+        gig_load_stats_count(GIG_LOAD_CLASSES, 1);
 
         SCM key = gig_type_associate(gtype, new_type);
         if (!SCM_UNBNDP(defs)) {
@@ -424,8 +1115,10 @@ scm_to_gtype_full(SCM x, const gchar *subr, gint argpos)
 {
     if (scm_is_unsigned_integer(x, 0, SIZE_MAX))
         return scm_to_size_t(x);
-    else if (SCM_CLASSP(x))
-        return GPOINTER_TO_SIZE(g_hash_table_lookup(gig_type_scm_hash, SCM_UNPACK_POINTER(x)));
+    else if (SCM_CLASSP(x)) {
+        GigClassInfo *meta = class_meta(x);
+        return meta ? meta->gtype : G_TYPE_INVALID;
+    }
     else
         scm_wrong_type_arg_msg(subr, argpos, x, "GType integer or class");
 }
@@ -433,12 +1126,10 @@ scm_to_gtype_full(SCM x, const gchar *subr, gint argpos)
 SCM
 scm_from_gtype(GType x)
 {
-    gpointer _key, _value;
-
     // GType <-> SCM associations must go both ways
-    if (g_hash_table_lookup_extended(gig_type_gtype_hash, GSIZE_TO_POINTER(x), &_key, &_value)
-        && g_hash_table_lookup_extended(gig_type_scm_hash, _value, &_value, &_key))
-        return SCM_PACK_POINTER(_value);
+    GigClassInfo *meta = g_type_get_qdata(x, gig_type_meta_quark);
+    if (meta != NULL && !SCM_UNBNDP(meta->stype) && class_meta(meta->stype) == meta)
+        return meta->stype;
     else
         return scm_from_size_t(x);
 }
@@ -449,12 +1140,11 @@ scm_from_gtype(GType x)
 GType
 gig_type_get_gtype_from_obj(SCM x)
 {
-    gpointer value;
-    if ((value = g_hash_table_lookup(gig_type_scm_hash, SCM_UNPACK_POINTER(x))))
-        return GPOINTER_TO_SIZE(value);
-    else if (SCM_INSTANCEP(x) &&
-             (value = g_hash_table_lookup(gig_type_scm_hash, SCM_UNPACK_POINTER(SCM_CLASS_OF(x)))))
-        return GPOINTER_TO_SIZE(value);
+    GigClassInfo *meta;
+    if ((meta = class_meta(x)))
+        return meta->gtype;
+    else if (SCM_INSTANCEP(x) && (meta = class_meta(SCM_CLASS_OF(x))))
+        return meta->gtype;
 
     return G_TYPE_INVALID;
 }
@@ -466,7 +1156,11 @@ gig_type_free_types(void)
     g_hash_table_remove_all(gig_type_gtype_hash);
     g_hash_table_remove_all(gig_type_name_hash);
     g_hash_table_remove_all(gig_type_scm_hash);
-    _free_boxed_funcs();
+    for (guint i = 0; i < gig_type_metas->len; i++) {
+        GigClassInfo *meta = g_ptr_array_index(gig_type_metas, i);
+        g_type_set_qdata(meta->gtype, gig_type_meta_quark, NULL);
+    }
+    g_ptr_array_set_size(gig_type_metas, 0);
 }
 
 static SCM
@@ -730,24 +1424,92 @@ scm_type_dump_type_table(void)
     return list;
 }
 
+static SCM
+scm_borrow_boxed_x(SCM flag)
+{
+    gig_type_borrow_boxed = scm_to_bool(flag);
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_borrowing_boxed_p(void)
+{
+    return scm_from_bool(gig_type_borrow_boxed);
+}
+
+static SCM
+scm_boxed_borrowed_p(SCM obj)
+{
+    SCM scope = scm_hashq_ref(borrowed_wrappers, obj, SCM_BOOL_F);
+    if (scm_is_false(scope))
+        return SCM_BOOL_F;
+    // An emptied wrapper no longer counts as borrowed.
+    return scm_from_bool(scm_is_true(scm_car(scope))
+                         || scm_to_pointer(wrapper_value(obj)) != NULL);
+}
+
+// Returns a wrapper that owns a copy of the boxed value OBJ, so that
+// it can outlive the scope OBJ was borrowed in.
+static SCM
+scm_boxed_copy(SCM obj)
+{
+    SCM_ASSERT_TYPE(SCM_IS_A_P(obj, gig_boxed_type), obj, SCM_ARG1, "boxed-copy", "boxed");
+    GType gtype = gig_type_get_gtype_from_obj(obj);
+    if (!G_TYPE_IS_BOXED(gtype) || gtype == G_TYPE_BOXED)
+        scm_wrong_type_arg_msg("boxed-copy", SCM_ARG1, obj, "registered boxed type");
+
+    gpointer ptr = gig_type_peek_object(obj);
+    if (ptr == NULL)
+        return SCM_BOOL_F;
+    return gig_type_transfer_object(gtype, g_boxed_copy(gtype, ptr), GI_TRANSFER_EVERYTHING);
+}
+
+static SCM
+scm_retained_native_bytes(void)
+{
+    gsize bytes;
+
+    G_LOCK(retained);
+    bytes = retained_bytes;
+    G_UNLOCK(retained);
+    return scm_from_size_t(bytes);
+}
+
+// Sets PROC as the procedure that estimates the native memory held by
+// instances of TYPE and its subtypes that are defined afterward.  It
+// is called with each new wrapper, and #f restores the default.
+static SCM
+scm_set_size_estimator_x(SCM type, SCM proc)
+{
+    GigClassInfo *meta = class_meta(type);
+
+    SCM_ASSERT_TYPE(meta != NULL && meta->is_wrapper, type, SCM_ARG1, "set-size-estimator!",
+                    "GType class");
+    SCM_ASSERT_TYPE(scm_is_false(proc) || scm_is_true(scm_procedure_p(proc)), proc, SCM_ARG2,
+                    "set-size-estimator!", "procedure or #f");
+
+    // Each type that holds an estimator protects it once, including
+    // the subtypes that inherited it.
+    SCM old = meta->size_proc;
+    meta->size_proc = scm_is_true(proc) ? scm_gc_protect_object(proc) : SCM_BOOL_F;
+    if (scm_is_true(old))
+        scm_gc_unprotect_object(old);
+    return SCM_UNSPECIFIED;
+}
+
 static SCM
 scm_allocate_boxed(SCM boxed_type)
 {
     SCM_ASSERT_TYPE(SCM_SUBCLASSP(boxed_type, gig_boxed_type), boxed_type, SCM_ARG1,
                     "%allocate-boxed", "boxed type");
-    SCM s_size = scm_class_ref(boxed_type, sym_size);
+    GigClassInfo *meta = class_meta(boxed_type);
 
-    gsize size = scm_to_size_t(s_size);
+    if (meta == NULL || meta->size == 0)
+        scm_out_of_range("%allocate-boxed", scm_class_ref(boxed_type, sym_size));
 
-    if (size == 0)
-        scm_out_of_range("%allocate-boxed", s_size);
-
-    gpointer boxed = g_malloc0(size);
-    GigTypeUnrefFunction unref;
-    unref = (GigTypeUnrefFunction)scm_to_pointer(scm_class_ref(boxed_type, sym_unref));
-    SCM pointer = scm_from_pointer(boxed, unref);
+    gpointer boxed = g_malloc0(meta->size);
 
-    return scm_call_3(make_instance_proc, boxed_type, kwd_value, pointer);
+    return wrapper_cache_make(meta, boxed);
 }
 
 void
@@ -765,6 +1527,9 @@ gig_type_define_fundamental(GType type, SCM extra_supers,
                               scm_from_pointer(unref, NULL));
 
     SCM key = gig_type_associate(type, new_type);
+    GigClassInfo *meta = type_meta_ensure(type);
+    meta->ref = ref;
+    meta->unref = unref;
     scm_define(key, new_type);
     scm_module_export(scm_current_module(), scm_list_1(key));
     scm_dynwind_end();
@@ -779,14 +1544,22 @@ gig_init_types_once(void)
     gig_flags_type = scm_c_private_ref("gi oop", "<GFlags>");
     make_class_proc = scm_c_public_ref("oop goops", "make-class");
     make_instance_proc = scm_c_public_ref("oop goops", "make");
+    class_slot_definition_proc = scm_c_public_ref("oop goops", "class-slot-definition");
+    slot_definition_index_proc = scm_c_public_ref("oop goops", "slot-definition-index");
+    wrapper_cache = scm_permanent_object(scm_make_weak_value_hash_table(SCM_UNDEFINED));
+    borrowed_wrappers = scm_permanent_object(scm_make_weak_key_hash_table(SCM_UNDEFINED));
+    lending_owners = scm_permanent_object(scm_make_weak_key_hash_table(SCM_UNDEFINED));
+    borrow_scope_fluid = scm_permanent_object(scm_make_fluid_with_default(SCM_BOOL_F));
+    null_pointer = scm_permanent_object(scm_from_pointer(NULL, NULL));
+    disposed_wrappers = scm_permanent_object(scm_make_weak_key_hash_table(SCM_UNDEFINED));
+    gobject_scope_fluid = scm_permanent_object(scm_make_fluid_with_default(SCM_BOOL_F));
     make_fundamental_proc = scm_c_private_ref("gi oop", "%make-fundamental-class");
 
     kwd_name = scm_from_utf8_keyword("name");
     kwd_value = scm_from_utf8_keyword("value");
 
     sym_value = scm_from_utf8_symbol("value");
-    sym_ref = scm_from_utf8_symbol("ref");
-    sym_unref = scm_from_utf8_symbol("unref");
+    sym_handle = scm_from_utf8_symbol("handle");
     sym_size = scm_from_utf8_symbol("size");
     sym_sort_key = scm_from_utf8_symbol("sort-key");
     sym_obarray = scm_from_utf8_symbol("obarray");
@@ -796,6 +1569,9 @@ gig_init_types_once(void)
     gig_type_gtype_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
     gig_type_name_hash = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
     gig_type_scm_hash = g_hash_table_new(g_direct_hash, g_direct_equal);
+    gig_type_meta_quark = g_quark_from_static_string("gig-type-meta");
+    wrapper_quark = g_quark_from_static_string("gig-wrapper");
+    gig_type_metas = g_ptr_array_new_with_free_func(g_free);
 
 #define A(G,S)                                  \
     do {                                        \
@@ -835,6 +1611,7 @@ gig_init_types_once(void)
     gig_closure_type = gig_type_get_scheme_type(G_TYPE_CLOSURE);
 
     scm_class_set_x(gig_value_type, sym_size, scm_from_size_t(sizeof(GValue)));
+    type_meta_ensure(G_TYPE_VALUE)->size = sizeof(GValue);
 
     // value associations, do not rely on them for anything else
     gig_type_associate(G_TYPE_STRING, scm_c_public_ref("oop goops", "<string>"));
@@ -889,6 +1666,8 @@ gig_init_types_once(void)
     D(G_TYPE_POINTER);
 #undef D
 
+    gig_init_unref_queue();
+
     type_less_p_proc = scm_c_make_gsubr("type-<?", 2, 0, 0, type_less_p);
 
     scm_c_define_gsubr("get-gtype", 1, 0, 0, scm_type_get_gtype);
@@ -906,6 +1685,14 @@ gig_init_types_once(void)
     scm_c_define_gsubr("gtype-is-a?", 2, 0, 0, scm_type_gtype_is_a_p);
     scm_c_define_gsubr("%gtype-dump-table", 0, 0, 0, scm_type_dump_type_table);
     scm_c_define_gsubr("%allocate-boxed", 1, 0, 0, scm_allocate_boxed);
+    scm_c_define_gsubr("borrow-boxed!", 1, 0, 0, scm_borrow_boxed_x);
+    scm_c_define_gsubr("borrowing-boxed?", 0, 0, 0, scm_borrowing_boxed_p);
+    scm_c_define_gsubr("boxed-borrowed?", 1, 0, 0, scm_boxed_borrowed_p);
+    scm_c_define_gsubr("boxed-copy", 1, 0, 0, scm_boxed_copy);
+    scm_c_define_gsubr("retained-native-bytes", 0, 0, 0, scm_retained_native_bytes);
+    scm_c_define_gsubr("set-size-estimator!", 2, 0, 0, scm_set_size_estimator_x);
+    scm_c_define_gsubr("call-with-gobject-scope", 1, 0, 0, scm_call_with_gobject_scope);
+    scm_c_define_gsubr("dispose!", 1, 0, 0, scm_dispose_x);
     scm_c_export("get-gtype",
                  "gtype-get-scheme-type",
                  "gtype-get-name",
@@ -917,7 +1704,10 @@ gig_init_types_once(void)
                  "gtype-is-interface?",
                  "gtype-is-classed?",
                  "gtype-is-instantiatable?",
-                 "gtype-is-derivable?", "gtype-is-a?", "%gtype-dump-table", NULL);
+                 "gtype-is-derivable?", "gtype-is-a?", "%gtype-dump-table",
+                 "borrow-boxed!", "borrowing-boxed?", "boxed-borrowed?", "boxed-copy",
+                 "retained-native-bytes", "set-size-estimator!", "call-with-gobject-scope",
+                 "dispose!", NULL);
 }
 
 void
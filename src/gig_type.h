@@ -29,6 +29,7 @@ extern SCM gig_interface_type;
 extern SCM gig_paramspec_type;
 extern SCM gig_value_type;
 extern SCM gig_closure_type;
+extern gboolean gig_type_borrow_boxed;
 
 G_GNUC_MALLOC gchar *gig_type_class_name_from_gtype(GType gtype);
 
@@ -46,9 +47,11 @@ SCM gig_type_get_scheme_type_with_info(GIRegisteredTypeInfo *info);
 
 gboolean gig_type_check_object(SCM obj);
 gboolean gig_type_check_typed_object(SCM obj, SCM expected_type);
+gboolean gig_type_check_object_gtype(SCM obj, GType gtype);
 SCM gig_type_transfer_object(GType gtype, gpointer obj, GITransfer transfer);
 gpointer gig_type_peek_object(SCM obj);
 gpointer gig_type_peek_typed_object(SCM obj, SCM expected);
+void gig_type_dynwind_borrow(SCM owner);
 
 void gig_init_types(void);
 
@@ -17,24 +17,32 @@
 
 #include <glib.h>
 #include <glib-object.h>
-#include <ffi.h>
 #include <libguile.h>
 
-typedef struct _GigBoxedFuncs
+// What the C side needs to know about a GType that has a Scheme
+// class, so that converting instances does not call into GOOPS.  It
+// is found through the GType's qdata or through the class.
+typedef struct _GigClassInfo
 {
-    ffi_type *atypes[1];
-
-    ffi_closure *copy_closure;
-    ffi_cif copy_cif;
-    void *copy;
-
-    ffi_closure *free_closure;
-    ffi_cif free_cif;
-    void *free;
-} GigBoxedFuncs;
-
-GigBoxedFuncs *_boxed_funcs_for_type(GType type);
-void _free_boxed_funcs();
+    GType gtype;
+    SCM stype;
+    // Takes a reference to an instance.  Boxed types have none, and
+    // are copied with g_boxed_copy instead.
+    gpointer (*ref)(gpointer);
+    // Releases an instance.  Boxed types have none, and are freed
+    // with g_boxed_free instead.
+    void (*unref)(gpointer);
+    gsize size;
+    // Estimate the native memory an instance keeps alive, for the GC.
+    // A Scheme procedure, if set, takes precedence.
+    gsize (*size_func)(gpointer);
+    SCM size_proc;
+    // Whether the class is a <GFundamental>, whose instances wrap a
+    // pointer, and, if so, the indices of its value and handle slots.
+    guint is_wrapper:1;
+    gint value_slot;
+    gint handle_slot;
+} GigClassInfo;
 
 extern SCM sym_obarray;
 
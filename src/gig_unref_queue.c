@@ -0,0 +1,171 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <glib-object.h>
+#include <libguile.h>
+#include "gig_unref_queue.h"
+#include "gig_util.h"
+
+typedef struct _GigUnrefEntry GigUnrefEntry;
+
+struct _GigUnrefEntry
+{
+    GigUnrefEntry *next;
+    gpointer ptr;
+    // The boxed type of PTR, or G_TYPE_INVALID for an object.
+    GType boxed_type;
+    // For an object, the notify function of the toggle reference to
+    // remove.
+    GToggleNotify toggle_notify;
+};
+
+// The queue is a lock-free stack that any thread can push onto, and
+// that is emptied all at once to be drained.  drain_scheduled is set
+// while an idle source that will drain the queue is attached to the
+// default main context.
+static GigUnrefEntry *volatile unref_queue = NULL;
+static volatile gint drain_scheduled = FALSE;
+
+static guint
+unref_queue_drain(void)
+{
+    GigUnrefEntry *head, *list = NULL;
+    guint count = 0;
+
+    do
+        head = g_atomic_pointer_get(&unref_queue);
+    while (!g_atomic_pointer_compare_and_exchange(&unref_queue, head, NULL));
+
+    // Release in the order the wrappers were finalized.
+    while (head != NULL) {
+        GigUnrefEntry *next = head->next;
+        head->next = list;
+        list = head;
+        head = next;
+    }
+
+    while (list != NULL) {
+        GigUnrefEntry *next = list->next;
+        if (list->boxed_type == G_TYPE_INVALID)
+            g_object_remove_toggle_ref(list->ptr, list->toggle_notify, NULL);
+        else
+            g_boxed_free(list->boxed_type, list->ptr);
+        g_free(list);
+        list = next;
+        count++;
+    }
+    if (count > 0)
+        gig_debug_transfer("released %u queued instances", count);
+    return count;
+}
+
+static gboolean
+unref_queue_idle(gpointer user_data)
+{
+    g_atomic_int_set(&drain_scheduled, FALSE);
+    unref_queue_drain();
+    return G_SOURCE_REMOVE;
+}
+
+// Asks the loop running the default main context to drain the queue,
+// unless it already has been.  Pushes never drain the queue themselves,
+// since they come from the finalizer thread.  When no loop runs the
+// context, the queue is drained after the next garbage collection.
+static void
+unref_queue_schedule(void)
+{
+    GSource *source;
+
+    if (!g_atomic_int_compare_and_exchange(&drain_scheduled, FALSE, TRUE))
+        return;
+
+    source = g_idle_source_new();
+    g_source_set_priority(source, G_PRIORITY_LOW);
+    g_source_set_callback(source, unref_queue_idle, NULL, NULL);
+    g_source_set_name(source, "[guile-gi] unref queue");
+    g_source_attach(source, g_main_context_default());
+    g_source_unref(source);
+}
+
+static void
+unref_queue_push(gpointer ptr, GType boxed_type, GToggleNotify toggle_notify)
+{
+    GigUnrefEntry *entry = g_new(GigUnrefEntry, 1);
+
+    entry->ptr = ptr;
+    entry->boxed_type = boxed_type;
+    entry->toggle_notify = toggle_notify;
+
+    do
+        entry->next = g_atomic_pointer_get(&unref_queue);
+    while (!g_atomic_pointer_compare_and_exchange(&unref_queue, entry->next, entry));
+
+    unref_queue_schedule();
+}
+
+void
+gig_unref_queue_boxed(GType type, gpointer boxed)
+{
+    if (boxed != NULL)
+        unref_queue_push(boxed, type, NULL);
+}
+
+// Queues the removal of the toggle reference of OBJECT that was added
+// with NOTIFY and no data.
+void
+gig_unref_queue_toggle_ref(gpointer object, GToggleNotify notify)
+{
+    unref_queue_push(object, G_TYPE_INVALID, notify);
+}
+
+// Releases everything that is queued, on the calling thread, and
+// returns how many instances that was.
+guint
+gig_unref_queue_flush(void)
+{
+    return unref_queue_drain();
+}
+
+static SCM
+scm_flush_unref_queue_x(void)
+{
+    return scm_from_uint(gig_unref_queue_flush());
+}
+
+// Runs after each garbage collection, to drain what was queued while
+// no loop was running the default main context.  The queue is only
+// drained if the context can be acquired, so that it is never drained
+// alongside a running loop.
+static SCM
+unref_queue_after_gc(void)
+{
+    GMainContext *context = g_main_context_default();
+
+    if (g_atomic_pointer_get(&unref_queue) == NULL || !g_main_context_acquire(context))
+        return SCM_UNSPECIFIED;
+    unref_queue_drain();
+    g_main_context_release(context);
+    return SCM_UNSPECIFIED;
+}
+
+void
+gig_init_unref_queue(void)
+{
+    scm_c_define_gsubr("flush-unref-queue!", 0, 0, 0, scm_flush_unref_queue_x);
+    scm_c_export("flush-unref-queue!", NULL);
+    scm_add_hook_x(scm_after_gc_hook,
+                   scm_c_make_gsubr("%unref-queue-after-gc", 0, 0, 0, unref_queue_after_gc),
+                   SCM_BOOL_F);
+}
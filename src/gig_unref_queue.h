@@ -0,0 +1,35 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GIG_UNREF_QUEUE_H
+#define GIG_UNREF_QUEUE_H
+
+#include <glib-object.h>
+
+// *INDENT-OFF*
+G_BEGIN_DECLS
+// *INDENT-ON*
+
+// Wrappers that are finalized do not release their instance on the
+// finalizer thread.  The instance is queued, and the queue is drained
+// in batches by an idle source of the default main context, or after
+// a garbage collection when no loop is running it.
+void gig_unref_queue_boxed(GType type, gpointer boxed);
+void gig_unref_queue_toggle_ref(gpointer object, GToggleNotify notify);
+guint gig_unref_queue_flush(void);
+void gig_init_unref_queue(void);
+
+G_END_DECLS
+#endif
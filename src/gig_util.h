@@ -33,6 +33,21 @@ G_GNUC_INTERNAL gchar *scm_write_to_utf8_stringn(SCM x, gsize max_len);
             obj = SCM_BOOL_F;    \
     } while (0)                  \
 
+// The topics of debug messages.  GIG_DEBUG_CALLS is enabled by
+// G_MESSAGES_DEBUG, the others by GIG_DEBUG on top of that.
+typedef enum _GigDebugFlags
+{
+    GIG_DEBUG_CALLS = 1 << 0,
+    GIG_DEBUG_AMAP = 1 << 1,
+    GIG_DEBUG_LOAD = 1 << 2,
+    GIG_DEBUG_TRANSFERS = 1 << 3,
+    GIG_DEBUG_UNPARSED = 1 << 30
+} GigDebugFlags;
+
+extern guint gig_debug_flags;
+gboolean gig_debug_check(guint flag);
+void gig_debug_refresh(void);
+
 G_END_DECLS
 #endif
 #define gig_debug_internal(level,domain,...)                  \
@@ -44,10 +59,31 @@ G_END_DECLS
                          "GIG_DOMAIN", domain,                \
                          "MESSAGE", __VA_ARGS__);             \
     } while (FALSE)
-#define gig_debug_transfer(...) gig_debug_internal(G_LOG_LEVEL_DEBUG, "transfers", __VA_ARGS__)
-#define gig_debug_load(...)     gig_debug_internal(G_LOG_LEVEL_DEBUG, "load", __VA_ARGS__)
+
+// Disabled topics cost a test of gig_debug_flags.  The message
+// arguments aren't evaluated unless the topic is enabled.
+#ifdef GIG_DISABLE_TRACING
+#define gig_debug_enabled(flag) (FALSE)
+#else
+#define gig_debug_enabled(flag) \
+    (G_UNLIKELY(gig_debug_flags & (flag)) && gig_debug_check(flag))
+#endif
+
+#define gig_debug_topic(flag,domain,...)                                \
+    do {                                                                \
+        if (gig_debug_enabled(flag))                                    \
+            gig_debug_internal(G_LOG_LEVEL_DEBUG, domain, __VA_ARGS__); \
+    } while (FALSE)
+#define gig_debug_call(...)                     \
+    do {                                        \
+        if (gig_debug_enabled(GIG_DEBUG_CALLS)) \
+            g_debug(__VA_ARGS__);               \
+    } while (FALSE)
+#define gig_debug_transfer(...) gig_debug_topic(GIG_DEBUG_TRANSFERS, "transfers", __VA_ARGS__)
+#define gig_debug_load(...)     gig_debug_topic(GIG_DEBUG_LOAD, "load", __VA_ARGS__)
 #define gig_warning_load(...)   gig_debug_internal(G_LOG_LEVEL_WARNING, "load", __VA_ARGS__)
 #define gig_critical_load(...)  gig_debug_internal(G_LOG_LEVEL_CRITICAL, "load", __VA_ARGS__)
+#define gig_warning_stall(...)  gig_debug_internal(G_LOG_LEVEL_WARNING, "stall", __VA_ARGS__)
 #if (SCM_MAJOR_VERSION == 2) || (SCM_MAJOR_VERSION == 3 && SCM_MINOR_VERSION == 0 && SCM_MICRO_VERSION < 4)
 #define scm_c_bitvector_count(x) scm_to_size_t(scm_bit_count(SCM_BOOL_T, (x)))
 #endif
@@ -0,0 +1,262 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <glib.h>
+#include <libguile.h>
+#include <libguile/hooks.h>
+#include "gig_util.h"
+#include "gig_watchdog.h"
+
+// Longer argument summaries are cut off.
+#define GIG_WATCHDOG_ARGS_MAX 200
+
+// The monitor thread polls the calls in flight every half threshold,
+// within these bounds in microseconds.
+#define GIG_WATCHDOG_MIN_INTERVAL 1000
+#define GIG_WATCHDOG_MAX_INTERVAL 100000
+
+gint64 gig_watchdog_threshold = 0;
+
+static SCM gig_stall_hook;
+
+// The mutex guards the monitor thread and the stack of watched calls,
+// whose innermost call is WATCHDOG_CURRENT.
+static GMutex watchdog_mutex;
+static GCond watchdog_cond;
+static GThread *watchdog_monitor;
+static gboolean watchdog_quit;
+static GigWatchdogCall *watchdog_current;
+
+struct live_report
+{
+    GigStatsKind kind;
+    gchar *name;
+    gint64 elapsed;
+};
+
+static void
+watchdog_unwatch(void *data)
+{
+    GigWatchdogCall *call = data;
+    GigWatchdogCall **link = &watchdog_current;
+
+    // Calls normally leave in order, but the owner of the default
+    // context can change while one is running.
+    g_mutex_lock(&watchdog_mutex);
+    while (*link != NULL && *link != call)
+        link = &(*link)->outer;
+    if (*link != NULL)
+        *link = call->outer;
+    g_mutex_unlock(&watchdog_mutex);
+}
+
+// Shows CALL, which began at CALL->start, to the monitor thread until
+// the current dynwind context is left.  Only calls made on the thread
+// that owns the default main context are watched.
+void
+gig_watchdog_watch(GigWatchdogCall *call, GigStatsKind kind, const gchar *name)
+{
+    if (!g_main_context_is_owner(g_main_context_default()))
+        return;
+
+    call->kind = kind;
+    call->name = name;
+    call->reported = FALSE;
+    g_mutex_lock(&watchdog_mutex);
+    call->outer = watchdog_current;
+    watchdog_current = call;
+    g_mutex_unlock(&watchdog_mutex);
+    scm_dynwind_unwind_handler(watchdog_unwatch, call, SCM_F_WIND_EXPLICITLY);
+}
+
+static void *
+report_live(void *data)
+{
+    struct live_report *report = data;
+
+    gig_warning_stall("%s %s is still running after %" G_GINT64_FORMAT " us on the main thread",
+                      gig_stats_kind_name(report->kind),
+                      report->name ? report->name : "(anonymous)", report->elapsed / 1000);
+    return NULL;
+}
+
+// Finds the innermost watched call that has run for longer than the
+// threshold, unless it was already reported.  The mutex must be held.
+static gboolean
+watchdog_check(struct live_report *report)
+{
+    gint64 now = gig_stats_clock();
+
+    for (GigWatchdogCall *call = watchdog_current; call != NULL; call = call->outer) {
+        if (now - call->start <= gig_watchdog_threshold)
+            continue;
+        if (call->reported)
+            return FALSE;
+
+        report->kind = call->kind;
+        report->name = g_strdup(call->name);
+        report->elapsed = now - call->start;
+        // The calls around it are held up by the same call.
+        for (; call != NULL; call = call->outer)
+            call->reported = TRUE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+// The monitor thread reports calls that are still running.  It runs
+// no Scheme code besides the log writer, so the reports go to the
+// GLib log and not to %stall-hook.
+static gpointer
+watchdog_monitor_run(gpointer data)
+{
+    g_mutex_lock(&watchdog_mutex);
+    while (!watchdog_quit) {
+        struct live_report report;
+
+        if (watchdog_check(&report)) {
+            g_mutex_unlock(&watchdog_mutex);
+            scm_with_guile(report_live, &report);
+            g_free(report.name);
+            g_mutex_lock(&watchdog_mutex);
+        }
+
+        gint64 interval = CLAMP(gig_watchdog_threshold / 2000, GIG_WATCHDOG_MIN_INTERVAL,
+                                GIG_WATCHDOG_MAX_INTERVAL);
+        g_cond_wait_until(&watchdog_cond, &watchdog_mutex, g_get_monotonic_time() + interval);
+    }
+    g_mutex_unlock(&watchdog_mutex);
+    return NULL;
+}
+
+static void *
+join_monitor(void *data)
+{
+    g_thread_join(data);
+    return NULL;
+}
+
+static gchar *
+summarize_args(SCM args)
+{
+    SCM s_summary = scm_simple_format(SCM_BOOL_F, scm_from_utf8_string("~S"), scm_list_1(args));
+    gchar *summary = scm_to_utf8_string(s_summary);
+
+    if (g_utf8_strlen(summary, -1) > GIG_WATCHDOG_ARGS_MAX) {
+        gchar *end = g_utf8_offset_to_pointer(summary, GIG_WATCHDOG_ARGS_MAX);
+        end[0] = '\0';
+        gchar *cut = g_strconcat(summary, "...", NULL);
+        free(summary);
+        return cut;
+    }
+    gchar *copy = g_strdup(summary);
+    free(summary);
+    return copy;
+}
+
+static SCM
+current_backtrace(void)
+{
+    SCM stack = scm_make_stack(SCM_BOOL_T, SCM_EOL);
+    if (scm_is_false(stack))
+        return scm_from_utf8_string("");
+
+    SCM port = scm_open_output_string();
+    scm_display_backtrace(stack, port, SCM_UNDEFINED, SCM_UNDEFINED);
+    return scm_get_output_string(port);
+}
+
+// Reports that the binding NAME of KIND, which was called with ARGS,
+// ran from START until now, after it returned.  Only calls made on the thread that owns
+// the default main context are reported.  The report goes to the
+// procedures of %stall-hook, or, if there are none, to the GLib log.
+void
+gig_watchdog_report(GigStatsKind kind, const gchar *name, gint64 start, SCM args)
+{
+    gint64 elapsed = gig_stats_clock() - start;
+
+    if (gig_watchdog_threshold == 0 || !g_main_context_is_owner(g_main_context_default()))
+        return;
+
+    SCM backtrace = current_backtrace();
+    if (!scm_is_null(SCM_HOOK_PROCEDURES(gig_stall_hook))) {
+        scm_c_run_hook(gig_stall_hook,
+                       scm_list_5(scm_from_utf8_string(name),
+                                  scm_from_utf8_symbol(gig_stats_kind_name(kind)),
+                                  scm_from_int64(elapsed), args, backtrace));
+        return;
+    }
+
+    gchar *summary = summarize_args(args);
+    gchar *s_backtrace = scm_to_utf8_string(backtrace);
+    gig_warning_stall("%s %s ran for %" G_GINT64_FORMAT " us on the main thread, "
+                      "arguments: %s\n%s", gig_stats_kind_name(kind), name, elapsed / 1000,
+                      summary, s_backtrace);
+    free(s_backtrace);
+    g_free(summary);
+}
+
+static SCM
+scm_watchdog_start_x(SCM s_threshold)
+{
+    // The threshold is given in milliseconds.
+    gdouble threshold = scm_to_double(s_threshold);
+    if (threshold <= 0)
+        scm_out_of_range("watchdog-start!", s_threshold);
+
+    g_mutex_lock(&watchdog_mutex);
+    gig_watchdog_threshold = MAX((gint64)(threshold * 1000000.0), 1);
+    watchdog_quit = FALSE;
+    if (watchdog_monitor == NULL)
+        watchdog_monitor = g_thread_new("gig-watchdog", watchdog_monitor_run, NULL);
+    g_cond_signal(&watchdog_cond);
+    g_mutex_unlock(&watchdog_mutex);
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_watchdog_stop_x(void)
+{
+    g_mutex_lock(&watchdog_mutex);
+    GThread *monitor = watchdog_monitor;
+    gig_watchdog_threshold = 0;
+    watchdog_quit = TRUE;
+    watchdog_monitor = NULL;
+    g_cond_signal(&watchdog_cond);
+    g_mutex_unlock(&watchdog_mutex);
+
+    // The monitor may need to enter Guile to finish a report.
+    if (monitor != NULL)
+        scm_without_guile(join_monitor, monitor);
+    return SCM_UNSPECIFIED;
+}
+
+static SCM
+scm_watchdog_threshold(void)
+{
+    if (gig_watchdog_threshold == 0)
+        return SCM_BOOL_F;
+    return scm_from_double(gig_watchdog_threshold / 1000000.0);
+}
+
+void
+gig_init_watchdog(void)
+{
+    gig_stall_hook = scm_permanent_object(scm_make_hook(scm_from_size_t(5)));
+    scm_c_define("%stall-hook", gig_stall_hook);
+    scm_c_define_gsubr("watchdog-start!", 1, 0, 0, scm_watchdog_start_x);
+    scm_c_define_gsubr("watchdog-stop!", 0, 0, 0, scm_watchdog_stop_x);
+    scm_c_define_gsubr("watchdog-threshold", 0, 0, 0, scm_watchdog_threshold);
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2021 Michael L. Gran
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef GIG_WATCHDOG_H
+#define GIG_WATCHDOG_H
+
+#include <glib.h>
+#include <libguile.h>
+#include "gig_stats.h"
+
+// *INDENT-OFF*
+G_BEGIN_DECLS
+// *INDENT-ON*
+
+// The watchdog reports calls that run longer than a threshold on the
+// thread that owns the default main context, which is usually the
+// thread running the UI.  A threshold of zero disables it.
+extern gint64 gig_watchdog_threshold;
+
+// A watched call.  While it runs on the thread that owns the default
+// main context, a monitor thread can see it and report it before it
+// returns.
+typedef struct _GigWatchdogCall
+{
+    gint64 start;
+    GigStatsKind kind;
+    const gchar *name;
+    gboolean reported;
+    struct _GigWatchdogCall *outer;
+} GigWatchdogCall;
+
+void gig_watchdog_watch(GigWatchdogCall *call, GigStatsKind kind, const gchar *name);
+void gig_watchdog_report(GigStatsKind kind, const gchar *name, gint64 start, SCM args);
+void gig_init_watchdog(void);
+
+// Stores the start time of a watched call in CALL, or zero when the
+// watchdog is disabled.
+#define gig_watchdog_start(call) \
+    ((call)->start = G_LIKELY(gig_watchdog_threshold == 0) ? 0 : gig_stats_clock())
+
+// Shows CALL to the monitor thread until the current dynwind context
+// is left.  NAME must stay valid until then and may be NULL.
+#define gig_watchdog_dynwind_watch(call, kind, name)    \
+    do {                                                \
+        if ((call)->start)                              \
+            gig_watchdog_watch(call, kind, name);       \
+    } while (FALSE)
+
+// Whether a watched call that began at START has run for longer than
+// the threshold.
+#define gig_watchdog_stalled(start) \
+    ((start) && gig_stats_clock() - (start) > gig_watchdog_threshold)
+
+G_END_DECLS
+#endif
@@ -0,0 +1,138 @@
+;; The binding cache directory is read when it is first used.
+(define cache-dir
+  (let ((dir (tmpnam)))
+    (mkdir dir)
+    (setenv "GIG_BINDING_CACHE" dir)
+    dir))
+
+(use-modules (gi) (gi repository)
+             (rnrs bytevectors)
+             (rnrs io ports)
+             (srfi srfi-64))
+
+(test-begin "binding-cache")
+
+(define cache-file (string-append cache-dir "/GLib-2.0.cache"))
+(define binding-cache-info (@@ (gi repository) %binding-cache-info))
+(define binding-cache-reset! (@@ (gi repository) %binding-cache-reset!))
+
+(define (load-main-loop)
+  (load-by-name "GLib" "MainLoop")
+  (binding-cache-info "GLib"))
+
+(define (read-cache-file)
+  (call-with-port (open-file-input-port cache-file) get-bytevector-all))
+
+(define (write-cache-file bv)
+  (call-with-port (open-file-output-port cache-file (file-options no-fail))
+    (lambda (port)
+      (put-bytevector port bv))))
+
+(require "GLib" "2.0")
+
+(test-equal "a missing cache is written"
+  '(missing #t #t)
+  (let ((info (load-main-loop)))
+    (list (assq-ref info 'state)
+          (positive? (binding-cache-flush!))
+          (file-exists? cache-file))))
+
+(test-assert "a valid cache is used"
+  (begin
+    (binding-cache-reset!)
+    (let ((info (load-main-loop)))
+      (and (eq? 'valid (assq-ref info 'state))
+           (> (assq-ref info 'hits) 0)))))
+
+;; Replaces each occurrence of FROM in BV by TO, and returns how many
+;; were replaced.
+(define (replace-bytes! bv from to)
+  (let ((n (bytevector-length from)))
+    (let loop ((i 0) (count 0))
+      (cond
+       ((> (+ i n) (bytevector-length bv)) count)
+       ((let match ((j 0))
+          (or (= j n)
+              (and (= (bytevector-u8-ref bv (+ i j)) (bytevector-u8-ref from j))
+                   (match (1+ j)))))
+        (bytevector-copy! to 0 bv i n)
+        (loop (+ i n) (1+ count)))
+       (else (loop (1+ i) count))))))
+
+(test-equal "an inconsistent record is made again"
+  '(#t valid #t #f 0)
+  (begin
+    (binding-cache-reset!)
+    ;; Required input arguments lose their C input flag, which leaves
+    ;; the file well formed.
+    (let* ((bv (read-cache-file))
+           (replaced (replace-bytes! bv #vu8(1 0 0 5) #vu8(1 0 0 4))))
+      (write-cache-file bv)
+      (let* ((info (load-main-loop))
+             (running? (main-loop:is-running? (main-loop:new #f #f))))
+        (binding-cache-flush!)
+        (binding-cache-reset!)
+        (list (positive? replaced)
+              (assq-ref info 'state)
+              (positive? (assq-ref info 'rejected))
+              running?
+              (assq-ref (load-main-loop) 'rejected))))))
+
+(test-equal "a cache of another version is replaced"
+  '(stale 0 #t valid)
+  (begin
+    (binding-cache-reset!)
+    (let ((bv (read-cache-file)))
+      ;; The version comes first.
+      (bytevector-u32-native-set! bv 0 #xffffffff)
+      (write-cache-file bv))
+    (let* ((info (load-main-loop))
+           (written (binding-cache-flush!)))
+      (binding-cache-reset!)
+      (list (assq-ref info 'state)
+            (assq-ref info 'hits)
+            (positive? written)
+            (assq-ref (load-main-loop) 'state)))))
+
+(test-equal "a cache of another typelib is ignored"
+  '(stale 0)
+  (begin
+    (binding-cache-reset!)
+    (let ((bv (read-cache-file)))
+      ;; The typelib path follows the version.
+      (bytevector-u8-set! bv 4 (char->integer #\X))
+      (write-cache-file bv))
+    (let ((info (load-main-loop)))
+      (list (assq-ref info 'state)
+            (assq-ref info 'hits)))))
+
+(test-equal "a cache of a typelib with other contents is ignored"
+  '(stale 0)
+  (begin
+    ;; Write the records made since the path was changed.
+    (binding-cache-flush!)
+    (binding-cache-reset!)
+    (let* ((bv (read-cache-file))
+           ;; The checksum follows the typelib path.
+           (end (let loop ((i 4))
+                  (if (zero? (bytevector-u8-ref bv i)) i (loop (1+ i))))))
+      (bytevector-u8-set! bv (1+ end) (char->integer #\X))
+      (write-cache-file bv))
+    (let ((info (load-main-loop)))
+      (list (assq-ref info 'state)
+            (assq-ref info 'hits)))))
+
+(test-equal "a corrupt cache is ignored"
+  '(stale #f)
+  (begin
+    (binding-cache-reset!)
+    (write-cache-file #vu8(2 0 0 0 255 255 255))
+    (let ((info (load-main-loop)))
+      (list (assq-ref info 'state)
+            (main-loop:is-running? (main-loop:new #f #f))))))
+
+(binding-cache-reset!)
+(delete-file cache-file)
+(rmdir cache-dir)
+
+(test-end "binding-cache")
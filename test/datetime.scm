@@ -37,7 +37,56 @@
         (not (valid? date2)))
 
       (test-assert "clear-original-unaffected"
-        (valid? date)))))
+        (valid? date))))
+
+  (let ((date2 (boxed-copy date)))
+    (test-assert "boxed-copy"
+      (and (not (eq? date date2))
+           (not (boxed-borrowed? date2))
+           (equal? (get-day date) (get-day date2))
+           (equal? (get-year date) (get-year date2))))))
+
+(test-assert "retained-native-bytes"
+  (dynamic-wind
+    (lambda () (set-size-estimator! <GDate> (const 1000000)))
+    (lambda ()
+      (let* ((before (retained-native-bytes))
+             (date (date:new-dmy 1 (number->date-month 1) 2000)))
+        (>= (retained-native-bytes) (+ before 900000))))
+    (lambda () (set-size-estimator! <GDate> #f))))
+
+(test-assert "disposing a date stops counting its retained bytes"
+  (dynamic-wind
+    (lambda () (set-size-estimator! <GDate> (const 1000000)))
+    (lambda ()
+      (let* ((before (retained-native-bytes))
+             (date (date:new-dmy 1 (number->date-month 1) 2000)))
+        (dispose! date)
+        (< (retained-native-bytes) (+ before 900000))))
+    (lambda () (set-size-estimator! <GDate> #f))))
+
+(test-error "disposed dates cannot be used"
+  #t
+  (let ((date (date:new-dmy 1 (number->date-month 1) 2000)))
+    (dispose! date)
+    (get-day date)))
+
+(test-equal "with-gobject-scope returns its value"
+  1
+  (with-gobject-scope
+   (get-day (date:new-dmy 1 (number->date-month 1) 2000))))
+
+(test-error "with-gobject-scope releases what it wrapped"
+  #t
+  (let ((date (with-gobject-scope
+               (date:new-dmy 1 (number->date-month 1) 2000))))
+    (get-day date)))
+
+(test-assert "borrow-boxed!"
+  (dynamic-wind
+    (lambda () (borrow-boxed! #t))
+    (lambda () (borrowing-boxed?))
+    (lambda () (borrow-boxed! #f))))
 
 (test-end "date")
 
@@ -259,3 +259,236 @@ extra_return_callback(ExtraIntCallbackInt *func)
 {
     *func = integer_passthrough;
 }
+
+/**
+ * extra_call_callback_match_info:
+ * @func: (scope call):
+ *
+ * Calls @func with a match info that is freed when it returns.
+ */
+gboolean
+extra_call_callback_match_info(ExtraCallbackMatchInfo func)
+{
+    GRegex *regex = g_regex_new("a", 0, 0, NULL);
+    GMatchInfo *match_info;
+    gboolean ret;
+
+    g_regex_match(regex, "abc", 0, &match_info);
+    ret = func(match_info);
+    g_match_info_free(match_info);
+    g_regex_unref(regex);
+    return ret;
+}
+
+static volatile gint finalized_count = 0;
+
+static void
+count_finalized(gpointer data, GObject *where_the_object_was)
+{
+    g_atomic_int_inc(&finalized_count);
+}
+
+/**
+ * extra_watch_finalize:
+ * @obj: an object
+ *
+ * Counts @obj in extra_finalized_count() once it is finalized.
+ */
+void
+extra_watch_finalize(GObject *obj)
+{
+    g_object_weak_ref(obj, count_finalized, NULL);
+}
+
+/**
+ * extra_finalized_count:
+ *
+ * Returns: the number of watched objects that have been finalized.
+ */
+guint
+extra_finalized_count(void)
+{
+    return g_atomic_int_get(&finalized_count);
+}
+
+static GObject *held_object = NULL;
+
+/**
+ * extra_hold:
+ * @obj: (nullable): an object
+ *
+ * Keeps a reference to @obj, in place of the object held before.
+ */
+void
+extra_hold(GObject *obj)
+{
+    if (obj != NULL)
+        g_object_ref(obj);
+    g_clear_object(&held_object);
+    held_object = obj;
+}
+
+/**
+ * extra_held:
+ *
+ * Returns: (transfer none) (nullable): the object that is held
+ */
+GObject *
+extra_held(void)
+{
+    return held_object;
+}
+
+typedef struct
+{
+    gint number;
+} ExtraBasePrivate;
+
+G_DEFINE_TYPE_WITH_PRIVATE(ExtraBase, extra_base, G_TYPE_OBJECT)
+
+enum
+{
+    PROP_BASE_0,
+    PROP_BASE_NUMBER
+};
+
+static void
+extra_base_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    ExtraBasePrivate *priv = extra_base_get_instance_private(EXTRA_BASE(object));
+
+    switch (prop_id) {
+    case PROP_BASE_NUMBER:
+        g_value_set_int(value, priv->number);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void
+extra_base_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    ExtraBasePrivate *priv = extra_base_get_instance_private(EXTRA_BASE(object));
+
+    switch (prop_id) {
+    case PROP_BASE_NUMBER:
+        priv->number = g_value_get_int(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static gint
+extra_base_real_adjust(ExtraBase *self, gint x)
+{
+    return x + 1;
+}
+
+/**
+ * extra_base_adjust: (virtual adjust)
+ * @self: an #ExtraBase
+ * @x: a number
+ *
+ * Returns: @x as adjusted by the class of @self.
+ */
+gint
+extra_base_adjust(ExtraBase *self, gint x)
+{
+    return EXTRA_BASE_GET_CLASS(self)->adjust(self, x);
+}
+
+static gboolean
+extra_base_real_check(ExtraBase *self, gint x, GError **error)
+{
+    return TRUE;
+}
+
+/**
+ * extra_base_check: (virtual check)
+ * @self: an #ExtraBase
+ * @x: a number
+ * @error: return location for a #GError
+ *
+ * Returns: %TRUE if the class of @self accepts @x
+ */
+gboolean
+extra_base_check(ExtraBase *self, gint x, GError **error)
+{
+    return EXTRA_BASE_GET_CLASS(self)->check(self, x, error);
+}
+
+static void
+extra_base_class_init(ExtraBaseClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    klass->adjust = extra_base_real_adjust;
+    klass->check = extra_base_real_check;
+    object_class->get_property = extra_base_get_property;
+    object_class->set_property = extra_base_set_property;
+    g_object_class_install_property(object_class, PROP_BASE_NUMBER,
+                                    g_param_spec_int("number", "Number", "A number",
+                                                     G_MININT, G_MAXINT, 0,
+                                                     G_PARAM_READWRITE));
+}
+
+static void
+extra_base_init(ExtraBase *self)
+{
+}
+
+struct _ExtraDerived
+{
+    ExtraBase parent_instance;
+    gint number;
+};
+
+G_DEFINE_TYPE(ExtraDerived, extra_derived, EXTRA_TYPE_BASE)
+
+enum
+{
+    PROP_DERIVED_0,
+    PROP_DERIVED_NUMBER
+};
+
+static void
+extra_derived_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    switch (prop_id) {
+    case PROP_DERIVED_NUMBER:
+        g_value_set_int(value, EXTRA_DERIVED(object)->number + 100);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void
+extra_derived_set_property(GObject *object, guint prop_id, const GValue *value,
+                           GParamSpec *pspec)
+{
+    switch (prop_id) {
+    case PROP_DERIVED_NUMBER:
+        EXTRA_DERIVED(object)->number = g_value_get_int(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    }
+}
+
+static void
+extra_derived_class_init(ExtraDerivedClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->get_property = extra_derived_get_property;
+    object_class->set_property = extra_derived_set_property;
+    g_object_class_override_property(object_class, PROP_DERIVED_NUMBER, "number");
+}
+
+static void
+extra_derived_init(ExtraDerived *self)
+{
+}
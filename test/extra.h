@@ -182,4 +182,65 @@ _GI_TEST_EXTERN
 void
 extra_return_callback(ExtraIntCallbackInt *func);
 
+/**
+ * ExtraCallbackMatchInfo
+ */
+typedef gboolean (* ExtraCallbackMatchInfo) (const GMatchInfo *match_info);
+
+_GI_TEST_EXTERN
+gboolean
+extra_call_callback_match_info(ExtraCallbackMatchInfo func);
+
+_GI_TEST_EXTERN
+void
+extra_watch_finalize(GObject *obj);
+
+_GI_TEST_EXTERN
+guint
+extra_finalized_count(void);
+
+_GI_TEST_EXTERN
+void
+extra_hold(GObject *obj);
+
+_GI_TEST_EXTERN
+GObject *
+extra_held(void);
+
+/**
+ * ExtraBase:
+ *
+ * An object with a "number" property, an "adjust" virtual function
+ * that adds one, and a "check" virtual function that accepts anything.
+ */
+#define EXTRA_TYPE_BASE (extra_base_get_type())
+_GI_TEST_EXTERN
+G_DECLARE_DERIVABLE_TYPE(ExtraBase, extra_base, EXTRA, BASE, GObject)
+
+struct _ExtraBaseClass
+{
+    GObjectClass parent_class;
+
+    gint (*adjust) (ExtraBase *self, gint x);
+    gboolean (*check) (ExtraBase *self, gint x, GError **error);
+};
+
+_GI_TEST_EXTERN
+gint
+extra_base_adjust(ExtraBase *self, gint x);
+
+_GI_TEST_EXTERN
+gboolean
+extra_base_check(ExtraBase *self, gint x, GError **error);
+
+/**
+ * ExtraDerived:
+ *
+ * A subclass of #ExtraBase that overrides its "number" property, and
+ * reads it as 100 more than what was set.
+ */
+#define EXTRA_TYPE_DERIVED (extra_derived_get_type())
+_GI_TEST_EXTERN
+G_DECLARE_FINAL_TYPE(ExtraDerived, extra_derived, EXTRA, DERIVED, ExtraBase)
+
 #endif /* _EXTRA_H_ */
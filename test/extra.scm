@@ -314,4 +314,132 @@
         n-callbacks
         n-c-callbacks))
 
+(define (call-with-borrowed-match-info proc)
+  (dynamic-wind
+    (lambda () (borrow-boxed! #t))
+    (lambda () (call-callback-match-info? proc))
+    (lambda () (borrow-boxed! #f))))
+
+(test-assert "borrowed argument raises after the callback returns"
+  (let* ((kept #f)
+         (count (call-with-borrowed-match-info
+                 (lambda (match-info)
+                   (set! kept match-info)
+                   (= 1 (get-match-count match-info))))))
+    (and count
+         (not (false-if-exception (get-match-count kept))))))
+
+(test-assert "value borrowed from a borrowed argument raises after the callback returns"
+  (let* ((kept #f)
+         (pattern (call-with-borrowed-match-info
+                   (lambda (match-info)
+                     (set! kept (get-regex match-info))
+                     (string=? "a" (get-pattern kept))))))
+    (and pattern
+         (not (false-if-exception (get-pattern kept))))))
+
+(test-assert "values borrowed from a disposed owner raise"
+  (dynamic-wind
+    (lambda () (borrow-boxed! #t))
+    (lambda ()
+      (let ((regex (regex:new "a"
+                              (number->regex-compile-flags 0)
+                              (number->regex-match-flags 0))))
+        (receive (matched? match-info)
+            (regex:match regex "abc" (number->regex-match-flags 0))
+          (let ((borrowed (get-regex match-info)))
+            (and (boxed-borrowed? borrowed)
+                 (string=? "a" (get-pattern borrowed))
+                 (begin
+                   (dispose! match-info)
+                   (not (false-if-exception (get-pattern borrowed)))))))))
+    (lambda () (borrow-boxed! #f))))
+
+(test-equal "property overridden by a subclass"
+  '(103 103 0)
+  (let ((derived (make <ExtraDerived>))
+        (base (make <ExtraBase>)))
+    (set! (number derived) 3)
+    (list (number derived)
+          (car (get-properties derived 'number))
+          (number base))))
+
+(test-assert "objects released by finalizers are unreffed"
+  (let ((before (finalized-count)))
+    (for-each (lambda (i) (watch-finalize (make <GObject>))) (iota 100))
+    (let loop ((tries 0))
+      (gc)
+      (flush-unref-queue!)
+      (cond
+       ((> (finalized-count) before) #t)
+       ((< tries 50) (usleep 10000) (loop (1+ tries)))
+       (else #f)))))
+
+(test-assert "dispose! on a worker thread releases the object while a loop runs"
+  (let ((loop (main-loop:new #f #f))
+        (obj (make <GObject>))
+        (before (finalized-count))
+        (released #f))
+    (watch-finalize obj)
+    (idle-add PRIORITY_DEFAULT
+              (lambda (data)
+                (join-thread
+                 (call-with-new-thread
+                  (lambda ()
+                    (dispose! obj)
+                    (set! released (> (finalized-count) before)))))
+                (main-loop:quit loop)
+                #f))
+    (main-loop:run loop)
+    released))
+
+(test-equal "wrapper kept while C holds its object"
+  42
+  (begin
+    (let ((obj (make <GObject>)))
+      (set-object-property! obj 'extra-tag 42)
+      (hold obj))
+    (gc)
+    (object-property (held) 'extra-tag)))
+
+(test-assert "object released once neither C nor Scheme holds it"
+  (let ((before (finalized-count)))
+    (watch-finalize (held))
+    (hold #f)
+    (let loop ((tries 0))
+      (gc)
+      (flush-unref-queue!)
+      (cond
+       ((> (finalized-count) before) #t)
+       ((< tries 50) (usleep 10000) (loop (1+ tries)))
+       (else #f)))))
+
+(define <ExtraAdjustTwice>
+  ((@ (gi) register-type) "ExtraAdjustTwice" <ExtraBase> '() '()
+                          `((adjust . ,(lambda (self x)
+                                         (* 10 (chain-up <ExtraAdjustTwice> 'adjust self x)))))))
+
+(test-equal "overridden virtual function chains up"
+  '(2 20)
+  (list (adjust (make <ExtraBase>) 1)
+        (adjust (make <ExtraAdjustTwice>) 1)))
+
+(define <ExtraCheckRaises>
+  ((@ (gi) register-type) "ExtraCheckRaises" <ExtraBase> '() '()
+                          `((check . ,(lambda (self x)
+                                        (error "rejected" x))))))
+
+(test-assert "error in an overridden throwing virtual function becomes a GError"
+  (and (check (make <ExtraBase>) 1)
+       (catch 'misc-error
+         (lambda ()
+           (check (make <ExtraCheckRaises>) 1)
+           #f)
+         (lambda (key subr message args rest)
+           (string-contains message "rejected 1")))))
+
+(test-error "chain up to a virtual function that is not overridden"
+  #t
+  (chain-up <ExtraAdjustTwice> 'constructed (make <ExtraAdjustTwice>)))
+
 (test-end "extra")
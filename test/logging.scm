@@ -21,4 +21,20 @@
     (use-modules (gi))
     (> %custom-logger-called 0)))
 
+(test-equal "debug topics"
+  '(calls transfers)
+  (begin
+    (setenv "G_MESSAGES_DEBUG" "GuileGI")
+    (setenv "GIG_DEBUG" "transfers")
+    (refresh-debug-topics!)
+    (debug-topics)))
+
+(test-equal "no debug topics"
+  '()
+  (begin
+    (unsetenv "G_MESSAGES_DEBUG")
+    (unsetenv "GIG_DEBUG")
+    (refresh-debug-topics!)
+    (debug-topics)))
+
 (test-end "logging")
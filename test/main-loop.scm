@@ -27,6 +27,8 @@
 
 (test-assert "is running" (is-running? loop))
 (test-assert "get context" (is-a? (get-context loop) <GMainContext>))
+(test-assert "same context, same wrapper"
+  (eq? (get-context loop) (get-context loop)))
 
 (define %idle-counter 0)
 
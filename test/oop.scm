@@ -78,6 +78,81 @@
     (set! (test-param object) 100)
     (test-param object2)))
 
+(test-equal "set-properties! and get-properties"
+  '(42 42)
+  (begin
+    (set-properties! object #:test-param 42)
+    (list (test-param object)
+          (car (get-properties object 'test-param)))))
+
+(test-equal "get-properties with a <GParam>"
+  '(42 42)
+  (get-properties object test-param "test-param"))
+
+(test-error "get-properties of a missing property"
+  #t
+  (get-properties object 'no-such-param))
+
+(test-equal "make with properties"
+  '(7 -7)
+  (list (test-param (make <TestClass> #:test-param 7))
+        (test-param (make <TestClass> #:test-param -7))))
+
+(test-equal "make-objects"
+  '(1 2 0)
+  (map test-param
+       (vector->list
+        (make-objects <TestClass>
+                      (vector (vector #:test-param 1)
+                              (vector #:test-param 2)
+                              (vector))))))
+
+(test-error "make-objects with an unknown property"
+  #t
+  (make-objects <TestClass> (vector (vector #:no-such-param 1))))
+
+;; Each registered type keeps its own property values.
+(test-equal "properties of a derived registered type"
+  '(12 5 -3)
+  (let* ((sub-param (param-spec-int
+                     "sub-param"
+                     "sub-param"
+                     "This is a test parameter of a subclass"
+                     -10 10 5
+                     (list->param-flags '(readwrite))))
+         (<TestSubclass> (register-type "TestSubclass" <TestClass> (list sub-param) '()))
+         (obj (make <TestSubclass> #:test-param 12)))
+    (let ((default (sub-param obj)))
+      (set! (sub-param obj) -3)
+      (list (test-param obj) default (sub-param obj)))))
+
+(test-assert "override a virtual function"
+  (let* ((constructed '())
+         (<TestVFuncClass>
+          (register-type "TestVFuncClass" <GObject> '() '()
+                         `((constructed . ,(lambda (self)
+                                             (set! constructed (cons self constructed)))))))
+         (obj (make <TestVFuncClass>)))
+    (and (= 1 (length constructed))
+         (is-a? (car constructed) <TestVFuncClass>))))
+
+(define chained-up #f)
+(define <TestChainUpClass>
+  (register-type "TestChainUpClass" <GObject> '() '()
+                 `((constructed . ,(lambda (self)
+                                     (chain-up <TestChainUpClass> 'constructed self)
+                                     (set! chained-up #t))))))
+
+(test-assert "chain up from a virtual function"
+  (begin
+    (make <TestChainUpClass>)
+    chained-up))
+
+(test-error "override a missing virtual function"
+  #t
+  (register-type "TestNoVFuncClass" <GObject> '() '()
+                 `((no-such-vfunc . ,(lambda (self) #t)))))
+
 (test-assert "simple signal"
   (let ((success #f))
     (connect object test-signal (lambda _ (set! success #t)))
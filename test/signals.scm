@@ -334,5 +334,19 @@
                      (values 1 #t)))
     (call-with-values (lambda () (signalOscar instance 0 #f)) list)))
 
+(test-assert "handler receives the same wrapper"
+  (let* ((signalPapa (make-signal #:name "signal-papa"
+                                  #:return-type G_TYPE_NONE))
+         (<ClassPapa> (register-type "ClassPapa"
+                                     <GObject>
+                                     '()
+                                     (list signalPapa)))
+         (instance (make <ClassPapa>))
+         (same #f))
+    (connect instance signalPapa
+             (lambda (obj)
+               (set! same (eq? obj instance))))
+    (signalPapa instance)
+    same))
 
 (test-end "signals")
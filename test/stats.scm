@@ -0,0 +1,53 @@
+(use-modules (gi) (gi stats) (gi util)
+             (srfi srfi-1)
+             (srfi srfi-64))
+
+(use-typelibs (("GLib" "2.0")
+               #:renamer (protect* '(test-equal test-assert test-skip))))
+(test-begin "stats")
+
+(define (strdup-stats)
+  (find (lambda (entry)
+          (string-contains (assq-ref entry 'name) "strdup"))
+        (stats-snapshot)))
+
+(test-assert "disabled by default"
+  (not (stats-enabled?)))
+
+(test-assert "nothing recorded while disabled"
+  (begin
+    (strdup "hello")
+    (not (strdup-stats))))
+
+(test-equal "function calls are counted"
+  3
+  (begin
+    (stats-enable!)
+    (strdup "a")
+    (strdup "b")
+    (strdup "c")
+    (stats-disable!)
+    (assq-ref (strdup-stats) 'calls)))
+
+(test-assert "function timing and histogram"
+  (let* ((entry (strdup-stats))
+         (total (assq-ref entry 'total-time))
+         (histogram (assq-ref entry 'histogram)))
+    (and (eq? 'function (assq-ref entry 'kind))
+         (> total 0)
+         (<= (assq-ref entry 'max-time) total)
+         (= 3 (apply + (vector->list histogram))))))
+
+(test-assert "sorted report"
+  (string-contains
+   (with-output-to-string
+     (lambda ()
+       (stats-report (current-output-port) #:sort-by 'calls)))
+   "strdup"))
+
+(test-assert "reset"
+  (begin
+    (stats-reset!)
+    (not (strdup-stats))))
+
+(test-end "stats")
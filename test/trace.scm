@@ -0,0 +1,64 @@
+(use-modules (gi) (gi trace) (gi util)
+             (srfi srfi-64))
+
+(use-typelibs (("GLib" "2.0")
+               #:renamer (protect* '(test-equal test-assert test-skip))))
+(test-begin "trace")
+
+(define (count-matches pattern str)
+  (let loop ((start 0) (count 0))
+    (let ((pos (string-contains str pattern start)))
+      (if pos
+          (loop (+ pos 1) (1+ count))
+          count))))
+
+(test-equal "empty trace"
+  "{\"traceEvents\":[\n]}\n"
+  (begin
+    (trace-clear!)
+    (with-output-to-string trace-dump)))
+
+(test-assert "function calls are traced"
+  (let ((json (begin
+                (trace-start! 64)
+                (strdup "a")
+                (strdup "b")
+                (trace-stop!)
+                (with-output-to-string trace-dump))))
+    (and (string-contains json "strdup")
+         (= 2 (count-matches "\"ph\":\"B\"" json))
+         (= 2 (count-matches "\"ph\":\"E\"" json)))))
+
+(test-assert "calls that raise an error are closed"
+  (let ((json (begin
+                (trace-clear!)
+                (trace-start! 64)
+                (false-if-exception (strdup 5))
+                (trace-stop!)
+                (with-output-to-string trace-dump))))
+    (= 1
+       (count-matches "\"ph\":\"B\"" json)
+       (count-matches "\"ph\":\"E\"" json))))
+
+(test-assert "nothing traced while stopped"
+  (begin
+    (trace-clear!)
+    (strdup "c")
+    (not (string-contains (with-output-to-string trace-dump) "strdup"))))
+
+(test-equal "ring buffer keeps the newest events"
+  4
+  (begin
+    (trace-clear!)
+    (trace-start! 4)
+    (strdup "d")
+    (strdup "e")
+    (strdup "f")
+    (trace-stop!)
+    (count-matches "\"name\"" (with-output-to-string trace-dump))))
+
+(test-error "trace-start! rejects capacities too large to round up"
+  #t
+  (trace-start! (1+ (expt 2 31))))
+
+(test-end "trace")
@@ -1,6 +1,8 @@
 (use-modules (gi)
              (gi documentation)
-             (gi repository))
+             (gi repository)
+             (oop goops)
+             (srfi srfi-1))
 
 (test-begin "typelib")
 
@@ -12,6 +14,107 @@
          (iface (module-public-interface module)))
     (module-defined? iface %test-symbol)))
 
+(test-assert "methods are added to their generics in one batch"
+  (let* ((module (typelib->module '(test batched-typelib->module) "GLib" "2.0"))
+         (unref (module-ref (module-public-interface module) 'unref))
+         (methods (generic-function-methods unref)))
+    (and (> (length methods) 1)
+         (every (lambda (method)
+                  (eq? unref (method-generic-function method)))
+                methods)
+         (memq (car methods) (class-direct-methods (car (method-specializers (car methods))))))))
+
+(test-equal "methods added by a batch are dispatched, and replace their equals"
+  '(#f 1)
+  (save-module-excursion
+   (lambda ()
+     (set-current-module (make-fresh-user-module))
+     ((@@ (gi repository) %load-batch)
+      (lambda ()
+        (load-by-name "GLib" "MainLoop")
+        ;; The same methods again, made in the same batch.
+        (load-by-name "GLib" "MainLoop")))
+     (let ((main-loop (module-ref (current-module) '<GMainLoop>))
+           (is-running? (module-ref (current-module) 'is-running?)))
+       (list (is-running? ((module-ref (current-module) 'main-loop:new) #f #f))
+             (count (lambda (method)
+                      (equal? (list main-loop) (method-specializers method)))
+                    (generic-function-methods is-running?)))))))
+
+(test-equal "a signal named like a method of the same batch stands for the method"
+  'application:activate
+  (save-module-excursion
+   (lambda ()
+     (set-current-module (make-fresh-user-module))
+     (require "Gio" "2.0")
+     ((@@ (gi repository) %load-batch)
+      (lambda ()
+        (load-by-name "Gio" "Application")))
+     (let* ((application (module-ref (current-module) '<GApplication>))
+            (method (find (lambda (method)
+                            (equal? (list application) (method-specializers method)))
+                          (generic-function-methods (module-ref (current-module) 'activate))))
+            (proc (method-procedure method)))
+       ;; A signal that collides calls the method instead of emitting.
+       (procedure-name (if (is-a? proc (@ (gi oop) <signal>))
+                           (slot-ref proc 'procedure)
+                           proc))))))
+
+(test-assert "lazy typelib->module"
+  (let* ((module (typelib->module '(test lazy-typelib->module) "Gio" "2.0" #:lazy? #t))
+         (iface (module-public-interface module)))
+    (and (module-defined? iface '<GFile>)
+         (not (hashq-ref (module-obarray iface) 'file:new-for-path))
+         (module-defined? iface 'file:new-for-path)
+         (procedure? (module-ref iface 'file:new-for-path)))))
+
+(test-assert "lazy short generics are complete"
+  (let ((iface (module-public-interface (resolve-module '(test lazy-typelib->module)))))
+    ;; Loading the long name also defines the short one.
+    (module-ref iface 'input-stream:is-closed?)
+    (not ((module-ref iface 'is-closed?)
+          ((module-ref iface 'memory-output-stream:new-resizable))))))
+
+(test-assert "lazy index includes types"
+  (any (lambda (row)
+         (and (eq? 'info (vector-ref row 2))
+              (not (vector-ref row 1))))
+       (vector->list ((@@ (gi repository) %lazy-index->vector) "Gio"))))
+
+(test-assert "typelib->module with a precomputed index"
+  (let* ((module (typelib->module '(test indexed-typelib->module) "GLib" "2.0"
+                                  #:index #(#(<GMainLoop> #f info "MainLoop")
+                                            #(strdup #f function "strdup")
+                                            #(main-loop:run "MainLoop" function "run"))))
+         (iface (module-public-interface module)))
+    (and (not (hashq-ref (module-obarray iface) '<GMainLoop>))
+         (module-defined? iface '<GMainLoop>)
+         (not (module-defined? iface '<GMainContext>))
+         (procedure? (module-ref iface 'strdup))
+         (procedure? (module-ref iface 'main-loop:run)))))
+
+(test-assert "binding-cache-preload! rejects other data"
+  (not (binding-cache-preload! "GLib" #vu8(0 1 2 3))))
+
+(test-assert "binding-cache-flush!"
+  (integer? (binding-cache-flush!)))
+
+(test-assert "load-stats-snapshot"
+  (begin
+    (load-stats-reset!)
+    (load-stats-enable!)
+    (typelib->module '(test load-stats) "GLib" "2.0")
+    (load-stats-disable!)
+    (let ((entry (find (lambda (entry)
+                         (and (equal? "GLib" (assq-ref entry 'typelib))
+                              (eq? 'function (assq-ref entry 'info-type))))
+                       (load-stats-snapshot))))
+      (and entry
+           (> (assq-ref entry 'infos) 0)
+           (> (assq-ref entry 'methods) 0)
+           (> (assq-ref entry 'closures) 0)
+           (> (assq-ref entry 'bytes) 0)))))
+
 (test-assert "use-typelibs"
   (begin
     (save-module-excursion
@@ -0,0 +1,73 @@
+(use-modules (gi) (gi logging) (gi repository)
+             (ice-9 optargs)
+             (srfi srfi-64))
+
+(require "GLib" "2.0")
+(load-by-name "GLib" "MainContext")
+(load-by-name "GLib" "usleep")
+
+(test-begin "watchdog")
+
+(define %stalls '())
+
+(add-hook! %stall-hook
+           (lambda (name kind elapsed args backtrace)
+             (set! %stalls (cons (list name kind elapsed args) %stalls))))
+
+(test-equal "disabled by default"
+  #f
+  (watchdog-threshold))
+
+(test-equal "threshold"
+  5.0
+  (begin
+    (watchdog-start! 5)
+    (watchdog-threshold)))
+
+(test-equal "not reported off the main context"
+  '()
+  (begin
+    (usleep 20000)
+    %stalls))
+
+(test-assert "long call reported"
+  (let ((context (main-context:default)))
+    (acquire context)
+    (usleep 20000)
+    (release context)
+    (and (= 1 (length %stalls))
+         (string-contains (car (car %stalls)) "usleep")
+         (eq? 'function (cadr (car %stalls)))
+         (> (caddr (car %stalls)) 5000000)
+         (equal? '(20000) (cadddr (car %stalls))))))
+
+(test-assert "short call not reported"
+  (let ((context (main-context:default)))
+    (set! %stalls '())
+    (acquire context)
+    (usleep 10)
+    (release context)
+    (null? %stalls)))
+
+(test-assert "long call reported while running"
+  (let ((context (main-context:default))
+        (live #f))
+    (install-custom-logger!
+     (lambda* (#:key message #:allow-other-keys)
+       (when (and (string? message) (string-contains message "still running"))
+         (set! live (cons (get-internal-real-time) message)))))
+    (acquire context)
+    (usleep 200000)
+    (let ((returned (get-internal-real-time)))
+      (release context)
+      (and live
+           (string-contains (cdr live) "usleep")
+           (< (car live) returned)))))
+
+(test-equal "stop"
+  #f
+  (begin
+    (watchdog-stop!)
+    (watchdog-threshold)))
+
+(test-end "watchdog")